@@ -65,9 +65,7 @@ static CONFIGRET CM_Get_Parent_GenHook(PDEVINST pdnDevInst, DEVINST dnDevInst, v
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pdnDevInst) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Parent " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Parent " << node << END;
         *pdnDevInst = gRootDevInst;
         return CR_SUCCESS;
     }
@@ -91,9 +89,7 @@ CONFIGRET WINAPI CM_Get_Sibling_GenHook(PDEVINST pdnDevInst, DEVINST dnDevInst,
     int devNodeIdx;
     DeviceNode *node = GetCustomDevInstNode(dnDevInst, &devNodeIdx);
     if (node && pdnDevInst) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Sibling " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Sibling " << node << END;
 
         int nextIdx;
         if (ImplNextDeviceNode(devNodeIdx + 1, &nextIdx)) {
@@ -113,9 +109,7 @@ CONFIGRET WINAPI CM_Get_Sibling_GenHook(PDEVINST pdnDevInst, DEVINST dnDevInst,
         CM_Get_Parent_Real(&parent, dnDevInst, 0) == CR_SUCCESS &&
         parent == gRootDevInst &&
         ImplNextDeviceNode(0, &firstIdx)) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Sibling (pre)" << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Sibling (pre)" << END;
         *pdnDevInst = CustomDevInstStart + firstIdx;
         ret = CR_SUCCESS;
     }
@@ -137,9 +131,7 @@ CONFIGRET WINAPI CM_Get_Child_GenHook(PDEVINST pdnDevInst, DEVINST dnDevInst, vo
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pdnDevInst) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Child " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Child " << node << END;
         *pdnDevInst = 0;
         return CR_NO_SUCH_DEVNODE;
     }
@@ -162,9 +154,7 @@ CONFIGRET WINAPI CM_Get_Depth_GenHook(PULONG pulDepth, DEVINST dnDevInst, void *
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pulDepth) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Depth " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Depth " << node << END;
         *pulDepth = 1;
         return CR_SUCCESS;
     }
@@ -187,9 +177,7 @@ CONFIGRET WINAPI CM_Get_Device_ID_Size_GenHook(PULONG pulLen, DEVINST dnDevInst,
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pulLen) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_ID_Size " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_ID_Size " << node << END;
 
         *pulLen = (ULONG)wcslen(node->DeviceInstNameW.Get()); // not including null
         return CR_SUCCESS;
@@ -213,9 +201,7 @@ CONFIGRET WINAPI CM_Get_Device_ID_GenHook(DEVINST dnDevInst, tchar *buffer, ULON
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && buffer) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_ID " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_ID " << node << END;
 
         const tchar *src = node->DeviceInstName<tchar>();
         return TStrCopy(buffer, bufferLen, src) ? CR_SUCCESS : CR_BUFFER_SMALL;
@@ -283,9 +269,7 @@ template <class tchar, class TOrigCall>
 CONFIGRET WINAPI CM_Get_Device_ID_List_Size_GenHook(PULONG pulLen, const tchar *pszFilter, ULONG ulFlags, void *caller, TOrigCall origCall) {
     REDIRECT_DETECT(gCfgMgrRedirect, caller, origCall);
 
-    if (G.ApiDebug) {
-        LOG << "CM_Get_Device_ID_List_Size " << (pszFilter ? pszFilter : TSTR("")) << ", " << ulFlags << END;
-    }
+    LOG_API_DEBUG << "CM_Get_Device_ID_List_Size " << (pszFilter ? pszFilter : TSTR("")) << ", " << ulFlags << END;
 
     CONFIGRET ret = origCall();
 
@@ -323,9 +307,7 @@ template <class tchar, class TOrigCall>
 CONFIGRET WINAPI CM_Get_Device_ID_List_GenHook(const tchar *pszFilter, tchar *buffer, ULONG bufferLen, ULONG ulFlags, void *caller, TOrigCall origCall) {
     REDIRECT_DETECT(gCfgMgrRedirect, caller, origCall);
 
-    if (G.ApiDebug) {
-        LOG << "CM_Get_Device_ID_List " << (pszFilter ? pszFilter : TSTR("")) << ", " << ulFlags << END;
-    }
+    LOG_API_DEBUG << "CM_Get_Device_ID_List " << (pszFilter ? pszFilter : TSTR("")) << ", " << ulFlags << END;
 
     CONFIGRET ret = origCall();
 
@@ -369,9 +351,7 @@ static DEVINST LocateCustomDevNode(tchar *pDeviceID) {
     for (int i = 0; i < IMPL_MAX_DEVNODES; i++) {
         DeviceNode *node = ImplGetDeviceNode(i);
         if (node && tstrieq(pDeviceID, node->DeviceInstName<tchar>())) {
-            if (G.ApiDebug) {
-                LOG << "CM_Locate_DevNode " << pDeviceID << END;
-            }
+            LOG_API_DEBUG << "CM_Locate_DevNode " << pDeviceID << END;
 
             return CustomDevInstStart + i;
         }
@@ -429,9 +409,7 @@ CONFIGRET WINAPI CM_Get_DevNode_Status_GenHook(PULONG pulStatus, PULONG pulProbl
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pulStatus && pulProblemNumber) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_DevNode_Status " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_DevNode_Status " << node << END;
 
         *pulStatus = DN_DRIVER_LOADED | DN_STARTED | DN_NT_ENUMERATOR | DN_NT_DRIVER | DN_ROOT_ENUMERATED; // ???
         *pulProblemNumber = 0;
@@ -517,7 +495,7 @@ static int CMGetPropertyValue(DEVPROPTYPE *propType, PBYTE propBuf, PULONG propS
     });
 }
 
-ostream &operator<<(ostream &o, const DEVPROPKEY *propKey) {
+LogStream &operator<<(LogStream &o, const DEVPROPKEY *propKey) {
     wchar_t buffer[FORMAT_GUID_BUFSIZE];
     FormatGuid(buffer, propKey->fmtid);
     o << buffer << ":" << std::hex << propKey->pid;
@@ -530,9 +508,7 @@ CONFIGRET WINAPI CM_Get_DevNode_Property_Keys_GenHook(DEVINST dnDevInst, DEVPROP
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && propKeyCount) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_DevNode_Property_Keys " << node << END;
-        }
+        LOG_API_DEBUG << "CM_Get_DevNode_Property_Keys " << node << END;
 
         // TODO: more!
         // (e.g. Service [also wbem] is set to xusb22?)
@@ -571,9 +547,7 @@ CONFIGRET WINAPI CM_Get_DevNode_Property_GenHook(DEVINST dnDevInst, const DEVPRO
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && propKey && propType && propSize) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_DevNode_Property " << node->UserIdx << ", " << propKey << END;
-        }
+        LOG_API_DEBUG << "CM_Get_DevNode_Property " << node->UserIdx << ", " << propKey << END;
 
         // TODO: more!
         if (*propKey == DEVPKEY_Device_InstanceId) {
@@ -621,9 +595,7 @@ CONFIGRET WINAPI CM_Get_DevNode_Registry_Property_GenHook(DEVINST dnDevInst, ULO
 
     DeviceNode *node = GetCustomDevInstNode(dnDevInst);
     if (node && pulLength) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_DevNode_Registry_Property " << node << ", " << prop << END;
-        }
+        LOG_API_DEBUG << "CM_Get_DevNode_Registry_Property " << node << ", " << prop << END;
 
         DEVPROPKEY key = DEVPKEY_Device_DeviceDesc;
         key.pid = prop + 1;
@@ -731,9 +703,7 @@ CONFIGRET WINAPI CM_Get_Device_Interface_List_Size_GenHook(PULONG pulLen, LPGUID
 
     FilterResult filter;
     if (ret == CR_SUCCESS && pulLen && DeviceInterfaceListFilterMatches(clsGuid, pDeviceID, &filter)) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_Interface_List_Size " << (pDeviceID ? pDeviceID : TSTR("")) << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_Interface_List_Size " << (pDeviceID ? pDeviceID : TSTR("")) << END;
 
         for (int i = 0; i < IMPL_MAX_DEVNODES; i++) {
             DeviceNode *node = ImplGetDeviceNode(i);
@@ -774,9 +744,7 @@ CONFIGRET WINAPI CM_Get_Device_Interface_List_GenHook(LPGUID clsGuid, tchar *pDe
         if (gUniqLogCfgMgrFind) {
             LOG << "Found device via CfgMgr API" << END;
         }
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_Interface_List " << (pDeviceID ? pDeviceID : TSTR("")) << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_Interface_List " << (pDeviceID ? pDeviceID : TSTR("")) << END;
 
         ZZTStrMoveToEnd(buffer, bufferLen);
 
@@ -819,9 +787,7 @@ CONFIGRET WINAPI CM_Get_Device_Interface_Property_Keys_GenHook(LPCWSTR pszIntf,
     CONFIGRET ret = origCall();
 
     if (ret == CR_NO_SUCH_DEVICE_INTERFACE && pszIntf && propKeyCount) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_Interface_Property_Keys " << pszIntf << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_Interface_Property_Keys " << pszIntf << END;
 
         *propKeyCount = oldKeyCount;
         for (int i = 0; i < IMPL_MAX_DEVNODES; i++) {
@@ -863,9 +829,7 @@ CONFIGRET WINAPI CM_Get_Device_Interface_Property_GenHook(LPCWSTR pszIntf, const
     CONFIGRET ret = origCall();
 
     if (ret == CR_NO_SUCH_DEVICE_INTERFACE && pszIntf && propKey && propType && propSize) {
-        if (G.ApiDebug) {
-            LOG << "CM_Get_Device_Interface_Property " << pszIntf << ", " << propKey << END;
-        }
+        LOG_API_DEBUG << "CM_Get_Device_Interface_Property " << pszIntf << ", " << propKey << END;
 
         *propSize = oldPropSize;
         for (int i = 0; i < IMPL_MAX_DEVNODES; i++) {
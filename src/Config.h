@@ -1,11 +1,132 @@
 #pragma once
 #include "ConfigRead.h"
+#include "ConfigCache.h"
 #include "StateUtils.h"
 #include "Devices.h"
+#include "EventTrace.h"
 #include <fstream>
 
+struct ConfigStagedMapping {
+    ImplInput *Input;
+    SharedPtr<ImplMapping> Mapping;
+    int Op;  // index of the op it came from
+    int Sub; // index among the mappings the op expanded to
+};
+
+struct ConfigSlotAlloc {
+    key_t Key;
+    user_t User;
+    slot_t Slot;
+};
+
+struct ConfigOp {
+    uint32_t Offset, Size;         // within ConfigOps::Data
+    vector<ConfigSlotAlloc> Slots; // allocated when the op was applied
+};
+
+// A config compiled into ops (the same ops its cache holds)
+struct ConfigOps {
+    vector<uint8_t> Data;
+    vector<ConfigOp> Ops;
+
+    span<const uint8_t> Get(const ConfigOp &op) const { return span<const uint8_t>(Data).subspan(op.Offset, op.Size); }
+    ConfigCacheOp Type(const ConfigOp &op) const { return (ConfigCacheOp)Data[op.Offset]; }
+};
+
+// Where a mapping in G.Arena came from
+struct ConfigArenaEntry {
+    ImplInput *Input;
+    int Op, Sub;
+};
+
+struct ConfigFileLine {
+    string_view Line;
+    intptr_t Idx; // past the first token
+    bool IsVar;
+    int Number;
+    string_view Layer; // of the innermost enclosing '[ !Layer <name>' group, if any
+};
+
+// A config file, read (and split into its active lines) ahead of being loaded
+struct ConfigFileData {
+    wstring Name;
+    bool Read = false;
+    uint64_t WriteTime = 0;
+    string Contents;
+    vector<ConfigFileLine> Lines; // (views into Contents)
+    vector<wstring> Includes;     // as found in Lines - a hint of what to read next
+};
+
+enum class ConfigLintPhase {
+    None,
+    Read,
+    Split,
+    Parse,
+    Apply,
+    Slots,
+    Arena,
+    Conds,
+    Count
+};
+
+#define ENUMERATE_CONFIG_LINT_PHASES(e) \
+    e(ConfigLintPhase::Read, "read");   \
+    e(ConfigLintPhase::Split, "split"); \
+    e(ConfigLintPhase::Parse, "parse"); \
+    e(ConfigLintPhase::Apply, "apply"); \
+    e(ConfigLintPhase::Slots, "slots"); \
+    e(ConfigLintPhase::Arena, "arena"); \
+    e(ConfigLintPhase::Conds, "conds"); \
+    //
+
+// Errors & per-phase timing, collected while a config is linted
+struct ConfigLintReport {
+    vector<string> Errors;
+    vector<string> Unresolved; // lines naming plugins (which aren't loaded just to lint)
+    uint64_t PhaseNs[(int)ConfigLintPhase::Count] = {};
+    ConfigLintPhase Phase = ConfigLintPhase::None;
+    uint64_t PhaseStartNs = 0;
+
+    ConfigLintPhase Switch(ConfigLintPhase phase) {
+        uint64_t now = GHrClock.RealNowNs();
+        PhaseNs[(int)Phase] += now - PhaseStartNs;
+        PhaseStartNs = now;
+
+        ConfigLintPhase prev = Phase;
+        Phase = phase;
+        return prev;
+    }
+};
+
+// A config compiled ahead of time, so that switching to it needn't read it
+struct ConfigResident {
+    ConfigOps Ops;
+    vector<wstring> LoadedFiles;
+    vector<ConfigCacheFile> LoadedStats; // (parallel to LoadedFiles)
+    uint64_t MaxTime = 0;
+    bool UsesPlugins = false; // (compiled without loading them, so it's compiled again when switched to)
+};
+
+// The state of a compile in progress (see ConfigCompileFile) - on the dll thread, or in the background
+struct ConfigCompileState {
+    ConfigCustom *Custom = nullptr;
+    vector<wstring> LoadedFiles;
+    vector<ConfigCacheFile> LoadedStats; // (parallel to LoadedFiles)
+    unordered_set<wstring> LoadedSet;    // (same as LoadedFiles)
+    uint64_t MaxTime = 0;
+    unordered_map<wstring, UniquePtr<ConfigFileData>> ReadFiles;
+    ConfigCacheRecorder Cache;
+    string LoadLayer; // layer of the lines being loaded (normalized)
+};
+
+static thread_local ConfigCompileState *GConfigCompile = nullptr;
+static thread_local ConfigLintReport *GConfigLint = nullptr; // (only the linting thread's phases are timed)
+
 struct ConfigState {
     vector<wstring> LoadedFiles;
+    vector<ConfigCacheFile> LoadedStats; // (parallel to LoadedFiles)
+    vector<ConfigStagedMapping> StagedMappings; // moved to G.Arena once all ops are applied
+    unordered_map<uint64_t, vector<int>> StagedIndex; // indices into StagedMappings, by input & layer (see ConfigStagedKey)
     uint64_t MaxTime;
     Path MainFile;
     Path Directory;
@@ -14,34 +135,76 @@ struct ConfigState {
     vector<function<void(const string &)>> CustomVarCbs;
     vector<function<void(int, bool)>> CustomDeviceCbs;
     vector<function<void(bool)>> ConfigCbs;
+    bool UseCache = true;
+    bool ReadAhead = true;
+    DirWatcher Watcher; // of the directories of LoadedFiles
+    UserTimer WatchTimer;
+    unordered_map<wstring, UniquePtr<ConfigResident>> Residents; // by main file
+    bool PrecompilePending = false;
+    bool Precompiling = false; // (in the background)
+    int NumReloads = 0;
+    int NumFullApplies = 0; // (as opposed to incremental ones - for tests & benchmarks)
+
+    ConfigOps Ops;                         // of the applied config
+    vector<ConfigArenaEntry> ArenaEntries; // (parallel to G.Arena.Mappings)
+    vector<ImplInput *> ArenaInputs;       // inputs whose spans point into G.Arena
+    uint32_t MappedUsers = 0;              // users connected by mappings (bitmask)
+
+    // (while applying ops)
+    ConfigOp *ApplyOp = nullptr;
+    const ConfigOp *ReuseOp = nullptr; // an equal op of the previous config, whose slots are reused
+    int ApplyOpIdx = -1;
+    int ApplySub = 0;
+    bool SlotsExhausted = false;
 } GConfig;
 
-bool ConfigLoadFrom(const wchar_t *filename);
+// Times its scope as the given phase, if linting (nested scopes pause the outer ones)
+class ConfigLintScope {
+    ConfigLintPhase mPrev = ConfigLintPhase::None;
 
-void ConfigCreateResets(const SharedPtr<ImplMapping> &mapping, ImplCond *cond) {
-    do {
-        ImplInput *input = ImplGetInput(cond->Key, cond->User);
-        if (input) {
-            auto reset = SharedPtr<ImplReset>::New();
-            reset->Mapping = mapping;
-            reset->Next = input->Resets;
-            input->Resets = reset;
+public:
+    ConfigLintScope(ConfigLintPhase phase) {
+        if (GConfigLint) {
+            mPrev = GConfigLint->Switch(phase);
         }
+    }
 
-        if (cond->Child) {
-            ConfigCreateResets(mapping, cond->Child);
+    ~ConfigLintScope() {
+        if (GConfigLint) {
+            GConfigLint->Switch(mPrev);
         }
+    }
+};
 
-        cond = cond->Next;
-    } while (cond);
-}
+bool ConfigLoadFrom(const wchar_t *filename);
+static void ImplResolveAction(ImplMapping &mapping);
+static void ImplAbortInputs(const vector<ImplInput *> &inputs);
+
+// (reuses the slots of unchanged ops, so that their outputs stay consistent across an incremental reload)
+static slot_t ConfigAllocSlot(key_t key, user_t user) {
+    ConfigLintScope lintScope(ConfigLintPhase::Slots);
+    ConfigOp *op = GConfig.ApplyOp;
+    const ConfigOp *reuse = GConfig.ReuseOp;
+    size_t idx = op ? op->Slots.size() : 0;
+
+    slot_t slot;
+    if (reuse && idx < reuse->Slots.size() && reuse->Slots[idx].Key == key && reuse->Slots[idx].User == user) {
+        slot = reuse->Slots[idx].Slot;
+    } else {
+        slot = ImplAllocSlot(key, user, &GConfig.SlotsExhausted);
+    }
 
-bool ConfigLoadInputLine(const string &line) {
-    auto cfg = ConfigReadInputLine(GConfig.Custom, line);
-    if (!cfg) {
-        return false;
+    if (op) {
+        op->Slots.push_back({key, user, slot});
     }
+    return slot;
+}
 
+static uint64_t ConfigStagedKey(ImplInput *input, int layer) {
+    return ((uint64_t)(uintptr_t)input << 8) | (uint8_t)layer; // (user-space pointers fit in 56 bits)
+}
+
+bool ConfigAddMapping(SharedPtr<ImplMapping> cfg) {
     SharedPtr<ImplMapping> nextSrcCfg;
     if (cfg->SrcType.Relative && (cfg->Toggle || cfg->Turbo)) {
         LOG_W << "ERROR: toggle & turbo aren't supported for relative input" << END;
@@ -82,18 +245,20 @@ bool ConfigLoadInputLine(const string &line) {
         }
 
         while (cfg && cfg->DestKey) {
-            if (cfg->Conds && (!cfg->Add || cfg->Reset)) {
-                ConfigCreateResets(cfg, cfg->Conds);
-            }
-
             ImplInput *input = ImplGetInput(cfg->SrcKey, cfg->SrcUser);
             if (input) {
-                cfg->DestSlot = ImplAllocSlot(cfg->DestKey, cfg->DestUser);
-
-                if (!cfg->Replace) {
-                    cfg->Next = input->Mappings;
+                cfg->DestSlot = ConfigAllocSlot(cfg->DestKey, cfg->DestUser);
+                ImplResolveAction(*cfg);
+
+                auto &indices = GConfig.StagedIndex[ConfigStagedKey(input, cfg->Layer)];
+                if (cfg->Replace) {
+                    for (int index : indices) {
+                        GConfig.StagedMappings[index].Input = nullptr;
+                    }
+                    indices.clear();
                 }
-                input->Mappings = cfg;
+                indices.push_back((int)GConfig.StagedMappings.size());
+                GConfig.StagedMappings.push_back({input, cfg, GConfig.ApplyOpIdx, GConfig.ApplySub++});
 
                 if (cfg->SrcType.Source == MyVkSource::Keyboard) {
                     G.Keyboard.IsMapped = true;
@@ -105,6 +270,7 @@ bool ConfigLoadInputLine(const string &line) {
 
                 if (cfg->DestType.OfUser) {
                     G.Users[destUserIdx].Connected = true;
+                    GConfig.MappedUsers |= 1u << destUserIdx;
                 }
             }
 
@@ -119,6 +285,16 @@ bool ConfigLoadInputLine(const string &line) {
     return true;
 }
 
+bool ConfigLoadInputLine(string_view line, ConfigAuxInfo *auxInfo = nullptr) {
+    auto cfg = ConfigReadInputLine(*GConfigCompile->Custom, line, 0, auxInfo);
+    if (!cfg) {
+        return false;
+    }
+
+    GConfigCompile->Cache.AddMapping(*cfg, GConfigCompile->LoadLayer);
+    return true;
+}
+
 void ConfigLoadDevice(ConfigCustom &custom, user_t userIdx, const string &type) {
     ImplUser *user = ImplGetUser(userIdx, true);
     if (user) {
@@ -181,9 +357,7 @@ bool ConfigLoadPlugin(ConfigPlugin *plugin, const string &name) {
 
     GConfig.CurrPlugin = plugin;
 
-    if (G.Debug) {
-        LOG << "Loading plugin: " << path << END;
-    }
+    LOG_DEBUG << "Loading plugin: " << path << END;
 
     // Load it immediately, to allow registering config extensions
     // (note: this means calling dll load from dllmain, which is not legal but seems-ok)
@@ -197,62 +371,121 @@ bool ConfigLoadPlugin(ConfigPlugin *plugin, const string &name) {
     return ok;
 }
 
-void ConfigLoadVarLine(const string &line, intptr_t idx) {
-    ConfigReadVarLine(
-        GConfig.Custom, line, idx, [](auto, bool value, bool *ptr) { *ptr = value; }, [&line](ConfigVar var, const string &rest, user_t user) {
-        switch (var)
-        {
-        case ConfigVar::Include:
-            ConfigLoadInclude (rest);
-            break;
+void ConfigLoadStrVar(ConfigVar var, const string &rest, user_t user) {
+    switch (var) {
+    case ConfigVar::Include:
+        ConfigLoadInclude(rest);
+        break;
 
-        case ConfigVar::Device:
-            ConfigLoadDevice (GConfig.Custom, user, rest);
-            break;
+    case ConfigVar::Device: {
+        string typeLow = ConfigNormStr(rest);
+        ConfigTryGetPlugin(*GConfigCompile->Custom, &typeLow); // (loads the device's plugin now, if it has one)
+        GConfigCompile->Cache.AddStrVar(var, user, rest);
+    } break;
 
-        case ConfigVar::StickShape:
-            ConfigSetDeviceStickShape (user, rest);
-            break;
+    case ConfigVar::StickShape:
+        GConfigCompile->Cache.AddStrVar(var, user, rest);
+        break;
 
-        case ConfigVar::Comment:
-            break;
+    case ConfigVar::Comment:
+        break;
 
-        default:
-            if (var >= ConfigVar::CustomStart){
-                GConfig.CustomVarCbs[var - ConfigVar::CustomStart] (rest);
+    default:
+        if (var >= ConfigVar::CustomStart) {
+            GConfigCompile->Cache.AddStrVar(var, user, rest);
+        }
+        break;
+    }
 }
-            break;
-        } });
+
+void ConfigApplyStrVar(ConfigVar var, const string &value, user_t user) {
+    switch (var) {
+    case ConfigVar::Device:
+        ConfigLoadDevice(GConfig.Custom, user, value);
+        break;
+
+    case ConfigVar::StickShape:
+        ConfigSetDeviceStickShape(user, value);
+        break;
+
+    default:
+        if (var >= ConfigVar::CustomStart && (size_t)(var - ConfigVar::CustomStart) < GConfig.CustomVarCbs.size()) {
+            GConfig.CustomVarCbs[var - ConfigVar::CustomStart](value);
+        }
+        break;
+    }
 }
 
-bool ConfigLoadFrom(const wchar_t *filename) {
-    if (Find(GConfig.LoadedFiles, filename) >= 0) {
-        LOG_W << "ERROR: Duplicate loading of config " << filename << END;
+void ConfigLoadVarLine(string_view line, intptr_t idx, ConfigAuxInfo *auxInfo = nullptr) {
+    ConfigReadVarLine(
+        *GConfigCompile->Custom, line, idx, [](ConfigVar var, bool value, bool *ptr) { GConfigCompile->Cache.AddBoolVar(var, value); }, ConfigLoadStrVar, auxInfo);
+}
+
+// Reads the whole file with a single read
+bool ConfigReadFile(const wchar_t *path, string *contents) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.fail()) {
         return false;
     }
 
-    GConfig.LoadedFiles.push_back(filename);
+    contents->resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(contents->data(), contents->size());
+    return !file.fail();
+}
 
-    Path path = PathCombine(GConfig.Directory, filename);
-    LOG << "Loading config from: " << path << END;
-    std::ifstream file(path);
-    if (file.fail()) {
-        LOG_W << "ERROR: Failed to open: " << path << END;
+// (the include itself is done when the line is loaded)
+static bool ConfigFindInclude(string_view line, intptr_t idx, wstring *name) {
+    string_view key = ConfigReadToken(line, &idx);
+    const ConfigVar *var = ConfigVarNames.Find(ConfigNormStr(key));
+    if (!var || *var != ConfigVar::Include) {
         return false;
     }
 
-    GConfig.MaxTime = max(GConfig.MaxTime, GetFileLastWriteTime(path));
+    intptr_t validx = idx;
+    string_view val = ConfigReadToken(line, &idx);
+    if (val == "=") {
+        validx = idx;
+    }
+
+    *name = ConfigReadInclude(string(ConfigReadRest(line, &validx))).Get();
+    return true;
+}
 
-    string line;
+// Reads & splits a file - may be called from any thread
+static void ConfigReadFileData(ConfigFileData *file) {
+    Path path = PathCombine(GConfig.Directory, file->Name.c_str());
+    {
+        ConfigLintScope lintScope(ConfigLintPhase::Read);
+        file->Read = ConfigReadFile(path, &file->Contents);
+        if (!file->Read) {
+            return;
+        }
+
+        file->WriteTime = GetFileLastWriteTime(path);
+    }
+
+    ConfigLintScope lintScope(ConfigLintPhase::Split);
+    string_view rest = file->Contents;
     int inactiveDepth = 0;
-    while (getline(file, line)) {
+    int number = 0;
+    vector<string_view> groupLayers; // (of the enclosing active groups)
+    while (!rest.empty()) {
+        number++;
+        size_t lineEnd = rest.find('\n');
+        string_view line = rest.substr(0, lineEnd);
+        rest = lineEnd == string_view::npos ? string_view() : rest.substr(lineEnd + 1);
+        if (line.ends_with('\r')) {
+            line.remove_suffix(1);
+        }
+
         intptr_t idx = 0;
-        string token = ConfigReadToken(line, &idx);
+        string_view token = ConfigReadToken(line, &idx);
 
         if (token.empty()) {
             continue;
         } else if (token == "#") {
-            string subtoken = ConfigReadToken(line, &idx, true);
+            string_view subtoken = ConfigReadToken(line, &idx, true);
             if (subtoken == "[") {
                 inactiveDepth++;
             } else if (subtoken == "]" && inactiveDepth > 0) {
@@ -262,29 +495,301 @@ bool ConfigLoadFrom(const wchar_t *filename) {
         } else if (token == "[") {
             if (inactiveDepth > 0) {
                 inactiveDepth++;
+            } else {
+                // (groups within a layer's group are part of the layer)
+                // (marked with '!', as other groups are free-form titles - e.g. '[ Layer switching')
+                string_view layer = groupLayers.empty() ? string_view() : groupLayers.back();
+                if (ConfigReadToken(line, &idx) == "!" && ConfigNormStr(ConfigReadToken(line, &idx)) == "layer") {
+                    layer = ConfigReadRest(line, &idx);
+                }
+                groupLayers.push_back(layer);
             }
             continue;
         } else if (token == "]") {
             if (inactiveDepth > 0) {
                 inactiveDepth--;
+            } else if (!groupLayers.empty()) {
+                groupLayers.pop_back();
             }
             continue;
         } else if (inactiveDepth == 0) {
-            if (token == "!") {
-                ConfigLoadVarLine(line, idx);
+            bool isVar = token == "!";
+            file->Lines.push_back({line, idx, isVar, number, groupLayers.empty() ? string_view() : groupLayers.back()});
+
+            wstring include;
+            if (isVar && ConfigFindInclude(line, idx, &include)) {
+                file->Includes.push_back(move(include));
+            }
+        }
+    }
+}
+
+// Reads the config's files (following includes) on the thread pool, ahead of loading them in order
+static void ConfigReadAhead(const wchar_t *mainFile) {
+    vector<ConfigFileData *> wave;
+    auto add = [&](const wstring &name) {
+        auto &entry = GConfigCompile->ReadFiles[name];
+        if (!entry) {
+            entry = UniquePtr<ConfigFileData>::New();
+            entry->Name = name;
+            wave.push_back(entry.get());
+        }
+    };
+
+    add(mainFile);
+    while (!wave.empty()) {
+        vector<PTP_WORK> works;
+        for (ConfigFileData *file : wave) {
+            PTP_WORK work = CreateThreadpoolWork([](PTP_CALLBACK_INSTANCE, PVOID data, PTP_WORK) {
+                ConfigReadFileData((ConfigFileData *)data);
+            }, file, nullptr);
+
+            if (work) {
+                SubmitThreadpoolWork(work);
+                works.push_back(work);
             } else {
-                ConfigLoadInputLine(line);
+                ConfigReadFileData(file);
+            }
+        }
+
+        for (PTP_WORK work : works) {
+            WaitForThreadpoolWorkCallbacks(work, FALSE);
+            CloseThreadpoolWork(work);
+        }
+
+        vector<ConfigFileData *> done = move(wave);
+        wave.clear();
+        for (ConfigFileData *file : done) {
+            for (auto &include : file->Includes) {
+                add(include);
             }
         }
     }
+}
+
+static void ConfigLintAddError(const wchar_t *filename, const string &error, bool unresolved = false) {
+    if (GConfigLint) {
+        (unresolved ? GConfigLint->Unresolved : GConfigLint->Errors).push_back(string(PathToStr(filename).Get()) + ": " + error);
+    }
+}
+
+bool ConfigLoadFrom(const wchar_t *filename) {
+    if (!GConfigCompile->LoadedSet.insert(filename).second) {
+        LOG_W << "ERROR: Duplicate loading of config " << filename << END;
+        ConfigLintAddError(filename, "loaded more than once");
+        return false;
+    }
+
+    GConfigCompile->LoadedFiles.push_back(filename);
+
+    ConfigFileData *file;
+    ConfigFileData localFile;
+    auto iter = GConfigCompile->ReadFiles.find(filename);
+    if (iter != GConfigCompile->ReadFiles.end()) {
+        file = iter->second.get();
+    } else {
+        file = &localFile;
+        file->Name = filename;
+        ConfigReadFileData(file);
+    }
+
+    Path path = PathCombine(GConfig.Directory, filename);
+    LOG << "Loading config from: " << path << END;
+    if (!file->Read) {
+        LOG_W << "ERROR: Failed to open: " << path << END;
+        ConfigLintAddError(filename, "failed to open");
+        GConfigCompile->LoadedStats.push_back({});
+        GConfigCompile->Cache.AddFile(filename, {});
+        return false;
+    }
+
+    ConfigCacheFile stats = {file->WriteTime, file->Contents.size(), ConfigCacheHash(file->Contents)};
+    GConfigCompile->LoadedStats.push_back(stats);
+    GConfigCompile->MaxTime = max(GConfigCompile->MaxTime, file->WriteTime);
+    GConfigCompile->Cache.AddFile(filename, stats);
+
+    ConfigLintScope lintScope(ConfigLintPhase::Parse);
+    string outerLayer = GConfigCompile->LoadLayer; // (an included file is within the layer of its include line)
+    for (auto &line : file->Lines) {
+        GConfigCompile->LoadLayer = line.Layer.empty() ? outerLayer : ConfigNormStr(line.Layer);
+
+        ConfigCustom &custom = *GConfigCompile->Custom;
+        bool missedPlugin = custom.MissedPlugin;
+        custom.MissedPlugin = false;
+
+        ConfigAuxInfo auxInfo = {};
+        if (line.IsVar) {
+            ConfigLoadVarLine(line.Line, line.Idx, &auxInfo);
+        } else {
+            ConfigLoadInputLine(line.Line, &auxInfo);
+        }
+
+        // (a line naming a plugin that wasn't loaded can't be checked - it's not an error)
+        if (auxInfo.Error || custom.MissedPlugin) {
+            ConfigLintAddError(filename, std::to_string(line.Number) + ": " + string(line.Line), custom.MissedPlugin);
+        }
+        custom.MissedPlugin = custom.MissedPlugin || missedPlugin;
+    }
+
+    GConfigCompile->LoadLayer = move(outerLayer);
     return true;
 }
 
+static ImplCondList ConfigBuildConds(ImplArena &arena, ImplCond *conds, bool isAnd = true) {
+    ImplCondList list;
+    ImplCondMask mask;
+    bool hasMask = false;
+    vector<ImplCond *> rest;
+
+    for (ImplCond *cond = conds; cond; cond = cond->Next) {
+        // and-ed keyboard conditions are all checked at once
+        if (isAnd && G.Keyboard.Get(cond->Key)) {
+            auto &set = cond->Toggle ? (cond->State ? mask.ToggleSet : mask.ToggleClear) : (cond->State ? mask.DownSet : mask.DownClear);
+            set.Set(cond->Key, true);
+            hasMask = true;
+        } else {
+            rest.push_back(cond);
+        }
+    }
+
+    list.Conds.Begin = (uint32_t)arena.Conds.size();
+    list.Conds.Count = (uint32_t)rest.size();
+    for (ImplCond *cond : rest) {
+        auto &flatCond = arena.Conds.emplace_back(*cond);
+        flatCond.Child = flatCond.Next = nullptr;
+        flatCond.Input = ImplGetInput(cond->Key, cond->User);
+    }
+
+    for (uint32_t i = 0; i < list.Conds.Count; i++) {
+        ImplCond *cond = rest[i];
+        if (cond->Child) {
+            ImplCondList childList = ConfigBuildConds(arena, cond->Child, cond->Key == MY_VK_META_COND_AND);
+            arena.Conds[list.Conds.Begin + i].ChildList = childList;
+        }
+    }
+
+    if (hasMask) {
+        arena.CondMasks.push_back(mask);
+        list.MaskIdx = (uint32_t)arena.CondMasks.size();
+    }
+    return list;
+}
+
+static void ConfigSortStaged(vector<ConfigStagedMapping> &staged) {
+    // grouped by input and then by layer, newest first within each
+    std::erase_if(staged, [](const ConfigStagedMapping &entry) { return !entry.Input; });
+    std::reverse(staged.begin(), staged.end());
+    std::stable_sort(staged.begin(), staged.end(), [](const ConfigStagedMapping &left, const ConfigStagedMapping &right) {
+        if (left.Input != right.Input) {
+            return std::less<ImplInput *>()(left.Input, right.Input);
+        }
+        return left.Mapping->Layer < right.Mapping->Layer;
+    });
+}
+
+struct ConfigResetDep {
+    ImplInput *Input;
+    bool OnPress;
+    ImplMapping *Mapping;
+
+    auto operator<=>(const ConfigResetDep &other) const = default;
+};
+
+// adds the inputs whose press or release can make the conditions stop holding
+// (a mapping's reset is checked only on these edges - not, as before, on every edge of every key in its conditions.
+//  the other edges can only make the conditions hold, so checking them never reset anything while the conditions held)
+static void ConfigAddResetDeps(vector<ConfigResetDep> &deps, ImplMapping *mapping, ImplCond *cond, bool positive = true) {
+    for (; cond; cond = cond->Next) {
+        ImplInput *input = ImplGetInput(cond->Key, cond->User);
+        if (input) {
+            bool onPress = cond->Toggle || cond->State != positive;
+            deps.push_back({input, onPress, mapping});
+        }
+
+        if (cond->Child) {
+            ConfigAddResetDeps(deps, mapping, cond->Child, positive == cond->State);
+        }
+    }
+}
+
+static void ConfigBuildArena() {
+    ConfigLintScope lintScope(ConfigLintPhase::Arena);
+    auto &arena = G.Arena;
+    auto &mappings = GConfig.StagedMappings;
+
+    GConfig.StagedIndex.clear(); // (invalidated by the sort)
+    ConfigSortStaged(mappings);
+    vector<ConfigResetDep> deps;
+    GConfig.ArenaEntries.clear();
+    GConfig.ArenaInputs.clear();
+
+    arena.Mappings.reserve(mappings.size());
+    ImplInput *prevInput = nullptr;
+    for (auto &entry : mappings) {
+        ImplInput *input = entry.Input;
+        if (input != prevInput) {
+            GConfig.ArenaInputs.push_back(input);
+            prevInput = input;
+        }
+
+        // (the base layer's mappings are in Mappings, the rest are in LayerSpans)
+        int layer = entry.Mapping->Layer;
+        if (layer && !(input->LayerMask & (1ull << layer))) {
+            if (!input->LayerSpans.Count) {
+                input->LayerSpans.Begin = (uint32_t)arena.LayerSpans.size();
+            }
+            input->LayerSpans.Count++;
+            input->LayerMask |= 1ull << layer;
+            arena.LayerSpans.push_back({});
+        }
+
+        ImplSpan &range = layer ? arena.LayerSpans.back() : input->Mappings;
+        if (!range.Count) {
+            range.Begin = (uint32_t)arena.Mappings.size();
+        }
+        range.Count++;
+        GConfig.ArenaEntries.push_back({entry.Input, entry.Op, entry.Sub});
+
+        auto &mapping = arena.Mappings.emplace_back(*entry.Mapping);
+        mapping.Next = nullptr;
+        mapping.Conds = nullptr;
+        {
+            ConfigLintScope condsScope(ConfigLintPhase::Conds);
+            mapping.CondList = ConfigBuildConds(arena, entry.Mapping->Conds);
+        }
+
+        if (entry.Mapping->Conds && (!mapping.Add || mapping.Reset)) {
+            ConfigAddResetDeps(deps, &mapping, entry.Mapping->Conds);
+        }
+    }
+
+    // (a mapping may depend on the same input several times)
+    std::sort(deps.begin(), deps.end());
+    deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+
+    arena.Resets.reserve(deps.size());
+    for (auto &dep : deps) {
+        ImplSpan &range = dep.OnPress ? dep.Input->PressResets : dep.Input->ReleaseResets;
+        if (!range.Count) {
+            range.Begin = (uint32_t)arena.Resets.size();
+            GConfig.ArenaInputs.push_back(dep.Input);
+        }
+        range.Count++;
+
+        arena.Resets.push_back(dep.Mapping);
+    }
+
+    mappings.clear();
+}
+
 void ConfigReset() {
     G.Reset();
 
-    GConfig.LoadedFiles.clear();
-    GConfig.MaxTime = 0;
+    GConfig.StagedMappings.clear();
+    GConfig.StagedIndex.clear();
+    GConfig.ArenaEntries.clear();
+    GConfig.ArenaInputs.clear();
+    GConfig.MappedUsers = 0;
 }
 
 void ConfigCallReloadCbs(bool after) {
@@ -316,37 +821,805 @@ static void ConfigFinalizeUser(int idx, ImplUser *user) {
     }
 }
 
-static void ConfigReloadNoUpdate() {
-    ConfigReset();
-    ConfigCallReloadCbs(false);
+// (per architecture, as the 32 & 64-bit hooks may load the same config, with different key & var ids)
+// Whether a loaded file still has the contents recorded in 'file' - by write time & size ('statValid'), or else by hash
+// (e.g. if touched, or restored with an older write time)
+static bool ConfigIsFileUnchanged(const wchar_t *name, const ConfigCacheFile &file, bool statValid) {
+    if (statValid) {
+        return true;
+    }
+
+    string contents;
+    return file.WriteTime && ConfigReadFile(PathCombine(GConfig.Directory, name), &contents) &&
+           contents.size() == file.Size && ConfigCacheHash(contents) == file.Hash;
+}
+
+Path ConfigGetCachePath(const wchar_t *mainFile) {
+#ifdef _WIN64
+    const wchar_t *ext = L"x64.cache";
+#else
+    const wchar_t *ext = L"Win32.cache";
+#endif
+    return PathCombineExt(PathCombine(GConfig.Directory, mainFile), ext);
+}
+
+// Splits the ops into ConfigOps::Ops, checking that they're well-formed
+static bool ConfigSplitOps(ConfigOps *ops, int64_t numOps) {
+    ConfigCacheReader reader(ops->Data);
+    for (int64_t i = 0; i < numOps; i++) {
+        const uint8_t *start = reader.Ptr();
+        if (!ConfigCacheSkipOp(reader)) {
+            return false;
+        }
+
+        ops->Ops.push_back({(uint32_t)(start - ops->Data.data()), (uint32_t)(reader.Ptr() - start)});
+    }
+    return reader.AtEnd();
+}
+
+// Compiles the config from its cache, if the cache is still valid
+static bool ConfigCompileFromCache(const wchar_t *cachePath, ConfigOps *ops) {
+    ConfigCacheView view;
+    if (!view.Open(cachePath)) {
+        return false;
+    }
+
+    ConfigCacheReader reader(view.Data());
+    int64_t numOps = ConfigCacheReadHeader(reader, GConfig.Directory, [](const wstring &name, const ConfigCacheFile &file, uint64_t writeTime, bool statValid) {
+        if (!ConfigIsFileUnchanged(name.c_str(), file, statValid)) {
+            return false;
+        }
+
+        GConfigCompile->LoadedFiles.push_back(name);
+        GConfigCompile->LoadedStats.push_back({writeTime, file.Size, file.Hash});
+        GConfigCompile->MaxTime = max(GConfigCompile->MaxTime, writeTime);
+        return true;
+    });
+
+    if (numOps < 0) {
+        return false;
+    }
+
+    span<const uint8_t> rest = reader.Rest();
+    ops->Data.assign(rest.begin(), rest.end());
+    if (!ConfigSplitOps(ops, numOps)) {
+        LOG_W << "ERROR: Invalid config cache: " << cachePath << END;
+        return false;
+    }
+
+    LOG << "Loaded config from cache: " << cachePath << END;
+    return true;
+}
+
+static void ConfigDumpConds(std::ofstream &out, const ImplCond *conds) {
+    for (const ImplCond *cond = conds; cond; cond = cond->Next) {
+        out << " ?" << (cond->Toggle ? "^" : "") << (cond->State ? "" : "~") << std::hex << cond->Key << std::dec << "@" << (int)cond->User;
+        if (cond->Child) {
+            out << " (";
+            ConfigDumpConds(out, cond->Child);
+            out << " )";
+        }
+    }
+}
+
+// Writes the contents of a cache as text, checking its source files against their recorded hashes
+bool ConfigDumpCache(const wchar_t *cachePath, const wchar_t *outPath) {
+    std::ofstream out(outPath);
+    if (out.fail()) {
+        LOG_W << "ERROR: Failed to open cache dump for writing: " << outPath << END;
+        return false;
+    }
+
+    ConfigCacheView view;
+    if (!view.Open(cachePath)) {
+        out << "cannot open " << cachePath << "\n";
+        return false;
+    }
+
+    bool valid = true;
+    ConfigCacheReader reader(view.Data());
+    int64_t numOps = ConfigCacheReadHeader(reader, GConfig.Directory, [&](const wstring &name, const ConfigCacheFile &file, uint64_t writeTime, bool statValid) {
+        string contents;
+        bool hashValid = ConfigReadFile(PathCombine(GConfig.Directory, name.c_str()), &contents) ? ConfigCacheHash(contents) == file.Hash : !file.Size;
+        out << "file " << name.c_str() << " size " << file.Size << " hash " << std::hex << file.Hash << std::dec
+            << (statValid ? "" : " (stale)") << (hashValid ? "" : " (hash mismatch)") << "\n";
+        valid = valid && statValid && hashValid;
+        return true;
+    });
+
+    if (numOps < 0) {
+        out << "invalid header (or from another build)\n";
+        return false;
+    }
+
+    for (int64_t i = 0; i < numOps && !reader.Failed(); i++) {
+        switch (reader.Read<ConfigCacheOp>()) {
+        case ConfigCacheOp::Mapping: {
+            string_view layer;
+            if (auto cfg = ConfigCacheReadMapping(reader, &layer)) {
+                out << "map " << std::hex << cfg->SrcKey << std::dec << "@" << (int)cfg->SrcUser << " : "
+                    << std::hex << cfg->DestKey << std::dec << "@" << (int)cfg->DestUser
+                    << " ~" << cfg->Strength << " ^" << cfg->Rate;
+                ConfigDumpConds(out, cfg->Conds);
+                if (cfg->Data) {
+                    out << " = " << *cfg->Data;
+                }
+                if (!layer.empty()) {
+                    out << " layer " << layer;
+                }
+                out << "\n";
+            }
+        } break;
+
+        case ConfigCacheOp::BoolVar: {
+            auto var = reader.Read<ConfigVar>();
+            bool value = reader.Read<bool>();
+            out << "var " << (int)var << " = " << value << "\n";
+        } break;
+
+        case ConfigCacheOp::StrVar: {
+            auto var = reader.Read<ConfigVar>();
+            user_t user = reader.Read<user_t>();
+            out << "var " << (int)var << "@" << (int)user << " = " << reader.ReadStr<char>() << "\n";
+        } break;
+
+        default:
+            reader.Fail();
+            break;
+        }
+    }
+
+    if (reader.Failed() || !reader.AtEnd()) {
+        out << "corrupt ops\n";
+        return false;
+    }
+
+    out << (valid ? "valid\n" : "stale\n");
+    return valid;
+}
 
-    if (!tstreq(GConfig.MainFile, ConfigEmpty)) {
-        if (!ConfigLoadFrom(GConfig.MainFile)) {
-            ConfigLoadFrom(ConfigDefault);
+static void ConfigCompileFromText(const wchar_t *mainFile, const wchar_t *cachePath, ConfigOps *ops, bool readAhead) {
+    GConfigCompile->Cache.Begin();
+
+    if (readAhead) {
+        ConfigReadAhead(mainFile);
+    }
+
+    if (!ConfigLoadFrom(mainFile)) {
+        ConfigLoadFrom(ConfigDefault);
+    }
+
+    GConfigCompile->ReadFiles.clear();
+
+    // (plugins register their keys & vars when loaded, which a cache can't reproduce)
+    ConfigCustom *custom = GConfigCompile->Custom;
+    if (cachePath && custom->Plugins.empty() && !custom->MissedPlugin) {
+        GConfigCompile->Cache.End(cachePath);
+    } else {
+        GConfigCompile->Cache.Abort();
+    }
+
+    span<const uint8_t> data = GConfigCompile->Cache.Ops();
+    ops->Data.assign(data.begin(), data.end());
+    ConfigSplitOps(ops, GConfigCompile->Cache.NumOps());
+}
+
+static void ConfigWatchLoadedFiles() {
+    GConfig.Watcher.Clear();
+    for (auto &filename : GConfig.LoadedFiles) {
+        Path dir = PathGetDirName(PathCombine(GConfig.Directory, filename.c_str()));
+        if (!GConfig.Watcher.Add(dir)) {
+            LOG_W << "ERROR: Failed to watch for config changes in: " << dir << END;
         }
     }
+}
+
+// Reads the config 'mainFile' (and its includes) into 'result', without applying anything yet
+// (changes no global state besides 'custom', so may be called in the background - if 'custom' doesn't load plugins)
+static void ConfigCompileFile(const wchar_t *mainFile, ConfigResident *result, ConfigCustom &custom, bool readAhead, bool useCache) {
+    ConfigCompileState state;
+    state.Custom = &custom;
+    GConfigCompile = &state;
+
+    if (!tstreq(mainFile, ConfigEmpty)) {
+        Path cachePath = useCache ? ConfigGetCachePath(mainFile) : Path();
+        if (!cachePath || !ConfigCompileFromCache(cachePath, &result->Ops)) {
+            state.LoadedFiles.clear();
+            state.LoadedStats.clear();
+            state.MaxTime = 0;
+            result->Ops = {};
+            ConfigCompileFromText(mainFile, cachePath, &result->Ops, readAhead);
+        }
+    }
+
+    GConfigCompile = nullptr;
+    result->LoadedFiles = move(state.LoadedFiles);
+    result->LoadedStats = move(state.LoadedStats);
+    result->MaxTime = state.MaxTime;
+    result->UsesPlugins = custom.MissedPlugin;
+}
+
+// Reads the current config (and its includes) into ops, without applying anything yet
+static void ConfigCompile(ConfigOps *ops, bool readAhead = GConfig.ReadAhead) {
+    ConfigResident result;
+    ConfigCompileFile(GConfig.MainFile, &result, GConfig.Custom, readAhead, GConfig.UseCache);
+    *ops = move(result.Ops);
+    GConfig.LoadedFiles = move(result.LoadedFiles);
+    GConfig.LoadedStats = move(result.LoadedStats);
+    GConfig.MaxTime = result.MaxTime;
+}
+
+// Applies the ops in order - or, if 'reuse' is given, only the mappings (reusing the slots of their equal ops in the previous config)
+// (if 'onlyMappings', the vars are skipped - they act on the process, e.g. creating devices)
+static void ConfigApplyOps(ConfigOps &ops, const vector<const ConfigOp *> *reuse = nullptr, bool onlyMappings = false) {
+    bool applyVars = !reuse && !onlyMappings;
+    int numDropped = 0;
+    ConfigLintScope lintScope(ConfigLintPhase::Apply);
+    for (int i = 0; i < (int)ops.Ops.size(); i++) {
+        ConfigOp &op = ops.Ops[i];
+        op.Slots.clear();
+
+        ConfigCacheReader reader(ops.Get(op));
+        switch (reader.Read<ConfigCacheOp>()) {
+        case ConfigCacheOp::Mapping: {
+            string_view layer;
+            if (auto cfg = ConfigCacheReadMapping(reader, &layer)) {
+                if (!layer.empty()) {
+                    cfg->Layer = (uint8_t)G.Layers.Get(string(layer));
+                    if (!cfg->Layer) {
+                        if (!numDropped++) {
+                            LOG_W << "ERROR: Too many layers (max " << ImplLayers::Max - 1 << "), ignoring the mappings of: " << layer << END;
+                        }
+                        break;
+                    }
+                }
+
+                GConfig.ApplyOp = &op;
+                GConfig.ReuseOp = reuse ? (*reuse)[i] : nullptr;
+                GConfig.ApplyOpIdx = i;
+                GConfig.ApplySub = 0;
+                ConfigAddMapping(cfg);
+            }
+        } break;
+
+        case ConfigCacheOp::BoolVar:
+            if (applyVars) {
+                bool *ptr = ConfigCacheGetBoolVar(reader.Read<ConfigVar>());
+                bool value = reader.Read<bool>();
+                if (ptr) {
+                    *ptr = value;
+                }
+            }
+            break;
+
+        case ConfigCacheOp::StrVar:
+            if (applyVars) {
+                ConfigVar var = reader.Read<ConfigVar>();
+                user_t user = reader.Read<user_t>();
+                ConfigApplyStrVar(var, string(reader.ReadStr<char>()), user);
+            }
+            break;
+        }
+    }
+
+    GConfig.ApplyOp = nullptr;
+    GConfig.ReuseOp = nullptr;
+    GConfig.ApplyOpIdx = -1;
+
+    if (numDropped > 1) {
+        LOG_W << "ERROR: Too many layers, ignored " << numDropped << " mappings in all" << END;
+    }
+}
+
+static void ConfigApplyNoUpdate(ConfigOps &&ops) {
+    ConfigReset();
+    ConfigCallReloadCbs(false);
+
+    ConfigApplyOps(ops);
+    G.UpdateLogMask();
+    GEventTrace.SetEnabled(G.EventTrace);
+    ConfigBuildArena();
 
     // for now, we leak any old Device (this is relied upon by e.g. ThreadPoolNotificationRegister, could refcount?)
     // (note: the device is accessed from other threads for short durations as well...)
     for (int i = 0; i < IMPL_MAX_USERS; i++) {
         ConfigFinalizeUser(i, &G.Users[i]);
     }
+
+    GConfig.Ops = move(ops);
     ConfigCallReloadCbs(true);
 }
 
+static void ConfigApplyFull(ConfigOps &&ops) {
+    GConfig.NumFullApplies++;
+    ImplAbortMappings();
+    ConfigSendGlobalEvents(false);
+    ConfigApplyNoUpdate(move(ops));
+    ConfigSendGlobalEvents(true);
+    UpdateAll();
+}
+
+// Applies a config whose ops differ from the applied one only in mappings,
+// keeping the devices as well as the state of the unchanged mappings.
+// Returns false if a full reload is needed instead - which the caller must then do, as by then the staged mappings,
+// slots, mapped inputs & connected users may already have changed
+static bool ConfigApplyIncremental(ConfigOps &ops) {
+    ConfigOps &prev = GConfig.Ops;
+
+    // (reversed, so that equal mappings are matched in order)
+    unordered_map<string_view, vector<int>> prevMappings;
+    for (int i = (int)prev.Ops.size() - 1; i >= 0; i--) {
+        if (prev.Type(prev.Ops[i]) == ConfigCacheOp::Mapping) {
+            auto data = prev.Get(prev.Ops[i]);
+            prevMappings[string_view((const char *)data.data(), data.size())].push_back(i);
+        }
+    }
+
+    vector<span<const uint8_t>> vars, prevVars;
+    for (auto &op : prev.Ops) {
+        if (prev.Type(op) != ConfigCacheOp::Mapping) {
+            prevVars.push_back(prev.Get(op));
+        }
+    }
+
+    vector<const ConfigOp *> reuse(ops.Ops.size());
+    vector<bool> prevMatched(prev.Ops.size());
+    int numAdded = 0;
+    for (size_t i = 0; i < ops.Ops.size(); i++) {
+        auto data = ops.Get(ops.Ops[i]);
+        if (ops.Type(ops.Ops[i]) != ConfigCacheOp::Mapping) {
+            vars.push_back(data);
+            continue;
+        }
+
+        auto iter = prevMappings.find(string_view((const char *)data.data(), data.size()));
+        if (iter != prevMappings.end() && !iter->second.empty()) {
+            int prevIdx = iter->second.back();
+            iter->second.pop_back();
+            reuse[i] = &prev.Ops[prevIdx];
+            prevMatched[prevIdx] = true;
+        } else {
+            numAdded++;
+        }
+    }
+
+    // (vars - e.g. devices - are applied only by a full reload)
+    if (!std::equal(vars.begin(), vars.end(), prevVars.begin(), prevVars.end(),
+                    [](span<const uint8_t> left, span<const uint8_t> right) { return std::ranges::equal(left, right); })) {
+        return false;
+    }
+
+    // the slots of removed mappings are free for the added ones (the unchanged ones keep theirs)
+    for (size_t i = 0; i < prev.Ops.size(); i++) {
+        if (!prevMatched[i]) {
+            for (auto &slot : prev.Ops[i].Slots) {
+                ImplFreeSlot(slot.Key, slot.User, slot.Slot);
+            }
+        }
+    }
+
+    uint32_t prevMappedUsers = GConfig.MappedUsers;
+    GConfig.StagedMappings.clear();
+    GConfig.StagedIndex.clear();
+    GConfig.MappedUsers = 0;
+    GConfig.SlotsExhausted = false;
+    G.Keyboard.IsMapped = G.Mouse.IsMapped = false;
+
+    ConfigApplyOps(ops, &reuse);
+
+    if (GConfig.SlotsExhausted || GConfig.MappedUsers != prevMappedUsers) {
+        return false;
+    }
+
+    // release the inputs whose mappings changed, as a full reload would (while their old mappings are still in place)
+    vector<ImplInput *> changed;
+    for (auto &entry : GConfig.ArenaEntries) {
+        if (!prevMatched[entry.Op]) {
+            changed.push_back(entry.Input);
+        }
+    }
+    for (auto &staged : GConfig.StagedMappings) {
+        if (staged.Input && !reuse[staged.Op]) {
+            changed.push_back(staged.Input);
+        }
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    ImplAbortInputs(changed);
+
+    ImplArena prevArena = move(G.Arena);
+    vector<ConfigArenaEntry> prevEntries = move(GConfig.ArenaEntries);
+    G.Arena.Reset();
+
+    for (ImplInput *input : GConfig.ArenaInputs) {
+        input->Mappings = input->PressResets = input->ReleaseResets = input->LayerSpans = {};
+        input->LayerMask = 0;
+    }
+
+    ConfigBuildArena();
+
+    // the unchanged mappings carry on from where they were
+    unordered_map<uint64_t, ImplMapping *> prevByOp;
+    for (size_t i = 0; i < prevEntries.size(); i++) {
+        prevByOp[((uint64_t)prevEntries[i].Op << 32) | (uint32_t)prevEntries[i].Sub] = &prevArena.Mappings[i];
+    }
+
+    for (size_t i = 0; i < GConfig.ArenaEntries.size(); i++) {
+        auto &entry = GConfig.ArenaEntries[i];
+        const ConfigOp *prevOp = reuse[entry.Op];
+        if (!prevOp) {
+            continue;
+        }
+
+        auto iter = prevByOp.find(((uint64_t)(prevOp - prev.Ops.data()) << 32) | (uint32_t)entry.Sub);
+        if (iter != prevByOp.end()) {
+            ImplMapping &mapping = G.Arena.Mappings[i];
+            ImplMapping *prevMapping = iter->second;
+            mapping.PassedCond = prevMapping->PassedCond;
+            mapping.TurboValue = prevMapping->TurboValue;
+            mapping.ToggleValue = prevMapping->ToggleValue;
+            mapping.Timer.TakeOver(prevMapping->Timer, &mapping);
+        }
+    }
+
+    int numRemoved = (int)std::count(prevMatched.begin(), prevMatched.end(), false) - (int)prevVars.size();
+    LOG << "Reloaded config incrementally (" << numAdded << " mappings added, " << numRemoved << " removed)" << END;
+
+    GConfig.Ops = move(ops);
+    return true;
+}
+
+// (checked as a cache is - see ConfigCompileFromCache - so deleted files and files restored with older times are noticed)
+static bool ConfigIsResidentCurrent(const ConfigResident &resident) {
+    for (size_t i = 0; i < resident.LoadedFiles.size(); i++) {
+        const wchar_t *name = resident.LoadedFiles[i].c_str();
+        const ConfigCacheFile &file = resident.LoadedStats[i];
+
+        uint64_t writeTime, size;
+        if (!GetFileStat(PathCombine(GConfig.Directory, name), &writeTime, &size)) {
+            writeTime = size = 0;
+        }
+        if (!ConfigIsFileUnchanged(name, file, writeTime == file.WriteTime && size == file.Size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Configs to precompile in the background, and their results
+struct ConfigPrecompileJob {
+    vector<wstring> Targets;
+    vector<UniquePtr<ConfigResident>> Results;
+    bool UseCache = true;
+};
+
+static void ConfigPrecompileRun(ConfigPrecompileJob *job) {
+    for (auto &target : job->Targets) {
+        // (a plugin is loaded only once its config is switched to - and not from the background)
+        ConfigCustom custom;
+        custom.NoLoad = true;
+
+        auto resident = UniquePtr<ConfigResident>::New();
+        ConfigCompileFile(target.c_str(), resident, custom, false, job->UseCache);
+        job->Results.push_back(move(resident));
+    }
+}
+
+static void ConfigRequestPrecompile();
+
+static void ConfigPrecompileDone(ConfigPrecompileJob *job, bool background) {
+    DBG_ASSERT_DLL_THREAD();
+    for (size_t i = 0; i < job->Targets.size(); i++) {
+        GConfig.Residents[job->Targets[i]] = move(job->Results[i]);
+    }
+    delete job;
+
+    if (background) {
+        GConfig.Precompiling = false;
+        if (GConfig.PrecompilePending) { // (requested while this job was running)
+            GConfig.PrecompilePending = false;
+            ConfigRequestPrecompile();
+        }
+    }
+}
+
+// Keeps the current config resident, and precompiles the configs its LoadConfig mappings switch to
+// (in the background - unless 'wait' - as the dll thread must stay responsive to the hooks)
+static void ConfigPrecompileTargets(bool wait = false) {
+    DBG_ASSERT_DLL_THREAD();
+    if (GConfig.Precompiling && !wait) {
+        return; // (will be requested again once done)
+    }
+    GConfig.PrecompilePending = false;
+
+    auto current = UniquePtr<ConfigResident>::New();
+    current->Ops = GConfig.Ops;
+    current->LoadedFiles = GConfig.LoadedFiles;
+    current->LoadedStats = GConfig.LoadedStats;
+    current->MaxTime = GConfig.MaxTime;
+    GConfig.Residents[GConfig.MainFile.Get()] = move(current);
+
+    auto job = new ConfigPrecompileJob();
+    job->UseCache = GConfig.UseCache;
+    for (auto &mapping : G.Arena.Mappings) {
+        if (mapping.DestKey == MY_VK_LOAD_CONFIG && mapping.Data) {
+            wstring target = PathCombineExt(PathFromStr(mapping.Data->c_str()), L"ini").Get();
+
+            auto iter = GConfig.Residents.find(target);
+            if ((iter == GConfig.Residents.end() || !ConfigIsResidentCurrent(*iter->second)) &&
+                std::find(job->Targets.begin(), job->Targets.end(), target) == job->Targets.end()) {
+                job->Targets.push_back(move(target));
+            }
+        }
+    }
+
+    if (job->Targets.empty()) {
+        delete job;
+        return;
+    }
+
+    if (!wait) {
+        GConfig.Precompiling = true;
+        if (TrySubmitThreadpoolCallback([](PTP_CALLBACK_INSTANCE, PVOID data) {
+                ConfigPrecompileRun((ConfigPrecompileJob *)data);
+                PostAppCallback([](void *data) { ConfigPrecompileDone((ConfigPrecompileJob *)data, true); }, data);
+            }, job, nullptr)) {
+            return;
+        }
+
+        LOG_W << "ERROR: Failed to precompile configs in the background: " << GetLastError() << END;
+        GConfig.Precompiling = false;
+    }
+
+    ConfigPrecompileRun(job);
+    ConfigPrecompileDone(job, false);
+}
+
+static void ConfigRequestPrecompile() {
+    if (!GConfig.PrecompilePending) {
+        GConfig.PrecompilePending = true;
+        PostAppCallback([] { ConfigPrecompileTargets(); });
+    }
+}
+
 void ConfigInit(Path &&path, Path &&name) {
     GConfig.Directory = move(path);
     GConfig.MainFile = move(name);
-    ConfigReloadNoUpdate();
+
+    ConfigOps ops;
+    ConfigCompile(&ops, false); // (called from dllmain, where waiting on other threads may deadlock)
+    ConfigWatchLoadedFiles();
+    ConfigApplyNoUpdate(move(ops));
     ConfigSendGlobalEvents(true, true);
+    ConfigRequestPrecompile();
+}
+
+// Reloads everything, as if the config were loaded anew
+void ConfigReloadFull() {
+    ConfigOps ops;
+    ConfigCompile(&ops);
+    ConfigWatchLoadedFiles();
+    ConfigApplyFull(move(ops));
+    ConfigRequestPrecompile();
+}
+
+static void ConfigApplyChanged(ConfigOps &&ops) {
+    // (plugins are told of every reload, and may keep state about the config)
+    if (!GConfig.Custom.Plugins.empty()) {
+        ConfigApplyFull(move(ops));
+    } else if (ops.Data == GConfig.Ops.Data) {
+        LOG << "Config unchanged" << END;
+    } else if (ConfigApplyIncremental(ops)) {
+        UpdateAll();
+    } else {
+        ConfigApplyFull(move(ops));
+    }
+
+    ConfigRequestPrecompile();
 }
 
 void ConfigReload() {
-    ImplAbortMappings();
-    ConfigSendGlobalEvents(false);
-    ConfigReloadNoUpdate();
-    ConfigSendGlobalEvents(true);
-    UpdateAll();
+    GConfig.NumReloads++;
+    ConfigOps ops;
+    ConfigCompile(&ops);
+    ConfigWatchLoadedFiles();
+    ConfigApplyChanged(move(ops));
+}
+
+// Switches to another config - without reading it, if it's resident & unchanged since compiled
+// (as with reloads, mappings that are the same in both configs carry on undisturbed)
+void ConfigSwitch(Path &&mainFile) {
+    auto iter = GConfig.Residents.find(mainFile.Get());
+    GConfig.MainFile = move(mainFile);
+
+    if (iter != GConfig.Residents.end() && !iter->second->UsesPlugins && ConfigIsResidentCurrent(*iter->second)) {
+        ConfigResident &resident = *iter->second;
+        GConfig.LoadedFiles = resident.LoadedFiles;
+        GConfig.LoadedStats = resident.LoadedStats;
+        GConfig.MaxTime = resident.MaxTime;
+        ConfigWatchLoadedFiles();
+        ConfigApplyChanged(ConfigOps(resident.Ops));
+    } else {
+        ConfigReload();
+    }
+}
+
+static void ConfigLintWriteKey(std::ofstream &out, key_t key) {
+    switch (key) {
+#define CONFIG_ON_KEY(vk, pname, desc, group, name, ...) \
+    case vk:                                             \
+        out << pname;                                    \
+        break;
+        ENUMERATE_KEYS_WITHOUT_SIMPLE(CONFIG_ON_KEY);
+#undef CONFIG_ON_KEY
+
+    default:
+        if ((key >= 'A' && key <= 'Z') || (key >= '0' && key <= '9')) {
+            out << (char)key;
+        } else {
+            out << "#" << std::hex << key << std::dec;
+        }
+        break;
+    }
+}
+
+static void ConfigLintWriteUser(std::ofstream &out, user_t user) {
+    if (user >= 0) {
+        out << "@" << user + 1;
+    }
+}
+
+// Sets the applied config's state (its arena, slots, mapped inputs & users, and layers) aside, leaving a blank one
+// to apply another config's mappings to - e.g. for linting it - without disturbing the live one.
+// Restored on destruction. (the vars aren't included - they mustn't be applied meanwhile)
+class ConfigScratchScope {
+    struct UserSave {
+        bool Connected, DeviceSpecified;
+        ImplStickShape StickShape;
+        ImplStateData State;
+        UserTimerRun MotionTimer;
+    };
+
+    vector<ImplInput> mKeys;
+    ImplKeySet mToggle;
+    bool mKeyboardMapped;
+    ImplMouse mMouse;
+    vector<ImplInput> mCustomKeys;
+    ImplArena mArena;
+    ImplLayers mLayers;
+    UserSave mUsers[IMPL_MAX_USERS];
+    vector<ConfigArenaEntry> mArenaEntries;
+    vector<ImplInput *> mArenaInputs;
+    uint32_t mMappedUsers;
+    bool mSlotsExhausted;
+
+public:
+    ConfigScratchScope() : mKeys(G.Keyboard.Keys, G.Keyboard.Keys + ImplKeyboard::Count), mToggle(G.Keyboard.Toggle),
+                           mKeyboardMapped(G.Keyboard.IsMapped), mMouse(G.Mouse),
+                           mArena(move(G.Arena)), mLayers(move(G.Layers)), // (moved, so the live mappings & their timers stay put)
+                           mArenaEntries(move(GConfig.ArenaEntries)), mArenaInputs(move(GConfig.ArenaInputs)),
+                           mMappedUsers(GConfig.MappedUsers), mSlotsExhausted(GConfig.SlotsExhausted) {
+        for (auto &custom : G.CustomKeys) {
+            mCustomKeys.push_back(custom->Key);
+            custom->Key.Reset();
+        }
+
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            auto &user = G.Users[i];
+            mUsers[i] = {user.Connected, user.DeviceSpecified, user.StickShape, user.State, user.State.Motion.Timer.Suspend()};
+            user.Connected = user.DeviceSpecified = false;
+            user.StickShape = ImplStickShape::Default;
+            user.State.Reset();
+        }
+
+        G.Keyboard.Reset();
+        G.Mouse.Reset();
+        G.Keyboard.IsMapped = G.Mouse.IsMapped = false;
+        G.Arena.Reset();
+        G.Layers.Reset();
+        GConfig.ArenaEntries.clear();
+        GConfig.ArenaInputs.clear();
+        GConfig.MappedUsers = 0;
+    }
+
+    ConfigScratchScope(const ConfigScratchScope &) = delete;
+
+    ~ConfigScratchScope() {
+        std::copy(mKeys.begin(), mKeys.end(), G.Keyboard.Keys);
+        G.Keyboard.Toggle = mToggle;
+        G.Keyboard.IsMapped = mKeyboardMapped;
+        G.Mouse = mMouse;
+
+        for (size_t i = 0; i < mCustomKeys.size(); i++) {
+            G.CustomKeys[i]->Key = mCustomKeys[i];
+        }
+
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            auto &user = G.Users[i];
+            user.Connected = mUsers[i].Connected;
+            user.DeviceSpecified = mUsers[i].DeviceSpecified;
+            user.StickShape = mUsers[i].StickShape;
+            (ImplStateData &)user.State = mUsers[i].State;
+            user.State.Motion.Timer.Resume(mUsers[i].MotionTimer);
+        }
+
+        G.Arena = move(mArena);
+        G.Layers = move(mLayers);
+        GConfig.ArenaEntries = move(mArenaEntries);
+        GConfig.ArenaInputs = move(mArenaInputs);
+        GConfig.MappedUsers = mMappedUsers;
+        GConfig.SlotsExhausted = mSlotsExhausted;
+    }
+};
+
+// Compiles the config 'mainFile' from text and applies its mappings on a scratch state (see ConfigScratchScope),
+// writing its errors (with line numbers), the resulting mappings (with their slots) and the time spent in each phase
+// to 'outPath'. The current config isn't affected. Returns whether there were no errors
+bool ConfigLint(const wchar_t *mainFile, const wchar_t *outPath) {
+    std::ofstream out(outPath);
+    if (out.fail()) {
+        LOG_W << "ERROR: Failed to open lint output for writing: " << outPath << END;
+        return false;
+    }
+
+    ConfigLintReport report;
+    GConfigLint = &report;
+    report.Switch(ConfigLintPhase::None);
+
+    // (plugins aren't loaded, as they'd stay loaded in the process - the lines naming them are reported as unresolved)
+    ConfigCustom custom;
+    custom.NoLoad = true;
+
+    ConfigResident compiled;
+    ConfigCompileFile(mainFile, &compiled, custom, false, false); // (not from cache, so that all phases run, serially)
+
+    ConfigScratchScope scratch;
+    ConfigApplyOps(compiled.Ops, nullptr, true);
+    ConfigBuildArena();
+
+    report.Switch(ConfigLintPhase::None);
+    GConfigLint = nullptr;
+
+    for (auto &file : compiled.LoadedFiles) {
+        out << "file " << file.c_str() << "\n";
+    }
+
+    for (auto &error : report.Errors) {
+        out << "error " << error << "\n";
+    }
+
+    for (auto &line : report.Unresolved) {
+        out << "unresolved " << line << "\n";
+    }
+
+    for (size_t i = 0; i < G.Arena.Mappings.size(); i++) {
+        auto &mapping = G.Arena.Mappings[i];
+        auto &entry = GConfig.ArenaEntries[i];
+
+        out << "map ";
+        ConfigLintWriteKey(out, mapping.SrcKey);
+        ConfigLintWriteUser(out, mapping.SrcUser);
+        out << " : ";
+        ConfigLintWriteKey(out, mapping.DestKey);
+        ConfigLintWriteUser(out, mapping.DestUser);
+        out << " slot " << (int)mapping.DestSlot << " op " << entry.Op;
+        if (mapping.Layer) {
+            out << " layer " << G.Layers.Names[mapping.Layer];
+        }
+        if (mapping.CondList.Conds.Count || mapping.CondList.MaskIdx) {
+            out << " conds " << mapping.CondList.Conds.Count << (mapping.CondList.MaskIdx ? "+mask" : "");
+        }
+        out << "\n";
+    }
+
+#define CONFIG_ON_PHASE(phase, name) \
+    out << "time " << name << " " << report.PhaseNs[(int)phase] / 1000 << "us\n"
+    ENUMERATE_CONFIG_LINT_PHASES(CONFIG_ON_PHASE);
+#undef CONFIG_ON_PHASE
+
+    LOG << "Linted config: " << report.Errors.size() << " errors, " << report.Unresolved.size() << " unresolved, " << G.Arena.Mappings.size() << " mappings" << END;
+    return report.Errors.empty();
 }
 
 void ConfigReloadIfNeeded() {
@@ -362,9 +1635,21 @@ void ConfigReloadIfNeeded() {
     }
 }
 
+constexpr double ConfigWatchDelay = 0.1; // (editors may write a file in several steps)
+
+// Called when the Watcher's handles are signalled - reloads once the changes settle
+void ConfigCheckWatcher() {
+    if (GConfig.Watcher.Check()) {
+        GConfig.WatchTimer.StartS(ConfigWatchDelay, [](void *, hrtime_t) {
+            if (G.AutoReload) {
+                ConfigReloadIfNeeded();
+            }
+        }, nullptr);
+    }
+}
+
 void ConfigLoad(const wchar_t *name) {
-    GConfig.MainFile = PathCombineExt(name, L"ini");
-    ConfigReload();
+    ConfigSwitch(PathCombineExt(name, L"ini"));
 }
 
 bool ConfigCheckCurrPlugin() {
@@ -0,0 +1,438 @@
+#pragma once
+#include "ConfigRead.h"
+#include <fstream>
+
+// A compiled form of a config (with its includes), so later loads can skip reading & parsing the text
+// File format: ConfigCacheHeader, the source files (ConfigCacheFile + name), then the ops (ConfigCacheOp + payload)
+// Valid only while all source files are unchanged (by write time & size, or else by contents hash), and only for the build
+// (and architecture - see ConfigGetCachePath) that wrote it
+
+#pragma pack(push, 1)
+struct ConfigCacheHeader {
+    static constexpr uint32_t MagicValue = 0x4349594d; // "MYIC"
+    static constexpr uint32_t CurrentVersion = 2;
+
+    uint32_t Magic = MagicValue;
+    uint32_t Version = CurrentVersion;
+    char Build[24] = __DATE__ " " __TIME__; // key & var ids may change between builds
+    uint32_t NumFiles = 0;
+    uint32_t NumOps = 0;
+};
+
+struct ConfigCacheFile {
+    uint64_t WriteTime;
+    uint64_t Size;
+    uint64_t Hash;
+};
+#pragma pack(pop)
+
+enum class ConfigCacheOp : uint8_t {
+    Mapping = 1,
+    BoolVar,
+    StrVar,
+};
+
+enum ConfigCacheFlags : uint8_t {
+    ConfigCacheFlag_Forward = 0x1,
+    ConfigCacheFlag_Turbo = 0x2,
+    ConfigCacheFlag_Toggle = 0x4,
+    ConfigCacheFlag_Add = 0x8,
+    ConfigCacheFlag_Replace = 0x10,
+    ConfigCacheFlag_Reset = 0x20,
+    ConfigCacheFlag_HasData = 0x40,
+    ConfigCacheFlag_HasLayer = 0x80,
+
+    ConfigCacheFlag_CondState = 0x1,
+    ConfigCacheFlag_CondToggle = 0x2,
+};
+
+uint64_t ConfigCacheHash(string_view data) {
+    uint64_t hash = 14695981039346656037ull; // fnv-1a
+    for (char ch : data) {
+        hash = (hash ^ (uint8_t)ch) * 1099511628211ull;
+    }
+    return hash;
+}
+
+class ConfigCacheWriter {
+    vector<uint8_t> mData;
+
+public:
+    span<const uint8_t> Data() const { return mData; }
+    void Clear() { mData.clear(); }
+
+    template <class T>
+    void Write(const T &value) {
+        mData.insert(mData.end(), (const uint8_t *)&value, (const uint8_t *)(&value + 1));
+    }
+
+    template <class TChar>
+    void WriteStr(std::basic_string_view<TChar> str) {
+        Write((uint32_t)str.size());
+        mData.insert(mData.end(), (const uint8_t *)str.data(), (const uint8_t *)(str.data() + str.size()));
+    }
+};
+
+// (bounds-checked - once anything fails, all further reads return empty values)
+class ConfigCacheReader {
+    const uint8_t *mPtr;
+    const uint8_t *mEnd;
+    bool mFailed = false;
+
+    const uint8_t *Take(size_t size) {
+        if (mFailed || (size_t)(mEnd - mPtr) < size) {
+            mFailed = true;
+            return nullptr;
+        }
+
+        const uint8_t *ptr = mPtr;
+        mPtr += size;
+        return ptr;
+    }
+
+public:
+    ConfigCacheReader(span<const uint8_t> data) : mPtr(data.data()), mEnd(data.data() + data.size()) {}
+
+    bool Failed() const { return mFailed; }
+    bool AtEnd() const { return mPtr == mEnd; }
+    void Fail() { mFailed = true; }
+
+    const uint8_t *Ptr() const { return mPtr; }
+    span<const uint8_t> Rest() const { return {mPtr, mEnd}; }
+
+    template <class T>
+    T Read() {
+        T value = {};
+        if (const uint8_t *ptr = Take(sizeof(T))) {
+            memcpy(&value, ptr, sizeof(T));
+        }
+        return value;
+    }
+
+    template <class TChar>
+    std::basic_string_view<TChar> ReadStr() {
+        uint32_t size = Read<uint32_t>();
+        const uint8_t *ptr = Take((size_t)size * sizeof(TChar));
+        return ptr ? std::basic_string_view<TChar>((const TChar *)ptr, size) : std::basic_string_view<TChar>();
+    }
+};
+
+static void ConfigCacheWriteConds(ConfigCacheWriter &writer, const ImplCond *conds) {
+    uint32_t count = 0;
+    for (const ImplCond *cond = conds; cond; cond = cond->Next) {
+        count++;
+    }
+
+    writer.Write(count);
+    for (const ImplCond *cond = conds; cond; cond = cond->Next) {
+        writer.Write(cond->Key);
+        writer.Write(cond->User);
+        writer.Write((uint8_t)((cond->State ? ConfigCacheFlag_CondState : 0) | (cond->Toggle ? ConfigCacheFlag_CondToggle : 0)));
+        ConfigCacheWriteConds(writer, cond->Child);
+    }
+}
+
+static SharedPtr<ImplCond> ConfigCacheReadConds(ConfigCacheReader &reader, int depth = 0) {
+    uint32_t count = reader.Read<uint32_t>();
+    if (depth > 0x100) {
+        reader.Fail();
+    }
+
+    SharedPtr<ImplCond> conds;
+    SharedPtr<ImplCond> *nextPtr = &conds;
+    for (uint32_t i = 0; i < count && !reader.Failed(); i++) {
+        auto cond = SharedPtr<ImplCond>::New();
+        cond->Key = reader.Read<key_t>();
+        cond->User = reader.Read<user_t>();
+        uint8_t flags = reader.Read<uint8_t>();
+        cond->State = (flags & ConfigCacheFlag_CondState) != 0;
+        cond->Toggle = (flags & ConfigCacheFlag_CondToggle) != 0;
+        cond->Child = ConfigCacheReadConds(reader, depth + 1);
+
+        *nextPtr = cond;
+        nextPtr = &cond->Next;
+    }
+    return conds;
+}
+
+// Writes a mapping as read from its line (i.e. before pairs are expanded & slots allocated), along with its layer's name
+static void ConfigCacheWriteMapping(ConfigCacheWriter &writer, const ImplMapping &mapping, string_view layer) {
+    writer.Write(mapping.SrcKey);
+    writer.Write(mapping.DestKey);
+    writer.Write(mapping.SrcUser);
+    writer.Write(mapping.DestUser);
+    writer.Write((uint8_t)((mapping.Forward ? ConfigCacheFlag_Forward : 0) | (mapping.Turbo ? ConfigCacheFlag_Turbo : 0) |
+                           (mapping.Toggle ? ConfigCacheFlag_Toggle : 0) | (mapping.Add ? ConfigCacheFlag_Add : 0) |
+                           (mapping.Replace ? ConfigCacheFlag_Replace : 0) | (mapping.Reset ? ConfigCacheFlag_Reset : 0) |
+                           (mapping.Data ? ConfigCacheFlag_HasData : 0) | (!layer.empty() ? ConfigCacheFlag_HasLayer : 0)));
+    writer.Write(mapping.Rate);
+    writer.Write(mapping.Strength);
+    ConfigCacheWriteConds(writer, mapping.Conds);
+    if (mapping.Data) {
+        writer.WriteStr(string_view(*mapping.Data));
+    }
+    if (!layer.empty()) {
+        writer.WriteStr(layer);
+    }
+}
+
+// (the layer's name is returned separately, as it's resolved to a layer only when the mapping is applied)
+static SharedPtr<ImplMapping> ConfigCacheReadMapping(ConfigCacheReader &reader, string_view *layer = nullptr) {
+    auto cfg = SharedPtr<ImplMapping>::New();
+    cfg->SrcKey = reader.Read<key_t>();
+    cfg->DestKey = reader.Read<key_t>();
+    cfg->SrcUser = reader.Read<user_t>();
+    cfg->DestUser = reader.Read<user_t>();
+    uint8_t flags = reader.Read<uint8_t>();
+    cfg->Forward = (flags & ConfigCacheFlag_Forward) != 0;
+    cfg->Turbo = (flags & ConfigCacheFlag_Turbo) != 0;
+    cfg->Toggle = (flags & ConfigCacheFlag_Toggle) != 0;
+    cfg->Add = (flags & ConfigCacheFlag_Add) != 0;
+    cfg->Replace = (flags & ConfigCacheFlag_Replace) != 0;
+    cfg->Reset = (flags & ConfigCacheFlag_Reset) != 0;
+    cfg->Rate = reader.Read<double>();
+    cfg->Strength = reader.Read<double>();
+    cfg->Conds = ConfigCacheReadConds(reader);
+    if (flags & ConfigCacheFlag_HasData) {
+        cfg->Data = SharedPtr<string>::New(string(reader.ReadStr<char>()));
+    }
+    string_view layerName = (flags & ConfigCacheFlag_HasLayer) ? reader.ReadStr<char>() : string_view();
+    if (layer) {
+        *layer = layerName;
+    }
+
+    cfg->SrcType = GetKeyType(cfg->SrcKey);
+    cfg->DestType = GetKeyType(cfg->DestKey);
+    return reader.Failed() ? nullptr : cfg;
+}
+
+bool *ConfigCacheGetBoolVar(ConfigVar var) {
+    switch (var) {
+#define CONFIG_ON_VAR(cv, pname, desc, name, flags, ptr) \
+    case cv:                                             \
+        return ptr
+
+        ENUMERATE_CONFIG_VARS(CONFIG_ON_VAR);
+#undef CONFIG_ON_VAR
+
+    default:
+        return nullptr;
+    }
+}
+
+static bool ConfigCacheSkipConds(ConfigCacheReader &reader, int depth = 0) {
+    uint32_t count = reader.Read<uint32_t>();
+    if (depth > 0x100) {
+        reader.Fail();
+    }
+
+    for (uint32_t i = 0; i < count && !reader.Failed(); i++) {
+        reader.Read<key_t>();
+        reader.Read<user_t>();
+        reader.Read<uint8_t>();
+        ConfigCacheSkipConds(reader, depth + 1);
+    }
+    return !reader.Failed();
+}
+
+// Skips an op, checking that it's well-formed (without allocating anything)
+static bool ConfigCacheSkipOp(ConfigCacheReader &reader) {
+    switch (reader.Read<ConfigCacheOp>()) {
+    case ConfigCacheOp::Mapping: {
+        reader.Read<key_t>();
+        reader.Read<key_t>();
+        reader.Read<user_t>();
+        reader.Read<user_t>();
+        uint8_t flags = reader.Read<uint8_t>();
+        reader.Read<double>();
+        reader.Read<double>();
+        ConfigCacheSkipConds(reader);
+        if (flags & ConfigCacheFlag_HasData) {
+            reader.ReadStr<char>();
+        }
+        if (flags & ConfigCacheFlag_HasLayer) {
+            reader.ReadStr<char>();
+        }
+    } break;
+
+    case ConfigCacheOp::BoolVar:
+        if (!ConfigCacheGetBoolVar(reader.Read<ConfigVar>())) {
+            reader.Fail();
+        }
+        reader.Read<bool>();
+        break;
+
+    case ConfigCacheOp::StrVar:
+        reader.Read<ConfigVar>();
+        reader.Read<user_t>();
+        reader.ReadStr<char>();
+        break;
+
+    default:
+        reader.Fail();
+        break;
+    }
+    return !reader.Failed();
+}
+
+// Records the ops of a config as it's read from text (to be applied, and possibly written as a cache)
+class ConfigCacheRecorder {
+    ConfigCacheWriter mFiles;
+    ConfigCacheWriter mOps;
+    uint32_t mNumFiles = 0;
+    uint32_t mNumOps = 0;
+    bool mActive = false;
+
+public:
+    bool IsActive() const { return mActive; }
+    span<const uint8_t> Ops() const { return mOps.Data(); }
+    uint32_t NumOps() const { return mNumOps; }
+
+    void Begin() {
+        mFiles.Clear();
+        mOps.Clear();
+        mNumFiles = mNumOps = 0;
+        mActive = true;
+    }
+
+    void Abort() { mActive = false; }
+
+    void AddFile(const wchar_t *name, const ConfigCacheFile &file) {
+        if (mActive) {
+            mFiles.Write(file);
+            mFiles.WriteStr(wstring_view(name));
+            mNumFiles++;
+        }
+    }
+
+    void AddMapping(const ImplMapping &mapping, string_view layer) {
+        if (mActive) {
+            mOps.Write(ConfigCacheOp::Mapping);
+            ConfigCacheWriteMapping(mOps, mapping, layer);
+            mNumOps++;
+        }
+    }
+
+    void AddBoolVar(ConfigVar var, bool value) {
+        if (mActive) {
+            mOps.Write(ConfigCacheOp::BoolVar);
+            mOps.Write(var);
+            mOps.Write(value);
+            mNumOps++;
+        }
+    }
+
+    void AddStrVar(ConfigVar var, user_t user, string_view value) {
+        if (mActive) {
+            mOps.Write(ConfigCacheOp::StrVar);
+            mOps.Write(var);
+            mOps.Write(user);
+            mOps.WriteStr(value);
+            mNumOps++;
+        }
+    }
+
+    bool End(const wchar_t *path) {
+        if (!mActive) {
+            return false;
+        }
+        mActive = false;
+
+        ConfigCacheHeader header;
+        header.NumFiles = mNumFiles;
+        header.NumOps = mNumOps;
+
+        // (written aside & moved into place, as other processes may be loading the same config)
+        // (or by another thread of this process, in the background)
+        wstring tempPath = wstring(path) + L"." + std::to_wstring(GetCurrentProcessId()) + L"." + std::to_wstring(GetCurrentThreadId());
+        {
+            std::ofstream file(tempPath, std::ios::binary);
+            file.write((const char *)&header, sizeof(header));
+            file.write((const char *)mFiles.Data().data(), mFiles.Data().size());
+            file.write((const char *)mOps.Data().data(), mOps.Data().size());
+            if (file.fail()) {
+                LOG_W << "ERROR: Failed to write config cache: " << path << END;
+                DeleteFileW(tempPath.c_str());
+                return false;
+            }
+        }
+
+        if (!MoveFileExW(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileW(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// A read-only mapping of a cache file
+class ConfigCacheView {
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+    const uint8_t *mData = nullptr;
+    size_t mSize = 0;
+
+public:
+    ConfigCacheView() {}
+    ConfigCacheView(const ConfigCacheView &) = delete;
+
+    ~ConfigCacheView() {
+        if (mData) {
+            UnmapViewOfFile(mData);
+        }
+        if (mMapping) {
+            CloseHandle(mMapping);
+        }
+        if (mFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(mFile);
+        }
+    }
+
+    bool Open(const wchar_t *path) {
+        mFile = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, 0, nullptr);
+        LARGE_INTEGER size;
+        if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || size.QuadPart < (LONGLONG)sizeof(ConfigCacheHeader)) {
+            return false;
+        }
+
+        mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        mData = mMapping ? (const uint8_t *)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        mSize = (size_t)size.QuadPart;
+        return mData != nullptr;
+    }
+
+    span<const uint8_t> Data() const { return {mData, mSize}; }
+};
+
+// Reads the header & source files of a cache, checking that it's usable
+// (fileCb is given each source file's recorded entry, its current write time, and whether its write time & size still match)
+// (returns the number of ops that follow, or -1 if the cache is stale or invalid)
+template <class TFileCb>
+int64_t ConfigCacheReadHeader(ConfigCacheReader &reader, const wchar_t *directory, TFileCb &&fileCb) {
+    auto header = reader.Read<ConfigCacheHeader>();
+    if (reader.Failed() || header.Magic != ConfigCacheHeader::MagicValue ||
+        header.Version != ConfigCacheHeader::CurrentVersion ||
+        memcmp(header.Build, ConfigCacheHeader().Build, sizeof(header.Build)) != 0) {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < header.NumFiles; i++) {
+        auto file = reader.Read<ConfigCacheFile>();
+        wstring name(reader.ReadStr<wchar_t>());
+        if (reader.Failed()) {
+            return -1;
+        }
+
+        uint64_t writeTime, size;
+        Path path = PathCombine(directory, name.c_str());
+        if (!GetFileStat(path, &writeTime, &size)) {
+            writeTime = size = 0;
+        }
+
+        if (!fileCb(name, file, writeTime, writeTime == file.WriteTime && size == file.Size)) {
+            return -1;
+        }
+    }
+
+    return header.NumOps;
+}
@@ -301,7 +301,7 @@ UniquePtr<ConfigEditGroup> ConfigEditLoad(std::istream &in) {
 
         intptr_t startIdx = 0;
         intptr_t idx = startIdx;
-        string token = ConfigReadToken(line, &idx);
+        string_view token = ConfigReadToken(line, &idx);
 
         ConfigEditGroup *nextParent = parent;
         ConfigEditEntry *nextSibling = node;
@@ -151,7 +151,7 @@ class ConfigKeyPanel : public Panel {
     Control *GetCurrKeyDataUi() {
         if (mCurrKeyType.OfUser) {
             return mUserLayout;
-        } else if (mCurrKey == MY_VK_LOAD_CONFIG) {
+        } else if (mCurrKey == MY_VK_LOAD_CONFIG || (mCurrKey >= MY_VK_TOGGLE_LAYER && mCurrKey <= MY_VK_POP_LAYER)) {
             return mConfigEdit;
         }
 
@@ -197,8 +197,10 @@ public:
             }
         } else if (dataUi == mConfigEdit) {
             mConfigEdit->Clear();
-            for (auto &config : ConfigNames.GetNames()) {
-                mConfigEdit->Add(config);
+            if (mCurrKey == MY_VK_LOAD_CONFIG) { // (layers are named freely)
+                for (auto &config : ConfigNames.GetNames()) {
+                    mConfigEdit->Add(config);
+                }
             }
 
             mConfigEdit->Set(data ? PathFromStr(data->c_str()) : Path(L""));
@@ -10,6 +10,8 @@ struct ConfigPlugin {
 
 struct ConfigCustom {
     unordered_map<string, UniquePtr<ConfigPlugin>> Plugins;
+    bool NoLoad = false;       // if set, plugins that aren't loaded yet aren't loaded (e.g. when compiling in the background)
+    bool MissedPlugin = false; // set when a plugin wasn't loaded due to NoLoad
 };
 
 struct ConfigAuxInfo {
@@ -24,7 +26,7 @@ void ConfigError(ConfigAuxInfo *auxInfo) {
     }
 }
 
-void ConfigSeekToken(const string &str, intptr_t *startPtr) {
+void ConfigSeekToken(string_view str, intptr_t *startPtr) {
     intptr_t start = *startPtr;
     while ((size_t)start < str.size() && isspace(str[start])) {
         start++;
@@ -32,7 +34,8 @@ void ConfigSeekToken(const string &str, intptr_t *startPtr) {
     *startPtr = start;
 }
 
-string ConfigReadToken(const string &str, intptr_t *startPtr, bool welded = false) {
+// (returns a view into 'str')
+string_view ConfigReadToken(string_view str, intptr_t *startPtr, bool welded = false) {
     if (!welded) {
         ConfigSeekToken(str, startPtr);
     }
@@ -54,15 +57,20 @@ string ConfigReadToken(const string &str, intptr_t *startPtr, bool welded = fals
     return str.substr(start, end - start);
 }
 
-string ConfigReadRest(const string &str, intptr_t *startPtr) {
-    string rest = StrTrimmed(str.substr(*startPtr));
+string_view ConfigReadRest(string_view str, intptr_t *startPtr) {
+    string_view rest = StrTrimmed(str.substr(*startPtr));
     *startPtr = str.size();
     return rest;
 }
 
-string ConfigNormStr(const string &str) {
-    string strLow = StrLowerCase(str);
-    StrReplaceAll(strLow, ".", "");
+string ConfigNormStr(string_view str) {
+    string strLow;
+    strLow.reserve(str.size()); // (names mostly fit in the small-string buffer)
+    for (char ch : str) {
+        if (ch != '.') {
+            strLow.push_back((char)tolower(ch));
+        }
+    }
     return strLow;
 }
 
@@ -101,6 +109,9 @@ ConfigPlugin *ConfigTryGetPlugin(ConfigCustom &custom, string *pStrLow) {
     ConfigPlugin *plugin;
     if (iter != custom.Plugins.end()) {
         plugin = iter->second.get();
+    } else if (custom.NoLoad) {
+        custom.MissedPlugin = true;
+        plugin = nullptr;
     } else {
         plugin = ConfigLoadPlugin(custom, pluginName);
     }
@@ -115,20 +126,22 @@ ConfigPlugin *ConfigTryGetPlugin(ConfigCustom &custom, string *pStrLow) {
 
 #define CONFIG_UNKNOWN_NAME "tbd"
 
-int ConfigReadKey(ConfigCustom &custom, const string &str, ConfigAuxInfo *auxInfo) {
+#define CONFIG_ON_KEY(vk, pname, desc, group, name, ...) \
+    table.Add(name, vk) __VA_OPT__(, table.Add(__VA_ARGS__, vk))
+
+constexpr auto ConfigKeyNames = ConstNameTableFrom<int>([](auto &table) { ENUMERATE_KEYS_WITHOUT_SIMPLE(CONFIG_ON_KEY); });
+#undef CONFIG_ON_KEY
+
+int ConfigReadKey(ConfigCustom &custom, string_view str, ConfigAuxInfo *auxInfo) {
     string strLow = ConfigNormStr(str);
 
     if (strLow.size() == 1 && ((strLow[0] >= 'a' && strLow[0] <= 'z') || (strLow[0] >= '0' && strLow[0] <= '9'))) {
         return toupper(strLow[0]);
     }
 
-#define CONFIG_ON_KEY(vk, pname, desc, group, name, ...) \
-    if (strLow == name)                                  \
-        return vk;                                       \
-    __VA_OPT__(if (strLow == __VA_ARGS__) return vk;)
-
-    ENUMERATE_KEYS_WITHOUT_SIMPLE(CONFIG_ON_KEY);
-#undef CONFIG_ON_KEY
+    if (const int *vk = ConfigKeyNames.Find(strLow)) {
+        return *vk;
+    }
 
     auto plugin = ConfigTryGetPlugin(custom, &strLow);
     if (plugin) {
@@ -145,7 +158,7 @@ int ConfigReadKey(ConfigCustom &custom, const string &str, ConfigAuxInfo *auxInf
     return MY_VK_UNKNOWN;
 }
 
-user_t ConfigReadUser(const string &str, ConfigAuxInfo *auxInfo) {
+user_t ConfigReadUser(string_view str, ConfigAuxInfo *auxInfo) {
     if (str.empty()) {
         return -1;
     }
@@ -160,7 +173,7 @@ user_t ConfigReadUser(const string &str, ConfigAuxInfo *auxInfo) {
     return -1;
 }
 
-double ConfigReadStrength(const string &str, ConfigAuxInfo *auxInfo) {
+double ConfigReadStrength(string_view str, ConfigAuxInfo *auxInfo) {
     if (str.empty()) {
         return 1;
     }
@@ -179,7 +192,7 @@ double ConfigReadStrength(const string &str, ConfigAuxInfo *auxInfo) {
     return 1;
 }
 
-double ConfigReadRate(const string &str, bool isTurbo, ConfigAuxInfo *auxInfo) {
+double ConfigReadRate(string_view str, bool isTurbo, ConfigAuxInfo *auxInfo) {
     if (!str.empty()) {
         if (auxInfo) {
             auxInfo->HasRate = true;
@@ -196,9 +209,9 @@ double ConfigReadRate(const string &str, bool isTurbo, ConfigAuxInfo *auxInfo) {
     return isTurbo ? 0.02 : 0.01;
 }
 
-SharedPtr<ImplCond> ConfigReadCond(ConfigCustom &custom, const string &line, intptr_t *idxPtr,
+SharedPtr<ImplCond> ConfigReadCond(ConfigCustom &custom, string_view line, intptr_t *idxPtr,
                                    ConfigAuxInfo *auxInfo, bool nested = false) {
-    string condStr = ConfigReadToken(line, idxPtr);
+    string_view condStr = ConfigReadToken(line, idxPtr);
     auto cond = SharedPtr<ImplCond>::New();
     cond->State = true;
 
@@ -222,7 +235,7 @@ SharedPtr<ImplCond> ConfigReadCond(ConfigCustom &custom, const string &line, int
             *nextPtr = subcond;
             nextPtr = &subcond->Next;
 
-            string token = ConfigReadToken(line, idxPtr);
+            string_view token = ConfigReadToken(line, idxPtr);
             int nextType = 0;
             if (token == "&") {
                 nextType = MY_VK_META_COND_AND;
@@ -256,9 +269,9 @@ SharedPtr<ImplCond> ConfigReadCond(ConfigCustom &custom, const string &line, int
             LOG_W << "ERROR: Output-only key in condition: " << condStr << END, ConfigError(auxInfo);
         }
 
-        string userStr;
+        string_view userStr;
         intptr_t suffixIdx = *idxPtr;
-        string suffix = ConfigReadToken(line, &suffixIdx, !nested);
+        string_view suffix = ConfigReadToken(line, &suffixIdx, !nested);
         if (suffix == "@") {
             userStr = ConfigReadToken(line, &suffixIdx);
             *idxPtr = suffixIdx;
@@ -282,15 +295,15 @@ SharedPtr<ImplCond> ConfigReadCond(ConfigCustom &custom, const string &line, int
     return cond;
 }
 
-SharedPtr<ImplMapping> ConfigReadInputLine(ConfigCustom &custom, const string &line, intptr_t idx = 0,
+SharedPtr<ImplMapping> ConfigReadInputLine(ConfigCustom &custom, string_view line, intptr_t idx = 0,
                                            ConfigAuxInfo *auxInfo = nullptr) {
     auto cfg = SharedPtr<ImplMapping>::New();
 
-    string inputStr = ConfigReadToken(line, &idx);
+    string_view inputStr = ConfigReadToken(line, &idx);
 
-    string inUserStr;
+    string_view inUserStr;
     while (true) {
-        string token = ConfigReadToken(line, &idx);
+        string_view token = ConfigReadToken(line, &idx);
         if (token.empty()) {
             ConfigError(auxInfo);
             LOG_W << "ERROR: ':' expected after key name in: " << line << END;
@@ -306,29 +319,29 @@ SharedPtr<ImplMapping> ConfigReadInputLine(ConfigCustom &custom, const string &l
         }
     }
 
-    string outputStr = ConfigReadToken(line, &idx);
+    string_view outputStr = ConfigReadToken(line, &idx);
 
-    string outUserStr, strengthStr, rateStr;
+    string_view outUserStr, strengthStr, rateStr;
     SharedPtr<ImplCond> *nextCondPtr = &cfg->Conds;
     while (true) {
-        string token = ConfigReadToken(line, &idx);
+        string_view token = ConfigReadToken(line, &idx);
         if (token.empty()) {
             break;
         }
 
         if (token == "!") {
-            string optStr = StrLowerCase(ConfigReadToken(line, &idx));
-            if (optStr == "replace") {
+            string_view optStr = ConfigReadToken(line, &idx);
+            if (StrIEquals(optStr, "replace")) {
                 cfg->Replace = true;
-            } else if (optStr == "forward") {
+            } else if (StrIEquals(optStr, "forward")) {
                 cfg->Forward = true;
-            } else if (optStr == "turbo") {
+            } else if (StrIEquals(optStr, "turbo")) {
                 cfg->Turbo = true;
-            } else if (optStr == "toggle") {
+            } else if (StrIEquals(optStr, "toggle")) {
                 cfg->Toggle = true;
-            } else if (optStr == "add") {
+            } else if (StrIEquals(optStr, "add")) {
                 cfg->Add = true;
-            } else if (optStr == "reset") {
+            } else if (StrIEquals(optStr, "reset")) {
                 cfg->Reset = true;
             } else {
                 LOG_W << "ERROR: Invalid option: " << optStr << END, ConfigError(auxInfo);
@@ -344,7 +357,7 @@ SharedPtr<ImplMapping> ConfigReadInputLine(ConfigCustom &custom, const string &l
         } else if (token == "~") {
             strengthStr = ConfigReadToken(line, &idx);
         } else if (token == "=") {
-            cfg->Data = SharedPtr<string>::New(ConfigReadRest(line, &idx));
+            cfg->Data = SharedPtr<string>::New(string(ConfigReadRest(line, &idx)));
         } else {
             LOG_W << "ERROR: Ignoring unknown token in mapping line: " << token << END, ConfigError(auxInfo);
         }
@@ -376,12 +389,10 @@ Path ConfigReadInclude(const string &val) {
     }
 }
 
-bool ConfigReadBoolVar(const string &val, ConfigAuxInfo *auxInfo) {
-    string valLow = StrLowerCase(val);
-
-    if (valLow == "true") {
+bool ConfigReadBoolVar(string_view val, ConfigAuxInfo *auxInfo) {
+    if (StrIEquals(val, "true")) {
         return true;
-    } else if (valLow == "false") {
+    } else if (StrIEquals(val, "false")) {
         return false;
     }
 
@@ -410,6 +421,7 @@ enum class ConfigVar : uint32_t {
     StickShape,
     BoundCursor,
     AutoReload,
+    EventTrace,
     CustomStart = 0x10000000,
 };
 
@@ -458,23 +470,30 @@ int operator-(ConfigVar l, ConfigVar r) { return (int)l - (int)r; }
       "debug", CONFIG_VAR_BOOL | CONFIG_VAR_GROUP_DEBUG, &G.Debug);                            \
     e(ConfigVar::Trace, "Trace", L"Log trace-level events",                                    \
       "trace", CONFIG_VAR_BOOL | CONFIG_VAR_GROUP_DEBUG, &G.Trace);                            \
+    e(ConfigVar::EventTrace, "EventTrace", L"Record a binary trace of input events",           \
+      "eventtrace", CONFIG_VAR_BOOL | CONFIG_VAR_GROUP_DEBUG, &G.EventTrace);                  \
     e(ConfigVar::WaitDebugger, "WaitDebugger", L"(Debug) Hang until debugger is attached",     \
       "waitdebugger", CONFIG_VAR_BOOL | CONFIG_VAR_GROUP_DEBUG, &G.WaitDebugger);              \
     e(ConfigVar::SpareForDebug, "SpareForDebug", L"(Debug) No effect",                         \
       "sparefordebug", CONFIG_VAR_BOOL | CONFIG_VAR_GROUP_DEBUG, &G.SpareForDebug);            \
     //
 
+#define CONFIG_ON_VAR(cv, pname, desc, name, flags, ptr) table.Add(name, cv)
+
+constexpr auto ConfigVarNames = ConstNameTableFrom<ConfigVar>([](auto &table) { ENUMERATE_CONFIG_VARS(CONFIG_ON_VAR); });
+#undef CONFIG_ON_VAR
+
 template <class TBoolHandler, class TCustomHandler>
-void ConfigReadVarLine(ConfigCustom &custom, const string &line, intptr_t idx,
+void ConfigReadVarLine(ConfigCustom &custom, string_view line, intptr_t idx,
                        TBoolHandler &&boolHandler, TCustomHandler &&customHandler, ConfigAuxInfo *auxInfo = nullptr) {
-    string key = ConfigReadToken(line, &idx);
+    string_view key = ConfigReadToken(line, &idx);
     string keyLow = ConfigNormStr(key);
 
     intptr_t validx = idx;
     user_t user = -1;
-    string val = ConfigReadToken(line, &idx);
+    string_view val = ConfigReadToken(line, &idx);
     if (val == "@") {
-        string userStr = ConfigReadToken(line, &idx);
+        string_view userStr = ConfigReadToken(line, &idx);
         user = ConfigReadUser(userStr, auxInfo);
 
         validx = idx;
@@ -487,19 +506,25 @@ void ConfigReadVarLine(ConfigCustom &custom, const string &line, intptr_t idx,
     }
 
 retryLegacy:
-    auto getRest = [&] { return ConfigReadRest(line, &validx); };
+    auto getRest = [&] { return string(ConfigReadRest(line, &validx)); };
 
+    if (const ConfigVar *var = ConfigVarNames.Find(keyLow)) {
+        switch (*var) {
 #define CONFIG_ON_VAR(cv, pname, desc, name, flags, ptr)                  \
-    if (keyLow == name) {                                                 \
+    case cv:                                                              \
         if constexpr ((flags) & CONFIG_VAR_BOOL)                          \
             return boolHandler(cv, ConfigReadBoolVar(val, auxInfo), ptr); \
         else                                                              \
-            return customHandler(cv, getRest(), user);                    \
-    }
+            return customHandler(cv, getRest(), user)
 
-    ENUMERATE_CONFIG_VARS(CONFIG_ON_VAR);
+            ENUMERATE_CONFIG_VARS(CONFIG_ON_VAR);
 #undef CONFIG_ON_VAR
 
+        default:
+            break;
+        }
+    }
+
     auto plugin = ConfigTryGetPlugin(custom, &keyLow);
     if (plugin) {
         auto iter = plugin->Vars.find(keyLow);
@@ -510,7 +535,7 @@ retryLegacy:
 
     if (keyLow.starts_with("device") && keyLow.size() > 6) // legacy
     {
-        user = ConfigReadUser(keyLow.substr(6), auxInfo);
+        user = ConfigReadUser(string_view(keyLow).substr(6), auxInfo);
         keyLow = keyLow.substr(0, 6);
         goto retryLegacy;
     }
@@ -539,18 +564,20 @@ int operator-(ConfigDevice l, ConfigDevice r) { return (int)l - (int)r; }
     e(ConfigDevice::Ds4, "PS4", L"PS4 (Dual Shock 4) Controller", "ps4", "ds4");          \
     //
 
-ConfigDevice ConfigReadDeviceName(ConfigCustom &custom, const string &type,
-                                  ConfigAuxInfo *auxInfo = nullptr) {
-    string typeLow = ConfigNormStr(type);
-
 #define CONFIG_ON_DEVICE(cv, pname, desc, name, ...) \
-    if (typeLow == name)                             \
-        return cv;                                   \
-    __VA_OPT__(if (typeLow == __VA_ARGS__) return cv;)
+    table.Add(name, cv) __VA_OPT__(, table.Add(__VA_ARGS__, cv))
 
-    ENUMERATE_CONFIG_DEVICES(CONFIG_ON_DEVICE);
+constexpr auto ConfigDeviceNames = ConstNameTableFrom<ConfigDevice>([](auto &table) { ENUMERATE_CONFIG_DEVICES(CONFIG_ON_DEVICE); });
 #undef CONFIG_ON_DEVICE
 
+ConfigDevice ConfigReadDeviceName(ConfigCustom &custom, string_view type,
+                                  ConfigAuxInfo *auxInfo = nullptr) {
+    string typeLow = ConfigNormStr(type);
+
+    if (const ConfigDevice *device = ConfigDeviceNames.Find(typeLow)) {
+        return *device;
+    }
+
     auto plugin = ConfigTryGetPlugin(custom, &typeLow);
     if (plugin) {
         auto iter = plugin->Devices.find(typeLow);
@@ -573,7 +600,7 @@ ConfigDevice ConfigReadDeviceName(ConfigCustom &custom, const string &type,
     e(ImplStickShape::Square, "Square", L"Square", "square");                      \
     //
 
-ImplStickShape ConfigReadStickShape(const string &type, ConfigAuxInfo *auxInfo = nullptr) {
+ImplStickShape ConfigReadStickShape(string_view type, ConfigAuxInfo *auxInfo = nullptr) {
     string typeLow = ConfigNormStr(type);
 
 #define CONFIG_ON_SHAPE(cv, pname, desc, name) \
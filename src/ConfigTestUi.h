@@ -260,6 +260,50 @@ public:
     }
 };
 
+class LatencyScrollPanel : public ScrollPanel {
+    Label *mLatencyLbl = nullptr;
+
+public:
+    using ScrollPanel::ScrollPanel;
+    ScrollType GetScrollType() override { return ScrollType::Vert; }
+    SIZE GetMaxSize() override { return {0, 80}; }
+
+    Control *OnCreate() override {
+        mLatencyLbl = New<Label>();
+        return mLatencyLbl;
+    }
+
+    void Update() {
+        static const tuple<int, const wchar_t *> types[] = {
+            {MyInputHook_Stats_Flush, L"processed"},
+            {MyInputHook_Stats_HidReport, L"hid queued"},
+            {MyInputHook_Stats_HidRead, L"hid read"},
+            {MyInputHook_Stats_XUsbRead, L"xinput read"},
+            {MyInputHook_Stats_RawInput, L"raw input posted"},
+        };
+
+        wstringstream text;
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            wstringstream line;
+            line << std::fixed << std::setprecision(2);
+            for (auto &[type, name] : types) {
+                MyInputHook_Stats stats;
+                MyInputHook_GetStats(i, type, &stats, sizeof stats);
+                if (stats.Count) {
+                    line << (line.tellp() > 0 ? L", " : L"") << name << L" " << stats.P50Us / 1000 << L" (" << stats.P99Us / 1000 << L")";
+                }
+            }
+
+            if (line.tellp() > 0) {
+                text << L"Gamepad #" << i + 1 << L": " << line.str() << L"\n";
+            }
+        }
+
+        wstring str = text.str();
+        mLatencyLbl->SetText(str.empty() ? L"No gamepad latency measured yet" : str.c_str());
+    }
+};
+
 class ConfigTestPanel : public Panel {
     struct UserState {
         void *Callback = nullptr;
@@ -272,6 +316,8 @@ class ConfigTestPanel : public Panel {
     Button *mClearBtn = nullptr;
     InputScrollPanel *mInputs = nullptr;
     ErrorScrollPanel *mErrorsScroll = nullptr;
+    LatencyScrollPanel *mLatencyScroll = nullptr;
+    Timer *mLatencyTimer = nullptr;
     bool mInitialized = false;
     bool mRegistered = false;
     HANDLE mCallbackEvent = nullptr;
@@ -341,9 +387,12 @@ class ConfigTestPanel : public Panel {
                 }
             });
 
+            mLatencyScroll->Update();
+            mLatencyTimer->Start();
             mRegistered = true;
         } else if (!regEnable && mRegistered) {
             RegisterRawInput(false);
+            mLatencyTimer->End();
 
             PostInMyInputThreadBlocking([&] {
                 MyInputHook_SetLogCallback(nullptr, nullptr);
@@ -579,10 +628,17 @@ public:
         mClearBtn = New<Button>(L"(Clear)", [this] {
             mInputs->Clear();
             mInputs->SetFocus();
+
+            if (mInitialized) {
+                MyInputHook_ResetStats();
+                mLatencyScroll->Update();
+            }
         });
 
         mInputs = New<InputScrollPanel>();
         mErrorsScroll = New<ErrorScrollPanel>();
+        mLatencyScroll = New<LatencyScrollPanel>();
+        mLatencyTimer = New<Timer>(1, false, [this] { mLatencyScroll->Update(); });
 
         auto headerLay = New<Layout>();
         headerLay->AddLeftMiddle(mClearBtn);
@@ -593,6 +649,9 @@ public:
         layout->AddTop(New<Separator>());
         layout->AddTop(headerLay, -1, 0, 20);
         layout->AddBottom(mErrorsScroll);
+        layout->AddBottom(New<Separator>());
+        layout->AddBottom(mLatencyScroll);
+        layout->AddBottom(New<Label>(L"Gamepad latency since input, in ms - median (99th percentile):"));
         layout->AddRemaining(mInputs);
         return layout;
     }
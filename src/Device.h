@@ -176,7 +176,7 @@ struct DeviceNode {
     }
 };
 
-ostream &operator<<(ostream &o, DeviceNode *node) {
+LogStream &operator<<(LogStream &o, DeviceNode *node) {
     return o << node->UserIdx << ":" << node->NodeType;
 }
 
@@ -201,7 +201,17 @@ struct DeviceIntf : public DeviceNode {
     bool HasHid() { return Types & DEVICE_NODE_TYPE_HID; }
     bool HasXUsb() { return Types & DEVICE_NODE_TYPE_XUSB; }
 
-    virtual int CopyInputTo(byte *dest) = 0;
+    virtual int CopyStateTo(byte *dest, const ImplStateSnapshot &state) = 0;
+
+    // (optionally returns the stamp of the state that was copied)
+    int CopyInputTo(byte *dest, ImplStateStamp *stamp = nullptr) {
+        auto state = G.Users[UserIdx].State.Snapshot.Read();
+        if (stamp) {
+            *stamp = state.Stamp();
+        }
+        return CopyStateTo(dest, state);
+    }
+
     int CopyInputTo(byte *dest, int size) {
         if (size < Preparsed->Input.Bytes) {
             LOG << "Requested input report with not enough bytes" << END;
@@ -216,9 +226,7 @@ struct DeviceIntf : public DeviceNode {
     }
     bool ProcessOutput(const byte *src, int size) {
         int id = size ? src[0] : -1;
-        if (G.ApiDebug) {
-            LOG << "Received output report: " << id << END;
-        }
+        LOG_API_DEBUG << "Received output report: " << id << END;
         return ProcessOutput(src, size, id);
     }
 
@@ -228,9 +236,7 @@ struct DeviceIntf : public DeviceNode {
     }
     int ProcessFeature(const byte *src, byte *dest, int size) {
         int id = size ? src[0] : -1;
-        if (G.ApiDebug) {
-            LOG << (dest ? "Requested " : "Received ") << " feature report: " << id << END;
-        }
+        LOG_API_DEBUG << (dest ? "Requested " : "Received ") << " feature report: " << id << END;
         return ProcessFeature(src, dest, size, id);
     }
 
@@ -5,12 +5,19 @@
 #include "XUsbApi.h"
 #include "UtilsBuffer.h"
 #include "WinUtils.h"
+#include "ImplLatency.h"
+#include "PerfCounters.h"
 
 UniqueLog gUniqLogDeviceOpen;
 
 static InfiniteThreadPool GInputThreadPool{InputThreadPriority};
 
 class ImplProcessPipeThread {
+    struct Report {
+        Buffer Data;
+        ImplStateStamp Stamp; // of the state it was created from
+    };
+
     DeviceIntf *Device;
     Path FinalName;
     HANDLE Pipe;
@@ -21,30 +28,42 @@ class ImplProcessPipeThread {
 
     // protected by mutex
     mutex LocalMutex;
-    deque<Buffer> Reports;
+    deque<Report> Reports;
     WeakAtomic<ULONG> MaxBuffers = 0x20;
     WeakAtomic<ULONG> PollFreq = 0x10;
     WeakAtomic<bool> Immediate = false;
 
     ImplUser *User() { return &G.Users[Device->UserIdx]; }
 
-    Buffer CreateReport() {
+    ImplLatency &Latency() { return GImplLatency[Device->UserIdx]; }
+
+    Report CreateReport() {
         Buffer buffer(ReportBuffers);
-        buffer.SetSize(Device->CopyInputTo((byte *)buffer.Ptr()));
-        return buffer;
+        ImplStateStamp stamp;
+        buffer.SetSize(Device->CopyInputTo((byte *)buffer.Ptr(), &stamp));
+
+        if (GEventTrace.IsEnabled()) {
+            GEventTrace.Add(EventTraceKind::Report, 0, Device->UserIdx, 0, stamp.Version, (int32_t)buffer.Size());
+        }
+
+        GPerfCounters.Add(PerfCounter_HidReports);
+
+        Latency().OnDelivered(MyInputHook_Stats_HidReport, stamp);
+        return Report{move(buffer), stamp};
     }
 
-    void SendReport(lock_guard<mutex> &local_lock, Buffer &&buffer) {
+    void SendReport(lock_guard<mutex> &local_lock, Report &&report) {
         if (Reports.size() >= MaxBuffers) {
             Reports.pop_front();
+            GPerfCounters.Add(PerfCounter_HidReportsDropped);
         }
-        Reports.push_back(move(buffer));
+        Reports.push_back(move(report));
         if (Reports.size() == 1) {
             SetEvent(SendEvent);
         }
     }
 
-    bool GetNextReport(Buffer *report) {
+    bool GetNextReport(Report *report) {
         lock_guard<mutex> local_lock(LocalMutex);
         if (Immediate) {
             // latest report
@@ -71,7 +90,7 @@ class ImplProcessPipeThread {
         };
 
         Buffer readBuffer(OutputBuffers);
-        Buffer writeBuffer;
+        Report writeReport;
         OVERLAPPED ReadOverlapped, WriteOverlapped;
         DWORD numRead, numWrite;
         bool inRead = false, inWrite = false;
@@ -104,9 +123,8 @@ class ImplProcessPipeThread {
         auto onWriteEnd = [&](BOOL status) {
             inWrite = false;
             if (status) {
-                if (G.ApiTrace) {
-                    LOG << "Wrote hid event to pipe " << Pipe << END;
-                }
+                LOG_API_TRACE << "Wrote hid event to pipe " << Pipe << END;
+                Latency().OnDelivered(MyInputHook_Stats_HidRead, writeReport.Stamp); // (the pipe has no buffer, so the app read it)
             } else {
                 DWORD err = GetLastError();
                 if (err == ERROR_IO_PENDING) {
@@ -141,11 +159,11 @@ class ImplProcessPipeThread {
                     continue; // wait until read part breaks
                 }
 
-                if (!inWrite && GetNextReport(&writeBuffer)) {
+                if (!inWrite && GetNextReport(&writeReport)) {
                     ZeroMemory(&WriteOverlapped, sizeof(OVERLAPPED));
                     WriteOverlapped.hEvent = WriteEvent;
 
-                    if (!onWriteEnd(WriteFile(Pipe, writeBuffer.Ptr(), (int)writeBuffer.Size(), &numWrite, &WriteOverlapped))) {
+                    if (!onWriteEnd(WriteFile(Pipe, writeReport.Data.Ptr(), (int)writeReport.Data.Size(), &numWrite, &WriteOverlapped))) {
                         continue; // wait until read part breaks
                     }
                 }
@@ -184,9 +202,7 @@ public:
     }
 
     ~ImplProcessPipeThread() {
-        if (G.ApiDebug) {
-            LOG << "Pipe finished " << Pipe << END;
-        }
+        LOG_API_DEBUG << "Pipe finished " << Pipe << END;
         CloseHandle(ReadEvent);
         CloseHandle(WriteEvent);
         CloseHandle(SendEvent);
@@ -286,9 +302,7 @@ public:
                 if (gUniqLogDeviceOpen) {
                     LOG << "Opening device via file API" << END;
                 }
-                if (G.ApiDebug) {
-                    LOG << "Created pipe " << pipe << END;
-                }
+                LOG_API_DEBUG << "Created pipe " << pipe << END;
 
                 DWORD readMode = PIPE_READMODE_MESSAGE;
                 SetNamedPipeHandleState(client, &readMode, nullptr, nullptr); // (doesn't help that much - still reads partials...)
@@ -365,14 +379,10 @@ HANDLE WINAPI CreateFile_GenHook(const tchar *lpFileName, DWORD dwDesiredAccess,
         for (int i = 0; i < IMPL_MAX_USERS; i++) {
             DeviceIntf *device = ImplGetDevice(i);
             if (device && device->HasHid() && tstrieq(lpFileName, device->DevicePath<tchar>())) {
-                if (G.ApiDebug) {
-                    LOG << "CreateFile (" << lpFileName << "," << dwDesiredAccess << "," << dwFlagsAndAttributes << ")" << END;
-                }
+                LOG_API_DEBUG << "CreateFile (" << lpFileName << "," << dwDesiredAccess << "," << dwFlagsAndAttributes << ")" << END;
                 return GPipeThreads.CreatePipeHandle(device, dwFlagsAndAttributes);
             } else if (device && device->HasXUsb() && tstrieq(lpFileName, device->XUsbNode.DevicePath<tchar>())) {
-                if (G.ApiDebug) {
-                    LOG << "CreateFile (" << lpFileName << "," << dwDesiredAccess << "," << dwFlagsAndAttributes << ")" << END;
-                }
+                LOG_API_DEBUG << "CreateFile (" << lpFileName << "," << dwDesiredAccess << "," << dwFlagsAndAttributes << ")" << END;
                 return XUsbCreateFile(device, dwFlagsAndAttributes);
             }
         }
@@ -525,9 +535,7 @@ BOOL WINAPI DeviceIoControl_Hook(HANDLE hDevice, DWORD dwIoControlCode, LPVOID l
         DeviceIntf *device = nullptr;
         DeviceNode *node = GetDeviceNodeByHandle(finalPathBuf, hDevice, &device);
         if (node) {
-            if (G.ApiDebug) {
-                LOG << "DeviceIoControl (" << dwIoControlCode << ", " << (lpOverlapped ? "overlapped" : "normal") << ")" << END;
-            }
+            LOG_API_DEBUG << "DeviceIoControl (" << dwIoControlCode << ", " << (lpOverlapped ? "overlapped" : "normal") << ")" << END;
 
             DWORD bytesReturnedBuf = 0;
             lpBytesReturned = lpBytesReturned ? lpBytesReturned : &bytesReturnedBuf;
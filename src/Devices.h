@@ -5,7 +5,7 @@
 static void ImplSetRumble(ImplUser *user, double lowFreq, double highFreq);
 
 struct NoDeviceIntf : public DeviceIntf {
-    int CopyInputTo(byte *dest) override { return 0; }
+    int CopyStateTo(byte *dest, const ImplStateSnapshot &state) override { return 0; }
 
     NoDeviceIntf(int userIdx) {
         SerialString = ManufacturerString = ProductString = L"";
@@ -29,10 +29,7 @@ struct XHidReport {
     uint16_t Triggers;
     uint16_t Btns, Pad;
 
-    void SetFrom(const ImplUser *user) {
-        auto &state = user->State;
-        lock_guard<mutex> lock(state.Mutex);
-
+    void SetFrom(const ImplStateSnapshot &state) {
         ReportId = 0;
         X = state.LA.X.Value16() + 0x8000;
         Y = 0x8000 - state.LA.Y.Value16();
@@ -80,8 +77,8 @@ struct XHidPreparsedData {
 struct XDeviceIntf : public DeviceIntf {
     XHidPreparsedData PreparsedData;
 
-    int CopyInputTo(byte *dest) override {
-        ((XHidReport *)dest)->SetFrom(&G.Users[UserIdx]);
+    int CopyStateTo(byte *dest, const ImplStateSnapshot &state) override {
+        ((XHidReport *)dest)->SetFrom(state);
         return sizeof(XHidReport);
     }
 
@@ -116,12 +113,9 @@ struct DS4HidReport {
     uint8_t Touch2[4];
     uint8_t Unk4[21];
 
-    void SetFrom(const ImplUser *user) {
+    void SetFrom(const ImplStateSnapshot &state) {
         ZeroMemory(this, sizeof(DS4HidReport));
 
-        auto &state = user->State;
-        lock_guard<mutex> lock(state.Mutex);
-
         ReportId = 1;
         X = state.LA.X.Value8() + 0x80;
         Y = 0x80 - state.LA.Y.Value8();
@@ -158,7 +152,7 @@ struct DS4HidReport {
         GY = ClampToInt<int16_t>(motion.RY.Speed * rotScale);
         GZ = ClampToInt<int16_t>(motion.RZ.Speed * rotScale);
 
-        Time = (uint16_t)((uint64_t)state.Time * 1000 * 3 / 16);
+        Time = (uint16_t)(state.Time * 3 / 16); // (in units of 16/3 us)
 
         Battery = 0xff; // scale?
         PowerOptions = 0x1b;
@@ -190,8 +184,8 @@ struct DS4HidPreparsedData {
 struct Ds4DeviceIntf : public DeviceIntf {
     DS4HidPreparsedData PreparsedData;
 
-    int CopyInputTo(byte *dest) override {
-        ((DS4HidReport *)dest)->SetFrom(&G.Users[UserIdx]);
+    int CopyStateTo(byte *dest, const ImplStateSnapshot &state) override {
+        ((DS4HidReport *)dest)->SetFrom(state);
         return sizeof(DS4HidReport);
     }
 
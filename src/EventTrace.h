@@ -0,0 +1,84 @@
+#pragma once
+#include "UtilsBase.h"
+#include "UtilsPath.h"
+#include "LogUtils.h"
+#include "EventTraceFormat.h"
+#include <Windows.h>
+
+// Records the input pipeline's events into a memory-mapped ring file, as fixed-size binary records
+// (cheap enough - a counter read & an atomic increment - to leave on while reproducing timing problems)
+// The file is created on first enable, and is kept mapped from then on, as other threads may be writing into it
+class EventTrace {
+    static constexpr uint32_t Capacity = 0x100000; // (32MB worth of records)
+
+    Path mPath;
+    EventTraceHeader *mHeader = nullptr;
+    EventTraceRecord *mRecords = nullptr;
+    WeakAtomic<bool> mEnabled = false;
+
+    bool Open() {
+        HANDLE file = CreateFileW(mPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, 0, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            LOG_W << "ERROR: Failed to create event trace: " << mPath << END;
+            return false;
+        }
+
+        uint64_t size = sizeof(EventTraceHeader) + (uint64_t)sizeof(EventTraceRecord) * Capacity;
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+        CloseHandle(file); // (kept open by the mapping)
+
+        void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size) : nullptr;
+        if (mapping) {
+            CloseHandle(mapping); // (kept open by the view)
+        }
+
+        if (!view) {
+            LOG_W << "ERROR: Failed to map event trace: " << mPath << END;
+            return false;
+        }
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        mHeader = new (view) EventTraceHeader();
+        mHeader->Capacity = Capacity;
+        mHeader->Frequency = frequency.QuadPart;
+        mRecords = (EventTraceRecord *)(mHeader + 1);
+        return true;
+    }
+
+public:
+    void Init(const Path &path) { mPath = path; }
+
+    bool IsEnabled() const { return mEnabled.get(); }
+
+    // (must be called from the dll thread)
+    void SetEnabled(bool enabled) {
+        if (enabled == mEnabled.get() || (enabled && !mHeader && !Open())) {
+            return;
+        }
+
+        mEnabled = enabled;
+        if (enabled) {
+            LOG << "Recording event trace to: " << mPath << END;
+        }
+    }
+
+    // May be called from any thread, once IsEnabled
+    void Add(EventTraceKind kind, uint8_t flags, int user, int key, int32_t value = 0, int32_t value2 = 0, int slot = 0) {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+
+        uint64_t seq = std::atomic_ref(mHeader->Count).fetch_add(1, std::memory_order_relaxed);
+        EventTraceRecord &record = mRecords[seq & (Capacity - 1)];
+        record.Ticks = counter.QuadPart;
+        record.Kind = kind;
+        record.Flags = flags;
+        record.User = user < 0 ? EventTraceNoUser : (uint8_t)user;
+        record.Slot = (uint8_t)slot;
+        record.Key = (uint16_t)key;
+        record.Value = value;
+        record.Value2 = value2;
+        std::atomic_ref(record.Seq).store(seq + 1, std::memory_order_release);
+    }
+} GEventTrace;
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+
+// Format of event traces - binary traces of the input pipeline's events, for diagnosing timing problems
+// (shared by the hook, which writes them, and MyInputTraceDecode.cpp, which reads them on any platform)
+// File format: EventTraceHeader, followed by a ring of Capacity EventTraceRecords.
+// The record numbered i (counting from 0) is at index i % Capacity, and is valid only if its Seq is i + 1
+
+enum class EventTraceKind : uint8_t {
+    KeyboardIn = 1, // Key = virtual key
+    MouseButtonIn,  // Key = virtual key
+    MouseMotionIn,  // Value, Value2 = dx, dy
+    MouseWheelIn,   // Value = delta
+    CustomKeyIn,    // Key = custom key index, Value = strength (in thousandths)
+    Mapping,        // Key = dest key, User = dest user, Value = strength (in thousandths)
+    StateChange,    // User, Value = state version (when the changes to the user's state are flushed)
+    Flush,          // Value = mask of changed users, Value2 = mask of touched users (after the StateChanges)
+    Report,         // User, Value = state version, Value2 = report size (on creating a hid report)
+    XUsbIoctl,      // User, Key = ioctl function, Value = state version (if Read - recorded once read, separately for async reads)
+};
+
+enum EventTraceFlags : uint8_t {
+    EventTraceFlag_Down = 0x1,
+    EventTraceFlag_Extended = 0x2,
+    EventTraceFlag_Horizontal = 0x4,
+    EventTraceFlag_Read = 0x8, // for XUsbIoctl - reads the gamepad state
+};
+
+constexpr uint8_t EventTraceNoUser = 0xff;
+
+#pragma pack(push, 1)
+struct EventTraceRecord {
+    uint64_t Seq;   // written last - the record's number + 1
+    uint64_t Ticks; // QueryPerformanceCounter
+    EventTraceKind Kind;
+    uint8_t Flags; // EventTraceFlags
+    uint8_t User;  // or EventTraceNoUser
+    uint8_t Slot;
+    uint16_t Key;
+    uint16_t Reserved;
+    int32_t Value, Value2;
+};
+
+struct EventTraceHeader {
+    static constexpr uint32_t MagicValue = 0x5445594d; // "MYET"
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = MagicValue;
+    uint32_t Version = CurrentVersion;
+    uint32_t RecordSize = sizeof(EventTraceRecord);
+    uint32_t Capacity = 0;  // (power of 2)
+    uint64_t Frequency = 0; // of Ticks, per second
+    uint64_t Count = 0;     // records written so far (updated atomically)
+    uint8_t Reserved[32] = {};
+};
+#pragma pack(pop)
+
+static_assert(sizeof(EventTraceRecord) == 32 && sizeof(EventTraceHeader) == 64);
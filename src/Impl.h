@@ -6,10 +6,12 @@
 #include "UtilsBuffer.h"
 #include "ImplPad.h"
 #include "ImplKeyMouse.h"
+#include "PerfCounters.h"
 
 static bool ImplProcessMapping(ImplMapping *mapping, const InputValue &v, ChangedMask *changes, bool oldDown, bool reset);
 static void ImplToggleDisable();
 static void ImplToggleAlways();
+static void ImplAbortMappings();
 static void ImplToggleConnected(void *userId);
 
 static void ImplHandleCustomChange(int index, InputValue &v, slot_t slot, ImplMapping &mapping) {
@@ -32,423 +34,622 @@ static void ImplLoadConfig(void *data) {
     delete ptr;
 }
 
-static void ImplProcess(ImplMapping &mapping, InputValue &v, ChangedMask *changes) {
-    key_t key = mapping.DestKey;
-    slot_t slot = mapping.DestSlot;
-    if (mapping.DestType.OfUser) {
-        int userIndex = mapping.DestUser;
-        if (userIndex < 0) {
-            userIndex = G.ActiveUser;
+static bool ImplActionButton(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    auto &state = user->State;
+    return ImplHandleButtonChange(action.Get<ImplButtonState>(state), v.Down, mapping.DestSlot, action.GetOpt<ImplButtonState>(state, 1));
+}
+
+static bool ImplActionTrigger(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    return ImplHandleTriggerChange(action.Get<ImplTriggerState>(user->State), v.Down, v.Strength, mapping.DestSlot);
+}
+
+static bool ImplActionAxis(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    auto &state = user->State;
+    return ImplHandleAxisChange(action.Get<ImplAxisDirState>(state), action.Get<ImplAxisState>(state, 1), action.Get<ImplAxisState>(state, 2),
+                                user, v.Down, v.Strength, mapping.DestSlot, mapping.Add);
+}
+
+template <Vector3 (ImplMotionState::*GetAxis)()>
+static bool ImplActionMotionRel(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &motion = user->State.Motion;
+    ImplHandleMotionRelDimChange(motion, user, mapping.Action.X, (motion.*GetAxis)(), v, mapping.Rate, mapping.Add);
+    return false;
+}
+
+static bool ImplActionMotionDim(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    ImplHandleMotionDimChange(action.Get<ImplMotionDimState>(user->State), user, action.X, v, mapping.Rate, mapping.Add);
+    return false;
+}
+
+static bool ImplActionAxisModifier(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    auto &state = user->State;
+    return ImplHandleAxisModifierChange(action.Get<ImplAxisState>(state), action.Get<ImplAxisState>(state, 1),
+                                        user, v.Down, v.Strength, mapping.DestSlot, changes);
+}
+
+static bool ImplActionTriggerModifier(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    return ImplHandleTriggerModifierChange(action.Get<ImplTriggerState>(user->State), v.Down, v.Strength, mapping.DestSlot, changes);
+}
+
+static bool ImplActionAxisRotator(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    auto &state = user->State;
+    auto corner = [&action](int i) { return (action.Corners & (1 << i)) != 0; };
+    return ImplHandleAxisRotatorChange(action.Get<ImplAxisState>(state), action.Get<ImplAxisState>(state, 1), action.Get<ImplAxesState>(state, 2),
+                                       user, mapping, v.Down, v.Strength, changes,
+                                       corner(0), corner(1), corner(2), corner(3), corner(4), corner(5), corner(6), corner(7),
+                                       action.X, action.Y);
+}
+
+static bool ImplActionAxisRotatorModifier(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    return ImplHandleAxisRotatorModifierChange(action.Get<ImplAxesState>(user->State), user, v.Down, v.Strength, mapping.DestSlot, changes);
+}
+
+static bool ImplActionSetActiveUser(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        if (G.DefaultActiveUser == G.ActiveUser) {
+            G.ActiveUser = userIndex;
         }
+        G.DefaultActiveUser = userIndex;
+    }
+    return false;
+}
 
-        bool isCmdKey = key >= MY_VK_FIRST_USER_CMD && key < MY_VK_LAST_USER_CMD;
-        ImplUser *user = ImplGetUser(userIndex, isCmdKey);
-        if (!user) {
-            return;
+static bool ImplActionHoldActiveUser(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (v.Down) {
+        G.ActiveUser = userIndex;
+    } else {
+        G.ActiveUser = G.DefaultActiveUser;
+    }
+    return false;
+}
+
+static bool ImplActionToggleConnected(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        PostAppCallback(ImplToggleConnected, (void *)(uintptr_t)userIndex);
+    }
+    return false;
+}
+
+template <void (*Callback)()>
+static bool ImplActionPostOnRelease(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        PostAppCallback(Callback); // (may have ptrs up the stack)
+    }
+    return false;
+}
+
+static bool ImplActionToggleHideCursor(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        G.HideCursor = !G.HideCursor;
+        UpdateCursor();
+    }
+    return false;
+}
+
+static bool ImplActionToggleBoundCursor(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        G.BoundCursor = !G.BoundCursor;
+        UpdateCursor();
+    }
+    return false;
+}
+
+static bool ImplActionToggleSpareForDebug(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        G.SpareForDebug = !G.SpareForDebug;
+    }
+    return false;
+}
+
+static bool ImplActionToggleLayer(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    int layer = mapping.Action.Param;
+    if (!v.Down && layer) {
+        if (G.Layers.IsActive(layer)) {
+            G.Layers.Deactivate(layer);
+        } else {
+            G.Layers.Activate(layer);
         }
+    }
+    return false;
+}
 
-        ImplState &state = user->State;
-        changes->TouchUser(userIndex, state);
+static bool ImplActionHoldLayer(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    int layer = mapping.Action.Param;
+    if (v.Down && layer && !G.Layers.IsActive(layer)) {
+        G.Layers.Activate(layer);
+    } else if (!v.Down) {
+        G.Layers.Deactivate(layer);
+    }
+    return false;
+}
+
+static bool ImplActionPushLayer(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down && mapping.Action.Param) {
+        G.Layers.Activate(mapping.Action.Param);
+    }
+    return false;
+}
+
+// (pops the most recently activated layer, if no layer is given)
+static bool ImplActionPopLayer(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        G.Layers.Deactivate(mapping.Action.Param ? mapping.Action.Param : G.Layers.Top());
+    }
+    return false;
+}
+
+static bool ImplActionLoadConfig(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    if (!v.Down) {
+        PostAppCallback(ImplLoadConfig, new SharedPtr<string>(mapping.Data));
+    }
+    return false;
+}
+
+static bool ImplActionNone(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    return false;
+}
+
+static bool ImplActionMouseWheel(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    ImplGenerateMouseWheel(action.Param, action.X * v.Strength, v.Time);
+    return false;
+}
+
+static bool ImplActionMouseMotion(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    ImplGenerateMouseMotion(action.X * v.Strength, action.Y * v.Strength, v.Time, changes);
+    return false;
+}
+
+static bool ImplActionKey(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    ImplHandleKeyChange(mapping.Action.Param, v.Down, v.Time, mapping.DestSlot);
+    return false;
+}
+
+static bool ImplActionCustom(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    ImplHandleCustomChange(mapping.Action.Param, v, mapping.DestSlot, mapping);
+    return false;
+}
+
+static bool ImplActionInvalid(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes) {
+    Fatal(mapping.DestType.OfUser ? "Invalid pad input action?!" : "Invalid input action?!");
+    return false;
+}
+
+static void ImplResolveAction(ImplMapping &mapping) {
+    key_t key = mapping.DestKey;
+    ImplAction &action = mapping.Action;
+    action = ImplAction();
+
+    ImplState &s = G.Users[0].State; // only used for computing offsets
+    auto bind = [&](ImplActionHandler handler, auto &...states) {
+        action.Handler = handler;
+        int i = 0;
+        ((action.Offsets[i++] = (uint16_t)((uint8_t *)&states - (uint8_t *)&s + 1)), ...);
+    };
+    auto button = [&](ImplButtonState &state) { bind(ImplActionButton, state); };
+    auto exclusiveButton = [&](ImplButtonState &state, ImplButtonState &exclusiveState) { bind(ImplActionButton, state, exclusiveState); };
+    auto motionDim = [&](ImplMotionDimState &state, double scale) {
+        bind(ImplActionMotionDim, state);
+        action.X = scale;
+    };
+    auto motionRel = [&](ImplActionHandler handler, double scale) {
+        action.Handler = handler;
+        action.X = scale;
+    };
+    auto rotator = [&](ImplAxisState &axisState, ImplAxisState &otherAxisState, ImplAxesState &axesState,
+                       bool c1, bool c2, bool c3, bool c4, bool c5, bool c6, bool c7, bool c8, double initX, double initY) {
+        bind(ImplActionAxisRotator, axisState, otherAxisState, axesState);
+        action.Corners = (uint8_t)(c1 | (c2 << 1) | (c3 << 2) | (c4 << 3) | (c5 << 4) | (c6 << 5) | (c7 << 6) | (c8 << 7));
+        action.X = initX;
+        action.Y = initY;
+    };
+    auto mouseWheel = [&](int flags, double sign) {
+        action.Handler = ImplActionMouseWheel;
+        action.Param = flags;
+        action.X = sign;
+    };
+    auto mouseMotion = [&](double dx, double dy) {
+        action.Handler = ImplActionMouseMotion;
+        action.X = dx;
+        action.Y = dy;
+    };
+    auto external = [&](ImplActionHandler handler) {
+        action.Handler = handler;
+        action.External = true;
+    };
+    auto layer = [&](ImplActionHandler handler) {
+        action.Handler = handler;
+        action.Param = mapping.Data ? G.Layers.Get(ConfigNormStr(*mapping.Data)) : 0;
+        if (mapping.Data && !action.Param) {
+            LOG_W << "ERROR: Too many layers, ignoring layer action on: " << *mapping.Data << END;
+        }
+    };
+
+    if (mapping.DestType.OfUser) {
+        action.UserCmd = key >= MY_VK_FIRST_USER_CMD && key < MY_VK_LAST_USER_CMD;
 
-        bool changed = false;
         switch (key) {
         case MY_VK_PAD_A:
-            changed = ImplHandleButtonChange(state.A, v.Down, slot);
+            button(s.A);
             break;
         case MY_VK_PAD_B:
-            changed = ImplHandleButtonChange(state.B, v.Down, slot);
+            button(s.B);
             break;
         case MY_VK_PAD_X:
-            changed = ImplHandleButtonChange(state.X, v.Down, slot);
+            button(s.X);
             break;
         case MY_VK_PAD_Y:
-            changed = ImplHandleButtonChange(state.Y, v.Down, slot);
+            button(s.Y);
             break;
         case MY_VK_PAD_START:
-            changed = ImplHandleButtonChange(state.Start, v.Down, slot);
+            button(s.Start);
             break;
         case MY_VK_PAD_BACK:
-            changed = ImplHandleButtonChange(state.Back, v.Down, slot);
+            button(s.Back);
             break;
         case MY_VK_PAD_DPAD_LEFT:
-            changed = ImplHandleButtonChange(state.DL, v.Down, slot, &state.DR);
+            exclusiveButton(s.DL, s.DR);
             break;
         case MY_VK_PAD_DPAD_RIGHT:
-            changed = ImplHandleButtonChange(state.DR, v.Down, slot, &state.DL);
+            exclusiveButton(s.DR, s.DL);
             break;
         case MY_VK_PAD_DPAD_UP:
-            changed = ImplHandleButtonChange(state.DU, v.Down, slot, &state.DD);
+            exclusiveButton(s.DU, s.DD);
             break;
         case MY_VK_PAD_DPAD_DOWN:
-            changed = ImplHandleButtonChange(state.DD, v.Down, slot, &state.DU);
+            exclusiveButton(s.DD, s.DU);
             break;
         case MY_VK_PAD_LSHOULDER:
-            changed = ImplHandleButtonChange(state.LB, v.Down, slot);
+            button(s.LB);
             break;
         case MY_VK_PAD_RSHOULDER:
-            changed = ImplHandleButtonChange(state.RB, v.Down, slot);
+            button(s.RB);
             break;
         case MY_VK_PAD_LTHUMB_PRESS:
-            changed = ImplHandleButtonChange(state.L, v.Down, slot);
+            button(s.L);
             break;
         case MY_VK_PAD_RTHUMB_PRESS:
-            changed = ImplHandleButtonChange(state.R, v.Down, slot);
+            button(s.R);
             break;
         case MY_VK_PAD_GUIDE:
-            changed = ImplHandleButtonChange(state.Guide, v.Down, slot);
+            button(s.Guide);
             break;
         case MY_VK_PAD_EXTRA:
-            changed = ImplHandleButtonChange(state.Extra, v.Down, slot);
+            button(s.Extra);
             break;
 
         case MY_VK_PAD_LTRIGGER:
-            changed = ImplHandleTriggerChange(state.LT, v.Down, v.Strength, slot);
+            bind(ImplActionTrigger, s.LT);
             break;
         case MY_VK_PAD_RTRIGGER:
-            changed = ImplHandleTriggerChange(state.RT, v.Down, v.Strength, slot);
+            bind(ImplActionTrigger, s.RT);
             break;
 
         case MY_VK_PAD_LTHUMB_UP:
-            changed = ImplHandleAxisChange(state.LA.U, state.LA.Y, state.LA.X, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.LA.U, s.LA.Y, s.LA.X);
             break;
         case MY_VK_PAD_LTHUMB_DOWN:
-            changed = ImplHandleAxisChange(state.LA.D, state.LA.Y, state.LA.X, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.LA.D, s.LA.Y, s.LA.X);
             break;
         case MY_VK_PAD_LTHUMB_RIGHT:
-            changed = ImplHandleAxisChange(state.LA.R, state.LA.X, state.LA.Y, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.LA.R, s.LA.X, s.LA.Y);
             break;
         case MY_VK_PAD_LTHUMB_LEFT:
-            changed = ImplHandleAxisChange(state.LA.L, state.LA.X, state.LA.Y, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.LA.L, s.LA.X, s.LA.Y);
             break;
         case MY_VK_PAD_RTHUMB_UP:
-            changed = ImplHandleAxisChange(state.RA.U, state.RA.Y, state.RA.X, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.RA.U, s.RA.Y, s.RA.X);
             break;
         case MY_VK_PAD_RTHUMB_DOWN:
-            changed = ImplHandleAxisChange(state.RA.D, state.RA.Y, state.RA.X, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.RA.D, s.RA.Y, s.RA.X);
             break;
         case MY_VK_PAD_RTHUMB_RIGHT:
-            changed = ImplHandleAxisChange(state.RA.R, state.RA.X, state.RA.Y, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.RA.R, s.RA.X, s.RA.Y);
             break;
         case MY_VK_PAD_RTHUMB_LEFT:
-            changed = ImplHandleAxisChange(state.RA.L, state.RA.X, state.RA.Y, user, v.Down, v.Strength, slot, mapping.Add);
+            bind(ImplActionAxis, s.RA.L, s.RA.X, s.RA.Y);
             break;
 
         case MY_VK_PAD_MOTION_UP:
-            ImplHandleMotionRelDimChange(state.Motion, user, ImplMotionState::PosScale,
-                                         state.Motion.YAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::YAxis>, ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_DOWN:
-            ImplHandleMotionRelDimChange(state.Motion, user, -ImplMotionState::PosScale,
-                                         state.Motion.YAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::YAxis>, -ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_RIGHT:
-            ImplHandleMotionRelDimChange(state.Motion, user, ImplMotionState::PosScale,
-                                         state.Motion.XAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::XAxis>, ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_LEFT:
-            ImplHandleMotionRelDimChange(state.Motion, user, -ImplMotionState::PosScale,
-                                         state.Motion.XAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::XAxis>, -ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_NEAR:
-            ImplHandleMotionRelDimChange(state.Motion, user, ImplMotionState::PosScale,
-                                         state.Motion.ZAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::ZAxis>, ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_FAR:
-            ImplHandleMotionRelDimChange(state.Motion, user, -ImplMotionState::PosScale,
-                                         state.Motion.ZAxis(), v, mapping.Rate, mapping.Add);
+            motionRel(ImplActionMotionRel<&ImplMotionState::ZAxis>, -ImplMotionState::PosScale);
             break;
         case MY_VK_PAD_MOTION_ROT_UP:
-            ImplHandleMotionDimChange(state.Motion.RX, user, -ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RX, -ImplMotionState::RotScale);
             break;
         case MY_VK_PAD_MOTION_ROT_DOWN:
-            ImplHandleMotionDimChange(state.Motion.RX, user, ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RX, ImplMotionState::RotScale);
             break;
         case MY_VK_PAD_MOTION_ROT_RIGHT:
-            ImplHandleMotionDimChange(state.Motion.RY, user, ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RY, ImplMotionState::RotScale);
             break;
         case MY_VK_PAD_MOTION_ROT_LEFT:
-            ImplHandleMotionDimChange(state.Motion.RY, user, -ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RY, -ImplMotionState::RotScale);
             break;
         case MY_VK_PAD_MOTION_ROT_CW:
-            ImplHandleMotionDimChange(state.Motion.RZ, user, -ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RZ, -ImplMotionState::RotScale);
             break;
         case MY_VK_PAD_MOTION_ROT_CCW:
-            ImplHandleMotionDimChange(state.Motion.RZ, user, ImplMotionState::RotScale, v, mapping.Rate, mapping.Add);
+            motionDim(s.Motion.RZ, ImplMotionState::RotScale);
             break;
 
         case MY_VK_PAD_LTHUMB_HORZ_MODIFIER:
-            changed = ImplHandleAxisModifierChange(state.LA.X, state.LA.Y, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisModifier, s.LA.X, s.LA.Y);
             break;
         case MY_VK_PAD_LTHUMB_VERT_MODIFIER:
-            changed = ImplHandleAxisModifierChange(state.LA.Y, state.LA.X, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisModifier, s.LA.Y, s.LA.X);
             break;
         case MY_VK_PAD_RTHUMB_HORZ_MODIFIER:
-            changed = ImplHandleAxisModifierChange(state.RA.X, state.RA.Y, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisModifier, s.RA.X, s.RA.Y);
             break;
         case MY_VK_PAD_RTHUMB_VERT_MODIFIER:
-            changed = ImplHandleAxisModifierChange(state.RA.Y, state.RA.X, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisModifier, s.RA.Y, s.RA.X);
             break;
         case MY_VK_PAD_LTRIGGER_MODIFIER:
-            changed = ImplHandleTriggerModifierChange(state.LT, v.Down, v.Strength, slot, changes);
+            bind(ImplActionTriggerModifier, s.LT);
             break;
         case MY_VK_PAD_RTRIGGER_MODIFIER:
-            changed = ImplHandleTriggerModifierChange(state.RT, v.Down, v.Strength, slot, changes);
+            bind(ImplActionTriggerModifier, s.RT);
             break;
 
         case MY_VK_PAD_LTHUMB_UP_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.Y, state.LA.X, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, false, false, true, true, true, true, 0, 1);
+            rotator(s.LA.Y, s.LA.X, s.LA, false, false, false, false, true, true, true, true, 0, 1);
             break;
         case MY_VK_PAD_LTHUMB_DOWN_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.Y, state.LA.X, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, true, true, false, false, false, false, 0, -1);
+            rotator(s.LA.Y, s.LA.X, s.LA, true, true, true, true, false, false, false, false, 0, -1);
             break;
         case MY_VK_PAD_LTHUMB_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.X, state.LA.Y, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, false, false, false, false, true, true, 1, 0);
+            rotator(s.LA.X, s.LA.Y, s.LA, true, true, false, false, false, false, true, true, 1, 0);
             break;
         case MY_VK_PAD_LTHUMB_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.X, state.LA.Y, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, true, true, true, true, false, false, -1, 0);
+            rotator(s.LA.X, s.LA.Y, s.LA, false, false, true, true, true, true, false, false, -1, 0);
             break;
         case MY_VK_PAD_LTHUMB_UP_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.Y, state.LA.X, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, false, true, true, true, true, false, -1, 1);
+            rotator(s.LA.Y, s.LA.X, s.LA, false, false, false, true, true, true, true, false, -1, 1);
             break;
         case MY_VK_PAD_LTHUMB_DOWN_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.Y, state.LA.X, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, true, true, true, true, false, false, false, -1, -1);
+            rotator(s.LA.Y, s.LA.X, s.LA, false, true, true, true, true, false, false, false, -1, -1);
             break;
         case MY_VK_PAD_LTHUMB_UP_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.X, state.LA.Y, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, false, false, false, false, true, true, true, 1, 1);
+            rotator(s.LA.X, s.LA.Y, s.LA, true, false, false, false, false, true, true, true, 1, 1);
             break;
         case MY_VK_PAD_LTHUMB_DOWN_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.LA.X, state.LA.Y, state.LA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, true, false, false, false, false, true, 1, -1);
+            rotator(s.LA.X, s.LA.Y, s.LA, true, true, true, false, false, false, false, true, 1, -1);
             break;
         case MY_VK_PAD_RTHUMB_UP_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.Y, state.RA.X, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, false, false, true, true, true, true, 0, 1);
+            rotator(s.RA.Y, s.RA.X, s.RA, false, false, false, false, true, true, true, true, 0, 1);
             break;
         case MY_VK_PAD_RTHUMB_DOWN_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.Y, state.RA.X, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, true, true, false, false, false, false, 0, -1);
+            rotator(s.RA.Y, s.RA.X, s.RA, true, true, true, true, false, false, false, false, 0, -1);
             break;
         case MY_VK_PAD_RTHUMB_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.X, state.RA.Y, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, false, false, false, false, true, true, 1, 0);
+            rotator(s.RA.X, s.RA.Y, s.RA, true, true, false, false, false, false, true, true, 1, 0);
             break;
         case MY_VK_PAD_RTHUMB_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.X, state.RA.Y, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, true, true, true, true, false, false, -1, 0);
+            rotator(s.RA.X, s.RA.Y, s.RA, false, false, true, true, true, true, false, false, -1, 0);
             break;
         case MY_VK_PAD_RTHUMB_UP_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.Y, state.RA.X, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, false, false, true, true, true, true, false, -1, 1);
+            rotator(s.RA.Y, s.RA.X, s.RA, false, false, false, true, true, true, true, false, -1, 1);
             break;
         case MY_VK_PAD_RTHUMB_DOWN_LEFT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.Y, state.RA.X, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  false, true, true, true, true, false, false, false, -1, -1);
+            rotator(s.RA.Y, s.RA.X, s.RA, false, true, true, true, true, false, false, false, -1, -1);
             break;
         case MY_VK_PAD_RTHUMB_UP_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.X, state.RA.Y, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, false, false, false, false, true, true, true, 1, 1);
+            rotator(s.RA.X, s.RA.Y, s.RA, true, false, false, false, false, true, true, true, 1, 1);
             break;
         case MY_VK_PAD_RTHUMB_DOWN_RIGHT_ROTATOR:
-            changed = ImplHandleAxisRotatorChange(state.RA.X, state.RA.Y, state.RA, user, mapping, v.Down, v.Strength, changes,
-                                                  true, true, true, false, false, false, false, true, 1, -1);
+            rotator(s.RA.X, s.RA.Y, s.RA, true, true, true, false, false, false, false, true, 1, -1);
             break;
 
         case MY_VK_PAD_LTHUMB_ROTATOR_MODIFIER:
-            changed = ImplHandleAxisRotatorModifierChange(state.LA, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisRotatorModifier, s.LA);
             break;
         case MY_VK_PAD_RTHUMB_ROTATOR_MODIFIER:
-            changed = ImplHandleAxisRotatorModifierChange(state.RA, user, v.Down, v.Strength, slot, changes);
+            bind(ImplActionAxisRotatorModifier, s.RA);
             break;
 
         case MY_VK_SET_ACTIVE_USER:
-            if (!v.Down) {
-                if (G.DefaultActiveUser == G.ActiveUser) {
-                    G.ActiveUser = userIndex;
-                }
-                G.DefaultActiveUser = userIndex;
-            }
+            action.Handler = ImplActionSetActiveUser;
             break;
-
         case MY_VK_HOLD_ACTIVE_USER:
-            if (v.Down) {
-                G.ActiveUser = userIndex;
-            } else {
-                G.ActiveUser = G.DefaultActiveUser;
-            }
+            action.Handler = ImplActionHoldActiveUser;
             break;
-
         case MY_VK_TOGGLE_CONNECTED:
-            if (!v.Down) {
-                PostAppCallback(ImplToggleConnected, (void *)(uintptr_t)userIndex);
-            }
+            external(ImplActionToggleConnected);
             break;
 
         default:
-            Fatal("Invalid pad input action?!");
-        }
-
-        if (changed) {
-            changes->ChangeUser(userIndex, state, v.Time);
+            action.Handler = ImplActionInvalid;
+            break;
         }
     } else {
         switch (key) {
         case MY_VK_RELOAD:
-            if (!v.Down) {
-                PostAppCallback(ConfigReload); // (may have ptrs up the stack)
-            }
+            external(ImplActionPostOnRelease<ConfigReload>);
             break;
-
         case MY_VK_TOGGLE_DISABLE:
-            if (!v.Down) {
-                PostAppCallback(ImplToggleDisable);
-            }
+            external(ImplActionPostOnRelease<ImplToggleDisable>);
             break;
-
         case MY_VK_TOGGLE_ALWAYS:
-            if (!v.Down) {
-                PostAppCallback(ImplToggleAlways);
-            }
+            external(ImplActionPostOnRelease<ImplToggleAlways>);
             break;
-
         case MY_VK_TOGGLE_HIDE_CURSOR:
-            if (!v.Down) {
-                G.HideCursor = !G.HideCursor;
-                UpdateCursor();
-            }
+            external(ImplActionToggleHideCursor);
             break;
-
         case MY_VK_TOGGLE_BOUND_CURSOR:
-            if (!v.Down) {
-                G.BoundCursor = !G.BoundCursor;
-                UpdateCursor();
-            }
+            external(ImplActionToggleBoundCursor);
             break;
-
         case MY_VK_TOGGLE_SPARE_FOR_DEBUG:
-            if (!v.Down) {
-                G.SpareForDebug = !G.SpareForDebug;
-            }
+            external(ImplActionToggleSpareForDebug);
             break;
-
         case MY_VK_LOAD_CONFIG:
-            if (!v.Down) {
-                PostAppCallback(ImplLoadConfig, new SharedPtr<string>(mapping.Data));
-            }
+            external(ImplActionLoadConfig);
+            break;
+        case MY_VK_TOGGLE_LAYER:
+            layer(ImplActionToggleLayer);
+            break;
+        case MY_VK_HOLD_LAYER:
+            layer(ImplActionHoldLayer);
+            break;
+        case MY_VK_PUSH_LAYER:
+            layer(ImplActionPushLayer);
+            break;
+        case MY_VK_POP_LAYER:
+            layer(ImplActionPopLayer);
             break;
-
         case MY_VK_NONE:
+            action.Handler = ImplActionNone;
             break;
 
         case MY_VK_WHEEL_DOWN:
-            ImplGenerateMouseWheel(MOUSEEVENTF_WHEEL, -v.Strength, v.Time);
+            mouseWheel(MOUSEEVENTF_WHEEL, -1);
             break;
         case MY_VK_WHEEL_UP:
-            ImplGenerateMouseWheel(MOUSEEVENTF_WHEEL, v.Strength, v.Time);
+            mouseWheel(MOUSEEVENTF_WHEEL, 1);
             break;
         case MY_VK_WHEEL_LEFT:
-            ImplGenerateMouseWheel(MOUSEEVENTF_HWHEEL, -v.Strength, v.Time);
+            mouseWheel(MOUSEEVENTF_HWHEEL, -1);
             break;
         case MY_VK_WHEEL_RIGHT:
-            ImplGenerateMouseWheel(MOUSEEVENTF_HWHEEL, v.Strength, v.Time);
+            mouseWheel(MOUSEEVENTF_HWHEEL, 1);
             break;
 
         case MY_VK_MOUSE_DOWN:
-            ImplGenerateMouseMotion(0, v.Strength, v.Time, changes);
+            mouseMotion(0, 1);
             break;
         case MY_VK_MOUSE_UP:
-            ImplGenerateMouseMotion(0, -v.Strength, v.Time, changes);
+            mouseMotion(0, -1);
             break;
         case MY_VK_MOUSE_LEFT:
-            ImplGenerateMouseMotion(-v.Strength, 0, v.Time, changes);
+            mouseMotion(-1, 0);
             break;
         case MY_VK_MOUSE_RIGHT:
-            ImplGenerateMouseMotion(v.Strength, 0, v.Time, changes);
+            mouseMotion(1, 0);
             break;
 
         default:
             if (key > 0 && key < MY_VK_LAST_REAL) {
-                ImplHandleKeyChange(key, v.Down, v.Time, slot);
+                action.Handler = ImplActionKey;
+                action.Param = key;
             } else if (key >= MY_VK_CUSTOM_START) {
-                ImplHandleCustomChange(key - MY_VK_CUSTOM_START, v, slot, mapping);
+                action.Handler = ImplActionCustom;
+                action.Param = key - MY_VK_CUSTOM_START;
             } else {
-                Fatal("Invalid input action?!");
+                action.Handler = ImplActionInvalid;
             }
             break;
         }
     }
 }
 
-static void CALLBACK ImplTurboTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time) {
-    DBG_ASSERT_DLL_THREAD();
-    auto mapping = ImplMapping::FromTimer(id);
-    if (mapping) {
-        mapping->TurboValue = !mapping->TurboValue;
-        ChangedMask changes;
-        InputValue value(mapping->TurboValue, mapping->Strength, time);
-        ImplProcess(*mapping, value, &changes);
+static void ImplProcess(ImplMapping &mapping, InputValue &v, ChangedMask *changes) {
+    auto &action = mapping.Action;
+    if (action.External && GImplTrace.IsReplaying()) {
+        GImplTrace.ReplayCommand(mapping.DestKey, v.Down);
+        return;
+    }
+
+    if (mapping.DestType.OfUser) {
+        int userIndex = mapping.DestUser;
+        if (userIndex < 0) {
+            userIndex = G.ActiveUser;
+        }
+
+        ImplUser *user = ImplGetUser(userIndex, action.UserCmd);
+        if (!user) {
+            return;
+        }
+
+        ImplState &state = user->State;
+        changes->TouchUser(userIndex, state);
+
+        if (action.Handler(mapping, user, userIndex, v, changes)) {
+            changes->ChangeUser(userIndex, state, v.Time);
+        }
+    } else {
+        action.Handler(mapping, nullptr, -1, v, changes);
     }
 }
 
-static void CALLBACK ImplReleaseTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time) {
+static void ImplTurboTimerProc(void *self, hrtime_t time) {
     DBG_ASSERT_DLL_THREAD();
-    auto mapping = ImplMapping::FromTimer(id);
-    if (mapping) {
-        ChangedMask changes;
-        InputValue value(false, mapping->Strength, time);
-        ImplProcessMapping(mapping, value, &changes, true, false);
-    }
+    auto mapping = (ImplMapping *)self;
+    mapping->TurboValue = !mapping->TurboValue;
+    ChangedMask changes;
+    InputValue value(mapping->TurboValue, mapping->Strength, time);
+    ImplProcess(*mapping, value, &changes);
 }
 
-static void CALLBACK ImplRepeatTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time) {
+static void ImplReleaseTimerProc(void *self, hrtime_t time) {
     DBG_ASSERT_DLL_THREAD();
-    auto mapping = ImplMapping::FromTimer(id);
-    if (mapping) {
-        ChangedMask changes;
-        InputValue value(true, mapping->Strength, time);
-        ImplProcess(*mapping, value, &changes);
-    }
+    auto mapping = (ImplMapping *)self;
+    ChangedMask changes;
+    InputValue value(false, mapping->Strength, time);
+    ImplProcessMapping(mapping, value, &changes, true, false);
 }
 
-static void CALLBACK ImplRepeatFirstTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time) {
+static void ImplRepeatTimerProc(void *self, hrtime_t time) {
     DBG_ASSERT_DLL_THREAD();
-    auto mapping = ImplMapping::FromTimer(id);
-    if (mapping) {
-        ChangedMask changes;
-        InputValue value(true, mapping->Strength, time);
-        ImplProcess(*mapping, value, &changes);
+    auto mapping = (ImplMapping *)self;
+    ChangedMask changes;
+    InputValue value(true, mapping->Strength, time);
+    ImplProcess(*mapping, value, &changes);
+}
 
-        mapping->StartTimerMs(ImplKeyboardRepeatTime(), ImplRepeatTimerProc);
-    }
+static void ImplRepeatFirstTimerProc(void *self, hrtime_t time) {
+    DBG_ASSERT_DLL_THREAD();
+    auto mapping = (ImplMapping *)self;
+    ChangedMask changes;
+    InputValue value(true, mapping->Strength, time);
+    ImplProcess(*mapping, value, &changes);
+
+    mapping->StartTimerMs(ImplKeyboardRepeatTime(), ImplRepeatTimerProc);
 }
 
-static bool ImplCheckCondsOr(ImplCond *cond);
-static bool ImplCheckCondsAnd(ImplCond *cond);
+static bool ImplCheckCondsOr(const ImplCondList &conds);
+static bool ImplCheckCondsAnd(const ImplCondList &conds);
 
-static bool ImplCheckCond(ImplCond *cond) {
-    ImplInput *input = ImplGetInput(cond->Key, cond->User);
+static bool ImplCheckCond(const ImplCond &cond) {
+    ImplInput *input = cond.Input;
     if (!input) {
-        switch (cond->Key) {
+        switch (cond.Key) {
         case MY_VK_META_COND_AND:
-            return ImplCheckCondsAnd(cond->Child) == cond->State;
+            return ImplCheckCondsAnd(cond.ChildList) == cond.State;
         case MY_VK_META_COND_OR:
-            return ImplCheckCondsOr(cond->Child) == cond->State;
+            return ImplCheckCondsOr(cond.ChildList) == cond.State;
         }
         return false;
     }
 
-    if (cond->Toggle) {
-        if (input->AsyncToggle != cond->State) {
+    if (cond.Toggle) {
+        if (input->AsyncToggle != cond.State) {
             return false;
         }
     } else {
-        if (input->AsyncDown != cond->State) {
+        if (input->AsyncDown != cond.State) {
             return false;
         }
     }
@@ -456,26 +657,26 @@ static bool ImplCheckCond(ImplCond *cond) {
     return true;
 }
 
-static bool ImplCheckCondsOr(ImplCond *cond) {
-    do {
+static bool ImplCheckCondsOr(const ImplCondList &conds) {
+    for (auto &cond : G.Arena.GetConds(conds.Conds)) {
         if (ImplCheckCond(cond)) {
             return true;
         }
-
-        cond = cond->Next;
-    } while (cond);
+    }
 
     return false;
 }
 
-static bool ImplCheckCondsAnd(ImplCond *cond) {
-    do {
+static bool ImplCheckCondsAnd(const ImplCondList &conds) {
+    if (conds.MaskIdx && !G.Arena.CondMasks[conds.MaskIdx - 1].Check(G.Keyboard.Down, G.Keyboard.Toggle)) {
+        return false;
+    }
+
+    for (auto &cond : G.Arena.GetConds(conds.Conds)) {
         if (!ImplCheckCond(cond)) {
             return false;
         }
-
-        cond = cond->Next;
-    } while (cond);
+    }
 
     return true;
 }
@@ -485,13 +686,13 @@ static bool ImplCanProcess(ImplMapping *mapping, bool down, bool oldDown, bool c
         return false;
     }
 
-    if (mapping->Conds) {
+    if (!mapping->CondList.IsEmpty()) {
         if (check || mapping->SrcType.Relative) {
-            if (!ImplCheckCondsAnd(mapping->Conds)) {
+            if (!ImplCheckCondsAnd(mapping->CondList)) {
                 return false;
             }
         } else if (down && !oldDown) {
-            if (!ImplCheckCondsAnd(mapping->Conds)) {
+            if (!ImplCheckCondsAnd(mapping->CondList)) {
                 return false;
             }
 
@@ -522,7 +723,7 @@ static bool ImplPreProcess(ImplMapping *mapping, InputValue &v, bool &oldDown, b
     }
 
     if (mapping->Add && !v.Down) {
-        if (!mapping->Conds) {
+        if (mapping->CondList.IsEmpty()) {
             reset = true;
         }
 
@@ -603,6 +804,12 @@ static bool ImplProcessMapping(ImplMapping *mapping, const InputValue &v, Change
     if (ImplCanProcess(mapping, v.Down, oldDown) || reset) {
         InputValue mapV = v;
         if (ImplPreProcess(mapping, mapV, oldDown, reset)) {
+            if (GEventTrace.IsEnabled()) {
+                GEventTrace.Add(EventTraceKind::Mapping, mapV.Down ? EventTraceFlag_Down : 0, mapping->DestUser, mapping->DestKey,
+                                (int32_t)(mapV.Strength * 1000), 0, mapping->DestSlot);
+            }
+            GPerfCounters.Add(PerfCounter_MappingsFired);
+
             ImplProcess(*mapping, mapV, changes);
         }
         ImplPostProcess(mapping, mapV, oldDown);
@@ -614,14 +821,42 @@ static bool ImplProcessMapping(ImplMapping *mapping, const InputValue &v, Change
     return processed;
 }
 
-static void ImplProcessReset(ImplReset *reset, DWORD time, ChangedMask *changes) {
-    ImplMapping *mapping = reset->Mapping;
-    if ((mapping->PassedCond || mapping->Add || mapping->SrcType.Relative) && !ImplCheckCondsAnd(mapping->Conds)) {
+static void ImplProcessReset(ImplMapping *mapping, hrtime_t time, ChangedMask *changes) {
+    if ((mapping->PassedCond || mapping->Add || mapping->SrcType.Relative) && !ImplCheckCondsAnd(mapping->CondList)) {
         InputValue value(false, mapping->Strength, time);
         ImplProcessMapping(mapping, value, changes, true, true); // passing oldDown=true here seems bad...
     }
 }
 
+// The topmost active layer that maps the input, or else the base layer
+static int ImplSelectLayer(ImplInput *input) {
+    uint64_t mask = input->LayerMask & G.Layers.Active;
+    if (!mask) {
+        return 0;
+    } else if (!(mask & (mask - 1))) {
+        return std::countr_zero(mask);
+    }
+
+    for (int i = G.Layers.Depth - 1; i >= 0; i--) {
+        if (mask & (1ull << G.Layers.Stack[i])) {
+            return G.Layers.Stack[i];
+        }
+    }
+    return 0;
+}
+
+static span<ImplMapping> ImplGetLayerMappings(ImplInput *input, int layer) {
+    if (!layer) {
+        return G.Arena.GetMappings(input->Mappings);
+    } else if (!(input->LayerMask & (1ull << layer))) {
+        return {};
+    }
+
+    // (LayerSpans has a span per bit of LayerMask)
+    int idx = popcount(input->LayerMask & ((1ull << layer) - 1));
+    return G.Arena.GetMappings(G.Arena.LayerSpans[input->LayerSpans.Begin + idx]);
+}
+
 static bool ImplProcessInput(ImplInput *input, const InputValue &v, ChangedMask *changes, bool relative = false, bool reset = false) {
     if (G.Paused) {
         return false;
@@ -632,17 +867,23 @@ static bool ImplProcessInput(ImplInput *input, const InputValue &v, ChangedMask
         input->AsyncToggle = !input->AsyncToggle;
     }
     input->AsyncDown = v.Down;
+    G.Keyboard.UpdateAsync(input);
+
+    // (the layer is chosen on press, and the release goes to the same mappings even if the layers changed since)
+    if (v.Down && (!oldDown || relative)) {
+        input->PressLayer = (uint8_t)ImplSelectLayer(input);
+    }
 
     bool processed = false;
-    for (ImplMapping *mapping = input->Mappings; mapping; mapping = mapping->Next) {
-        if (ImplProcessMapping(mapping, v, changes, oldDown, reset)) {
+    for (auto &mapping : ImplGetLayerMappings(input, input->PressLayer)) {
+        if (ImplProcessMapping(&mapping, v, changes, oldDown, reset)) {
             processed = true;
         }
     }
 
     if (v.Down != oldDown) {
-        for (ImplReset *reset = input->Resets; reset; reset = reset->Next) {
-            ImplProcessReset(reset, v.Time, changes);
+        for (ImplMapping *mapping : G.Arena.GetResets(v.Down ? input->PressResets : input->ReleaseResets)) {
+            ImplProcessReset(mapping, v.Time, changes);
         }
     }
 
@@ -657,7 +898,7 @@ static bool ImplProcessInput(ImplInput *input, const InputValue &v, ChangedMask
     return processed;
 }
 
-static bool ImplGenericButtonHook(int virtKeyCode, bool down, bool extended, bool repeatable, DWORD time, ChangedMask *changes) {
+static bool ImplGenericButtonHook(int virtKeyCode, bool down, bool extended, bool repeatable, hrtime_t time, ChangedMask *changes) {
     DBG_ASSERT_DLL_THREAD();
 
     virtKeyCode = ImplUnextend(virtKeyCode, extended);
@@ -667,16 +908,32 @@ static bool ImplGenericButtonHook(int virtKeyCode, bool down, bool extended, boo
     return input ? ImplProcessInput(input, value, changes) : false;
 }
 
-static bool ImplKeyboardHook(int virtKeyCode, bool down, bool extended, DWORD time) {
+static bool ImplKeyboardHook(int virtKeyCode, bool down, bool extended, hrtime_t time) {
+    if (GImplTrace.IsRecording()) {
+        GImplTrace.Record(time, ImplTraceType::Keyboard, (down ? ImplTraceFlag_Down : 0) | (extended ? ImplTraceFlag_Extended : 0), virtKeyCode);
+    }
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::KeyboardIn, (down ? EventTraceFlag_Down : 0) | (extended ? EventTraceFlag_Extended : 0), -1, virtKeyCode);
+    }
+    GPerfCounters.Add(PerfCounter_KeyboardEvents);
+
     ChangedMask changes;
     return ImplGenericButtonHook(virtKeyCode, down, extended, true, time, &changes);
 }
 
-static bool ImplProcessMouseButton(int virtKeyCode, bool down, DWORD time, ChangedMask *changes) {
+static bool ImplProcessMouseButton(int virtKeyCode, bool down, hrtime_t time, ChangedMask *changes) {
+    if (GImplTrace.IsRecording()) {
+        GImplTrace.Record(time, ImplTraceType::MouseButton, down ? ImplTraceFlag_Down : 0, virtKeyCode);
+    }
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::MouseButtonIn, down ? EventTraceFlag_Down : 0, -1, virtKeyCode);
+    }
+    GPerfCounters.Add(PerfCounter_MouseButtonEvents);
+
     return ImplGenericButtonHook(virtKeyCode, down, false, false, time, changes);
 }
 
-static bool ImplProcessMouseAxis(ImplMouseAxis &axis, int delta, DWORD time, ChangedMask *changes, double scale) {
+static bool ImplProcessMouseAxis(ImplMouseAxis &axis, int delta, hrtime_t time, ChangedMask *changes, double scale) {
     double strength = (double)abs(delta) * scale;
     InputValue value(true, strength, time);
     InputValue cancelValue(false, strength, time);
@@ -687,8 +944,15 @@ static bool ImplProcessMouseAxis(ImplMouseAxis &axis, int delta, DWORD time, Cha
     return changed;
 }
 
-static bool ImplMouseMotionHook(int dx, int dy, DWORD time, ChangedMask *changes) {
+static bool ImplMouseMotionHook(int dx, int dy, hrtime_t time, ChangedMask *changes) {
     DBG_ASSERT_DLL_THREAD();
+    if (GImplTrace.IsRecording()) {
+        GImplTrace.Record(time, ImplTraceType::MouseMotion, 0, 0, dx, dy);
+    }
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::MouseMotionIn, 0, -1, 0, dx, dy);
+    }
+    GPerfCounters.Add(PerfCounter_MouseMotionEvents);
 
     auto &input = G.Mouse.Motion;
 
@@ -698,8 +962,15 @@ static bool ImplMouseMotionHook(int dx, int dy, DWORD time, ChangedMask *changes
     return processed;
 }
 
-static bool ImplMouseWheelHook(bool horiz, int delta, DWORD time, ChangedMask *changes) {
+static bool ImplMouseWheelHook(bool horiz, int delta, hrtime_t time, ChangedMask *changes) {
     DBG_ASSERT_DLL_THREAD();
+    if (GImplTrace.IsRecording()) {
+        GImplTrace.Record(time, ImplTraceType::MouseWheel, horiz ? ImplTraceFlag_Horizontal : 0, 0, delta);
+    }
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::MouseWheelIn, horiz ? EventTraceFlag_Horizontal : 0, -1, 0, delta);
+    }
+    GPerfCounters.Add(PerfCounter_MouseWheelEvents);
 
     auto &input = horiz ? G.Mouse.HWheel : G.Mouse.Wheel;
 
@@ -709,6 +980,13 @@ static bool ImplMouseWheelHook(bool horiz, int delta, DWORD time, ChangedMask *c
 
 static void ImplOnCustomKey(int index, const InputValue &value) {
     DBG_ASSERT_DLL_THREAD();
+    if (GImplTrace.IsRecording()) {
+        GImplTrace.Record(value.Time, ImplTraceType::CustomKey, value.Down ? ImplTraceFlag_Down : 0, index, 0, 0, value.Strength);
+    }
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::CustomKeyIn, value.Down ? EventTraceFlag_Down : 0, -1, index, (int32_t)(value.Strength * 1000));
+    }
+    GPerfCounters.Add(PerfCounter_CustomKeyEvents);
 
     ChangedMask changes;
     if ((size_t)index < G.CustomKeys.size()) {
@@ -722,6 +1000,242 @@ static void ImplOnCustomKey(int index, const InputValue &value) {
     }
 }
 
+static void ImplReplayWriteUserStates(int *versions) {
+    if (!GImplTrace.HasReplayOutput()) {
+        return;
+    }
+
+    for (int i = 0; i < IMPL_MAX_USERS; i++) {
+        auto &user = G.Users[i];
+        if (user.State.Version == versions[i]) {
+            continue;
+        }
+        versions[i] = user.State.Version;
+
+        MyInputHook_InState_Basic basic;
+        MyInputHook_InState_Motion motion;
+        ImplPadGetInState(&user, MyInputHook_InState_Basic_Type, &basic, sizeof(basic));
+        ImplPadGetInState(&user, MyInputHook_InState_Motion_Type, &motion, sizeof(motion));
+
+        auto &out = GImplTrace.ReplayLine();
+        out << "user " << i << " ";
+        for (auto btn : {basic.A, basic.B, basic.X, basic.Y, basic.DL, basic.DR, basic.DU, basic.DD, basic.LB,
+                         basic.RB, basic.LT, basic.RT, basic.L, basic.R, basic.Start, basic.Back, basic.Guide, basic.Extra}) {
+            out << (btn ? '1' : '0');
+        }
+        for (auto value : {basic.LX, basic.LY, basic.RX, basic.RY, basic.LTStr, basic.RTStr}) {
+            out << " " << value;
+        }
+        for (auto axis : {&motion.X, &motion.Y, &motion.Z, &motion.RX, &motion.RY, &motion.RZ}) {
+            out << " " << axis->Pos << "/" << axis->Speed << "/" << axis->Accel;
+        }
+        out << "\n";
+    }
+}
+
+struct ImplReplayStats {
+    vector<uint32_t> EventNs; // processing time of each event
+    double Seconds = 0;
+};
+
+// Runs a replay on a copy of the engine's runtime state, leaving the live one as it was:
+// saves the state (suspending its timers) on construction, and restores it on destruction.
+// Meanwhile, timers run on a separate wheel, and - as GImplTrace is replaying - nothing is published to the
+// devices, sent to the system, or done outside the engine (see ImplAction::External)
+class ImplReplayScope {
+    struct UserSave {
+        ImplStateData State;
+        UserTimerRun MotionTimer;
+    };
+
+    struct CustomKeySave {
+        ImplInput Key;
+        ImplStrengthOutput Strength;
+    };
+
+    vector<ImplInput> mKeys;
+    ImplKeySet mDown, mToggle;
+    ImplMouse mMouse;
+    vector<CustomKeySave> mCustomKeys;
+    vector<ImplMapping> mMappings;
+    vector<UserTimerRun> mMappingTimers;
+    UserSave mUsers[IMPL_MAX_USERS];
+    ImplLayers mLayers;
+    int mActiveUser, mDefaultActiveUser;
+    bool mEventTrace;
+    TimerWheel mWheel;
+
+public:
+    ImplReplayScope() : mKeys(G.Keyboard.Keys, G.Keyboard.Keys + ImplKeyboard::Count), mDown(G.Keyboard.Down), mToggle(G.Keyboard.Toggle),
+                        mMouse(G.Mouse), mMappings(G.Arena.Mappings), mLayers(G.Layers),
+                        mActiveUser(G.ActiveUser), mDefaultActiveUser(G.DefaultActiveUser), mEventTrace(GEventTrace.IsEnabled()) {
+        for (auto &custom : G.CustomKeys) {
+            mCustomKeys.push_back({custom->Key, custom->Strength});
+        }
+
+        for (auto &mapping : G.Arena.Mappings) {
+            mMappingTimers.push_back(mapping.Timer.Suspend());
+        }
+
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            mUsers[i].State = G.Users[i].State;
+            mUsers[i].MotionTimer = G.Users[i].State.Motion.Timer.Suspend();
+        }
+
+        GEventTrace.SetEnabled(false);
+        GUserTimers.Isolate(&mWheel);
+    }
+
+    ImplReplayScope(const ImplReplayScope &) = delete;
+
+    ~ImplReplayScope() {
+        // (assigning ends the replay's timers)
+        std::copy(mKeys.begin(), mKeys.end(), G.Keyboard.Keys);
+        G.Keyboard.Down = mDown;
+        G.Keyboard.Toggle = mToggle;
+        G.Mouse = mMouse;
+
+        for (size_t i = 0; i < mCustomKeys.size(); i++) {
+            G.CustomKeys[i]->Key = mCustomKeys[i].Key;
+            G.CustomKeys[i]->Strength = mCustomKeys[i].Strength;
+        }
+
+        for (size_t i = 0; i < mMappings.size(); i++) {
+            G.Arena.Mappings[i] = mMappings[i];
+        }
+
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            (ImplStateData &)G.Users[i].State = mUsers[i].State;
+        }
+
+        G.Layers = mLayers;
+        G.ActiveUser = mActiveUser;
+        G.DefaultActiveUser = mDefaultActiveUser;
+
+        GUserTimers.Isolate(nullptr);
+        for (size_t i = 0; i < mMappings.size(); i++) {
+            G.Arena.Mappings[i].Timer.Resume(mMappingTimers[i]);
+        }
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            G.Users[i].State.Motion.Timer.Resume(mUsers[i].MotionTimer);
+        }
+
+        GEventTrace.SetEnabled(mEventTrace);
+    }
+};
+
+// Feeds events through the loaded config, writing the resulting user states & generated output to outPath (if not null)
+// The replay starts from the live state, but runs on a copy of it (see ImplReplayScope), so the app sees none of it.
+// (timers run on the events' timeline instead of the real one, so the output is deterministic)
+static bool ImplReplayEvents(span<const ImplTraceEvent> events, const wchar_t *outPath, ImplReplayStats *stats = nullptr) {
+    DBG_ASSERT_DLL_THREAD();
+    GImplTrace.EndRecord();
+
+    hrtime_t start = GHrClock.Now();
+    uint64_t realStartNs = GHrClock.RealNowNs();
+    if (!GImplTrace.StartReplay(outPath, start)) {
+        return false;
+    }
+
+    UniquePtr<ImplReplayScope> scope = UniquePtr<ImplReplayScope>::New();
+
+    int versions[IMPL_MAX_USERS];
+    for (int i = 0; i < IMPL_MAX_USERS; i++) {
+        versions[i] = G.Users[i].State.Version;
+    }
+
+    auto advanceTo = [&](hrtime_t time) {
+        for (hrtime_t next; (next = GUserTimers.NextTime()) <= time;) {
+            GHrClock.FixTime(next);
+            GUserTimers.Update();
+            ImplReplayWriteUserStates(versions);
+        }
+        GHrClock.FixTime(time);
+    };
+
+    if (stats) {
+        stats->EventNs.reserve(events.size());
+    }
+
+    hrtime_t time = start;
+    for (auto &event : events) {
+        time = max(time, start + (event.Time - events[0].Time));
+        advanceTo(time);
+
+        uint64_t eventStartNs = stats ? GHrClock.RealNowNs() : 0;
+
+        bool down = (event.Flags & ImplTraceFlag_Down) != 0;
+        switch (event.Type) {
+        case ImplTraceType::Keyboard:
+            ImplKeyboardHook(event.Key, down, (event.Flags & ImplTraceFlag_Extended) != 0, time);
+            break;
+
+        case ImplTraceType::MouseButton: {
+            ChangedMask changes;
+            ImplProcessMouseButton(event.Key, down, time, &changes);
+        } break;
+
+        case ImplTraceType::MouseMotion: {
+            ChangedMask changes;
+            ImplMouseMotionHook(event.X, event.Y, time, &changes);
+        } break;
+
+        case ImplTraceType::MouseWheel: {
+            ChangedMask changes;
+            ImplMouseWheelHook((event.Flags & ImplTraceFlag_Horizontal) != 0, event.X, time, &changes);
+        } break;
+
+        case ImplTraceType::CustomKey:
+            ImplOnCustomKey(event.Key, InputValue(down, event.Strength, time));
+            break;
+
+        default:
+            LOG_W << "ERROR: Unknown trace event type: " << (int)event.Type << END;
+            break;
+        }
+
+        if (stats) {
+            stats->EventNs.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - eventStartNs, UINT32_MAX));
+        }
+
+        ImplReplayWriteUserStates(versions);
+    }
+
+    ImplAbortMappings(); // release whatever the events left held (still into the replay output)
+    ImplReplayWriteUserStates(versions);
+
+    double elapsed = (double)(GHrClock.RealNowNs() - realStartNs) / 1e9;
+    if (stats) {
+        stats->Seconds = elapsed;
+    }
+
+    scope.reset(); // (back to the live state)
+    GImplTrace.EndReplay();
+    GHrClock.UnfixTime();
+    GUserTimers.Update();
+
+    LOG << "Replayed " << events.size() << " events in " << elapsed << "s (" << events.size() / max(elapsed, 1e-9) << " events/s)" << END;
+    return true;
+}
+
+static bool ImplReplayTrace(const wchar_t *path, const wchar_t *outPath) {
+    std::ifstream file(path, std::ios::binary);
+    ImplTraceHeader header;
+    if (!file.read((char *)&header, sizeof(header)) ||
+        header.Magic != ImplTraceHeader::MagicValue || header.Version != ImplTraceHeader::CurrentVersion) {
+        LOG_W << "ERROR: Failed to read trace from: " << path << END;
+        return false;
+    }
+
+    vector<ImplTraceEvent> events;
+    ImplTraceEvent event;
+    while (file.read((char *)&event, sizeof(event))) {
+        events.push_back(event);
+    }
+
+    return ImplReplayEvents(events, outPath);
+}
+
 static bool ImplCheckInput(ImplInput *input, bool down) {
     if (G.Paused) {
         return false;
@@ -733,9 +1247,9 @@ static bool ImplCheckInput(ImplInput *input, bool down) {
         return false; // forward releases of presses started while inactive
     }
 
-    for (ImplMapping *mapping = input->Mappings; mapping; mapping = mapping->Next) {
-        if (ImplCanProcess(mapping, down, !down, true) &&
-            !mapping->Forward && !G.Forward) {
+    for (auto &mapping : ImplGetLayerMappings(input, down ? ImplSelectLayer(input) : input->PressLayer)) {
+        if (ImplCanProcess(&mapping, down, !down, true) &&
+            !mapping.Forward && !G.Forward) {
             return true;
         }
     }
@@ -776,7 +1290,7 @@ static bool ImplCheckMouseWheel(bool horiz) {
 }
 
 static void ImplAbortMappings() {
-    InputValue value(false, 0.0, GetTickCount());
+    InputValue value(false, 0.0, GHrClock.Now());
     ChangedMask changes;
 
     for (int key = 0; key < ImplKeyboard::Count; key++) {
@@ -788,6 +1302,18 @@ static void ImplAbortMappings() {
     // this leaves AsyncState wrong, up to UpdateAll to fix it
 }
 
+// Same as ImplAbortMappings, but only for the given inputs
+static void ImplAbortInputs(const vector<ImplInput *> &inputs) {
+    InputValue value(false, 0.0, GHrClock.Now());
+    ChangedMask changes;
+
+    for (ImplInput *input : inputs) {
+        if (input >= G.Keyboard.Keys && input < G.Keyboard.Keys + ImplKeyboard::Count) {
+            ImplProcessInput(input, value, &changes, false, true);
+        }
+    }
+}
+
 static void ImplBeginObservePresses() {
     for (int key = 0; key < ImplKeyboard::Count; key++) {
         auto &input = G.Keyboard.Keys[key];
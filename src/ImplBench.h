@@ -0,0 +1,803 @@
+#pragma once
+#include "Impl.h"
+#include "UtilsTimerTest.h"
+
+// Benchmarks of the mapping engine, run against synthetic configs written for them (and the shipped configs, for parsing),
+// so that results don't depend on the config loaded at the time
+// (results are written as one json object per line, to be tracked across releases)
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+
+// Counts the heap allocations of one thread, while installed as the debug crt's alloc hook
+// (so release builds - the ones injected into games - allocate as usual)
+static uint64_t GImplBenchAllocCount = 0;
+static DWORD GImplBenchAllocThread = 0;
+
+static int __cdecl ImplBenchAllocHook(int allocType, void *, size_t, int, long, const unsigned char *, int) {
+    if (allocType == _HOOK_ALLOC && GetCurrentThreadId() == GImplBenchAllocThread) {
+        GImplBenchAllocCount++;
+    }
+    return TRUE;
+}
+#endif
+
+static void ImplBenchWriteResult(std::ofstream &out, const char *name, vector<uint32_t> &samplesNs, double seconds) {
+    std::sort(samplesNs.begin(), samplesNs.end());
+    auto percentile = [&](double fraction) {
+        return samplesNs.empty() ? 0 : samplesNs[min((size_t)(fraction * samplesNs.size()), samplesNs.size() - 1)];
+    };
+
+    out << "{\"name\": \"" << name << "\", \"count\": " << samplesNs.size()
+        << ", \"per_sec\": " << (seconds > 0 ? samplesNs.size() / seconds : 0)
+        << ", \"p50_ns\": " << percentile(0.5) << ", \"p90_ns\": " << percentile(0.9)
+        << ", \"p99_ns\": " << percentile(0.99) << ", \"max_ns\": " << percentile(1) << "}\n";
+
+    LOG << "Benchmark " << name << ": " << samplesNs.size() << " samples, median " << percentile(0.5) << "ns" << END;
+}
+
+static void ImplBenchEvents(std::ofstream &out, const char *name, const vector<ImplTraceEvent> &events) {
+    ImplReplayStats stats;
+    if (ImplReplayEvents(events, nullptr, &stats)) {
+        ImplBenchWriteResult(out, name, stats.EventNs, stats.Seconds);
+    }
+}
+
+// presses & releases of all letter keys, 'interval' apart
+static vector<ImplTraceEvent> ImplBenchKeyboardEvents(int count, hrtime_t interval) {
+    vector<ImplTraceEvent> events;
+    for (int i = 0; i < count; i++) {
+        uint8_t flags = (i % 2) ? 0 : ImplTraceFlag_Down;
+        events.push_back({i * interval, ImplTraceType::Keyboard, flags, (uint16_t)('A' + (i / 2) % 26)});
+    }
+    return events;
+}
+
+// mouse moving in circles, reported at 'rate' Hz
+static vector<ImplTraceEvent> ImplBenchMouseEvents(int rate, double seconds) {
+    vector<ImplTraceEvent> events;
+    int count = (int)(rate * seconds);
+    for (int i = 0; i < count; i++) {
+        auto [s, c] = SinCos(2 * std::numbers::pi * i / rate);
+        int dx = (int)nearbyint(c * 10), dy = (int)nearbyint(s * 10);
+        events.push_back({i * HrTimePerSec / rate, ImplTraceType::MouseMotion, 0, 0, dx, dy});
+    }
+    return events;
+}
+
+static void ImplBenchDeleteConfig(const wchar_t *name) {
+    Path path = PathCombine(GConfig.Directory, name);
+    DeleteFileW(path);
+    DeleteFileW(ConfigGetCachePath(name));
+    GConfig.Residents.erase(name);
+}
+
+static void ImplBenchWriteConfig(const wchar_t *name, const char *text) {
+    std::ofstream(PathCombine(GConfig.Directory, name)) << text;
+}
+
+// replays the events with the given config applied
+static void ImplBenchEventsOn(std::ofstream &out, const char *name, const wchar_t *configName, const vector<ImplTraceEvent> &events) {
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(configName));
+    ImplBenchEvents(out, name, events);
+    ConfigSwitch(Path(original.c_str()));
+}
+
+static string ImplBenchKeyName(int idx) {
+    idx %= 48;
+    if (idx < 26) {
+        return string(1, (char)('A' + idx));
+    } else if (idx < 38) {
+        return "F" + std::to_string(idx - 25);
+    } else {
+        return "Numpad" + std::to_string(idx - 38);
+    }
+}
+
+// a config of 'numLines' lines, cycling through the kinds of lines configs have - mappings to keys & to the pad,
+// with strengths & conditions, layers and comments (always the same for the same arguments)
+static void ImplBenchWriteLargeConfig(const wchar_t *name, int numLines, const char *extra = "") {
+    static const char *padKeys[] = {"%A", "%B", "%X", "%Y", "%LB", "%RB", "%LT", "%RT", "%L.Up", "%R.Left", "%D.Down", "%Start"};
+
+    std::ofstream out(PathCombine(GConfig.Directory, name));
+    out << extra;
+    for (int i = 0; i < numLines; i++) {
+        switch (i % 8) {
+        case 0:
+            out << ImplBenchKeyName(i) << " : " << ImplBenchKeyName(i * 7 + 3) << " ?" << ImplBenchKeyName(i * 3 + 1) << "\n";
+            break;
+        case 1:
+            out << ImplBenchKeyName(i) << " : " << padKeys[i % 12] << " ~0.5 ?~" << ImplBenchKeyName(i + 5) << "\n";
+            break;
+        case 2:
+            out << ImplBenchKeyName(i) << " : %L.Up !Add ~0.01 ?" << ImplBenchKeyName(i * 5 + 2) << " ?" << ImplBenchKeyName(i * 11 + 4) << "\n";
+            break;
+        case 3:
+            out << "# line " << i << "\n";
+            break;
+        case 4:
+            out << "[ !Layer bench" << (i / 8) % 4 << "\n";
+            break;
+        case 5:
+            out << ImplBenchKeyName(i) << " : " << padKeys[(i + 1) % 12] << "\n";
+            break;
+        case 6:
+            out << "]\n";
+            break;
+        case 7:
+            out << ImplBenchKeyName(i) << " : " << ImplBenchKeyName(i + 1) << " ~0.5 ?~" << ImplBenchKeyName(i + 2) << "\n";
+            break;
+        }
+    }
+}
+
+// a config of 'numMappings' conditional mappings, spread over enough outputs that none runs out of slots
+// (unlike in the large config, whose outputs are each mapped far more often than in real configs)
+static void ImplBenchWriteMappingsConfig(const wchar_t *name, int numMappings, const char *extra = "") {
+    static const char *padKeys[] = {"%A", "%B", "%X", "%Y", "%LB", "%RB", "%LT", "%RT", "%L.Up", "%L.Down", "%L.Left",
+                                    "%L.Right", "%R.Up", "%R.Down", "%R.Left", "%R.Right", "%D.Up", "%D.Down", "%D.Left", "%D.Right", "%Start", "%Back"};
+
+    vector<string> outputs(padKeys, padKeys + size(padKeys));
+    for (char ch = 'A'; ch <= 'Z'; ch++) {
+        outputs.push_back(string(1, ch));
+    }
+    for (int i = 0; i < 10; i++) {
+        outputs.push_back(std::to_string(i));
+        outputs.push_back("Numpad" + std::to_string(i));
+    }
+    for (int i = 1; i <= 24; i++) {
+        outputs.push_back("F" + std::to_string(i));
+    }
+
+    std::ofstream out(PathCombine(GConfig.Directory, name));
+    out << extra;
+    for (int i = 0; i < numMappings; i++) {
+        out << ImplBenchKeyName(i) << " : " << outputs[i % outputs.size()] << " ?" << ImplBenchKeyName(i / 48 + 7) << "\n";
+    }
+}
+
+constexpr const wchar_t *ImplBenchLargeName = L"_bench_large.ini";
+constexpr int ImplBenchLargeLines = 10000;
+
+constexpr const wchar_t *ImplBenchTreeName = L"_bench_tree.ini";
+constexpr int ImplBenchTreeGames = 8, ImplBenchTreePlayers = 4, ImplBenchTreeFileLines = 250;
+
+// a config split over an include tree, like a shared base config that includes per-game configs, each including per-player configs
+// (the files of each level are independent, so read-ahead can read them together)
+// returns the names of all its files
+static vector<wstring> ImplBenchWriteIncludeTree() {
+    vector<wstring> names;
+    auto write = [&](const wstring &name, const string &includes) {
+        ImplBenchWriteLargeConfig(name.c_str(), ImplBenchTreeFileLines, includes.c_str());
+        names.push_back(name);
+    };
+
+    string baseIncludes;
+    for (int game = 0; game < ImplBenchTreeGames; game++) {
+        string gameIncludes;
+        for (int player = 0; player < ImplBenchTreePlayers; player++) {
+            string playerName = "_bench_tree_g" + std::to_string(game) + "_p" + std::to_string(player);
+            gameIncludes += "!Include = " + playerName + "\n";
+            write(PathCombineExt(PathFromStr(playerName.c_str()), L"ini").Get(), "");
+        }
+
+        string gameName = "_bench_tree_g" + std::to_string(game);
+        baseIncludes += "!Include = " + gameName + "\n";
+        write(PathCombineExt(PathFromStr(gameName.c_str()), L"ini").Get(), gameIncludes);
+    }
+
+    write(ImplBenchTreeName, baseIncludes);
+    return names;
+}
+
+// compiling a config from text (reading, splitting & parsing its files), without applying it
+static void ImplBenchConfigParse(std::ofstream &out, const char *name, const wchar_t *configName, int runs) {
+    if (GetFileAttributesW(PathCombine(GConfig.Directory, configName)) == INVALID_FILE_ATTRIBUTES) {
+        LOG << "Benchmark " << name << " skipped - no " << configName << END;
+        return;
+    }
+
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        ConfigCustom custom;
+        custom.NoLoad = true; // (plugins are loaded once at most, so loading them isn't part of parsing)
+
+        ConfigResident result;
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        ConfigCompileFile(configName, &result, custom, false, false);
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    ImplBenchWriteResult(out, name, samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+}
+
+// parsing a 50k-line synthetic config - its throughput in lines, and (in debug builds) the heap allocations made per line
+static void ImplBenchConfigParseThroughput(std::ofstream &out, int runs) {
+    const wchar_t *name = L"_bench_50k.ini";
+    constexpr int numLines = 50000;
+    ImplBenchWriteLargeConfig(name, numLines);
+
+#ifdef _DEBUG
+    GImplBenchAllocCount = 0;
+    GImplBenchAllocThread = GetCurrentThreadId();
+    _CRT_ALLOC_HOOK prevHook = _CrtSetAllocHook(ImplBenchAllocHook);
+#endif
+
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        ConfigCustom custom;
+        custom.NoLoad = true;
+
+        ConfigResident result;
+        ConfigCompileFile(name, &result, custom, false, false);
+    }
+
+    double seconds = (double)(GHrClock.RealNowNs() - startNs) / 1e9;
+#ifdef _DEBUG
+    _CrtSetAllocHook(prevHook);
+#endif
+
+    double lines = (double)numLines * runs;
+    out << "{\"name\": \"config_parse_50k\", \"lines\": " << numLines << ", \"runs\": " << runs
+        << ", \"lines_per_sec\": " << (seconds > 0 ? lines / seconds : 0);
+    LOG << "Benchmark config_parse_50k: " << (seconds > 0 ? lines / seconds : 0) << " lines/sec" << END;
+
+    // (allocations are counted only by debug builds - whose lines/sec isn't representative)
+#ifdef _DEBUG
+    out << ", \"allocs_per_line\": " << GImplBenchAllocCount / lines;
+    LOG << "Benchmark config_parse_50k: " << GImplBenchAllocCount / lines << " allocs/line" << END;
+#endif
+    out << "}\n";
+    ImplBenchDeleteConfig(name);
+}
+
+// loading one of the synthetic configs
+static void ImplBenchConfigLoad(std::ofstream &out, const char *name, const wchar_t *configName, bool useCache, bool full, int runs) {
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(configName));
+    GConfig.UseCache = useCache;
+    ConfigReloadFull(); // (e.g. writes the cache)
+
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        if (full) {
+            ConfigReloadFull();
+        } else {
+            ConfigReload();
+        }
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    GConfig.UseCache = true;
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchWriteResult(out, name, samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+}
+
+// reloading the large synthetic config after each edit of one of its lines, which applies it incrementally - fails otherwise
+// (the config is compiled from text, as a quick edit may not change the file's size or write time)
+// (the edited line maps to outputs the rest of the config doesn't, so they don't run out of slots)
+static bool ImplBenchConfigReloadEdited(std::ofstream &out, int runs) {
+    const wchar_t *name = L"_bench_edited.ini";
+    ImplBenchWriteLargeConfig(name, ImplBenchLargeLines, "F12 : F20\n");
+
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(name));
+    GConfig.UseCache = false;
+
+    int numFullApplies = GConfig.NumFullApplies;
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        ImplBenchWriteLargeConfig(name, ImplBenchLargeLines, i % 2 ? "F12 : F20\n" : "F12 : F21\n");
+
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        ConfigReload();
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    GConfig.UseCache = true;
+    bool incremental = GConfig.NumFullApplies == numFullApplies;
+    if (incremental) {
+        ImplBenchWriteResult(out, "config_reload_edited", samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+    } else {
+        LOG_W << "ERROR: Benchmark config_reload_edited: " << GConfig.NumFullApplies - numFullApplies << " reloads were full" << END;
+    }
+
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchDeleteConfig(name);
+    return incremental;
+}
+
+// switching back & forth between two synthetic configs that switch to each other (the second being the first half of the first)
+// (each switch should apply the other config incrementally - fails otherwise)
+static bool ImplBenchConfigSwitch(std::ofstream &out, int runs) {
+    const wchar_t *firstName = L"_bench_switch_a.ini";
+    const wchar_t *secondName = L"_bench_switch_b.ini";
+    ImplBenchWriteMappingsConfig(firstName, 2000, "F12 : LoadConfig = _bench_switch_b\n");
+    ImplBenchWriteMappingsConfig(secondName, 1000, "F12 : LoadConfig = _bench_switch_a\n");
+
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(secondName));
+    ConfigPrecompileTargets(true);
+    ConfigSwitch(Path(firstName));
+    ConfigPrecompileTargets(true); // (both configs are resident from here on)
+
+    int numFullApplies = GConfig.NumFullApplies;
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs * 2; i++) {
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        ConfigSwitch(Path(i % 2 ? firstName : secondName));
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    bool incremental = GConfig.NumFullApplies == numFullApplies;
+    if (incremental) {
+        ImplBenchWriteResult(out, "config_switch", samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+    } else {
+        LOG_W << "ERROR: Benchmark config_switch: " << GConfig.NumFullApplies - numFullApplies << " switches were full reloads" << END;
+    }
+
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchDeleteConfig(firstName);
+    ImplBenchDeleteConfig(secondName);
+    return incremental;
+}
+
+// the letters mapped to pad buttons & stick directions
+constexpr const char *ImplBenchPadConfig = R"(A : %A
+B : %B
+C : %X
+D : %Y
+E : %LB
+F : %RB
+G : %LT
+H : %RT
+I : %L.Left
+J : %L.Right
+K : %L.Up
+L : %L.Down
+M : %R.Left
+N : %R.Right
+O : %R.Up
+P : %R.Down
+Q : %D.Left
+R : %D.Right
+S : %D.Up
+T : %D.Down
+U : %L.Up ~ 0.5
+V : %R.Right ~ 0.5
+W : %Mod.LY ~ 0.5
+X : %Mod.RX ~ 0.5
+Y : %Start
+Z : %Back
+)";
+
+// the letters mapped to stick directions & to rotators of the sticks
+constexpr const char *ImplBenchRotatorConfig = R"(A : %L.Up
+B : %L.Right
+C : %R.Down
+D : %R.Left
+E : %Rot.L.Up ~ 0.02
+F : %Rot.L.Down ~ 0.02
+G : %Rot.L.Left ~ 0.02
+H : %Rot.L.Right ~ 0.02
+I : %Rot.L.UpLeft ~ 0.02
+J : %Rot.L.DownRight ~ 0.02
+K : %Rot.R.Up ~ 0.02
+L : %Rot.R.Down ~ 0.02
+M : %Rot.R.Left ~ 0.02
+N : %Rot.R.Right ~ 0.02
+O : %Rot.R.UpRight ~ 0.02
+P : %Rot.R.DownLeft ~ 0.02
+Q : %Rot.Mod.L ~ 0.5
+R : %Rot.Mod.R ~ 0.5
+)";
+
+// the mouse mapped to the right stick
+constexpr const char *ImplBenchMouseStickConfig = R"(Mouse.Up : %R.Up ~0.05 !Add !Reset
+Mouse.Down : %R.Down ~0.05 !Add !Reset
+Mouse.Left : %R.Left ~0.05 !Add !Reset
+Mouse.Right : %R.Right ~0.05 !Add !Reset
+)";
+
+// the mouse mapped to motion & rotation of the pad
+constexpr const char *ImplBenchMotionConfig = R"(Mouse.Up : %Motion.Up ~0.01 !Add
+Mouse.Down : %Motion.Down ~0.01 !Add
+Mouse.Left : %Motion.Rot.CCW ~0.01 !Add
+Mouse.Right : %Motion.Rot.CW ~0.01 !Add
+)";
+
+// per-event cost of the shipped default config (whose letter keys are mapped to pad buttons, triggers & modifiers)
+// - i.e. of dispatching each event to the actions resolved for it at load
+static void ImplBenchDefaultConfig(std::ofstream &out) {
+    if (GetFileAttributesW(PathCombine(GConfig.Directory, ConfigDefault)) == INVALID_FILE_ATTRIBUTES) {
+        LOG << "Benchmark keyboard_default skipped - no " << ConfigDefault << END;
+        return;
+    }
+
+    ImplBenchEventsOn(out, "keyboard_default", ConfigDefault, ImplBenchKeyboardEvents(100000, HrTimePerSec / 100));
+}
+
+// per-event cost with 2,000 conditional mappings loaded - ~40 on each pressed key, walked (with their conditions) from the config's arena
+static void ImplBenchManyMappings(std::ofstream &out) {
+    const wchar_t *name = L"_bench_mappings.ini";
+    ImplBenchWriteMappingsConfig(name, 2000);
+    ImplBenchEventsOn(out, "keyboard_2k_mappings", name, ImplBenchKeyboardEvents(100000, HrTimePerSec / 100));
+    ImplBenchDeleteConfig(name);
+}
+
+// per-event costs of mapping to the pad, on small fixed configs
+static void ImplBenchPad(std::ofstream &out) {
+    static const tuple<const wchar_t *, const char *> configs[] = {
+        {L"_bench_pad.ini", ImplBenchPadConfig},
+        {L"_bench_rotator.ini", ImplBenchRotatorConfig},
+        {L"_bench_mouse_stick.ini", ImplBenchMouseStickConfig},
+        {L"_bench_motion.ini", ImplBenchMotionConfig},
+    };
+
+    for (auto &[name, text] : configs) {
+        ImplBenchWriteConfig(name, text);
+    }
+
+    auto keyEvents = ImplBenchKeyboardEvents(100000, HrTimePerSec / 100);
+    ImplBenchEventsOn(out, "keyboard_pad", L"_bench_pad.ini", keyEvents);
+    ImplBenchEventsOn(out, "keyboard_rotator", L"_bench_rotator.ini", keyEvents);
+    ImplBenchEventsOn(out, "mouse_stick_1khz", L"_bench_mouse_stick.ini", ImplBenchMouseEvents(1000, 10));
+    ImplBenchEventsOn(out, "mouse_stick_4khz", L"_bench_mouse_stick.ini", ImplBenchMouseEvents(4000, 10));
+    ImplBenchEventsOn(out, "mouse_stick_8khz", L"_bench_mouse_stick.ini", ImplBenchMouseEvents(8000, 10));
+    ImplBenchEventsOn(out, "mouse_motion_1khz", L"_bench_motion.ini", ImplBenchMouseEvents(1000, 10));
+
+    for (auto &[name, text] : configs) {
+        ImplBenchDeleteConfig(name);
+    }
+}
+
+// the cost of a log call to the caller (the writing itself is done in the background)
+static void ImplBenchLog(std::ofstream &out, int runs) {
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        LOG << "Benchmark log record " << i << END;
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    ImplBenchWriteResult(out, "log_call", samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+}
+
+// the cost of a trace log call, with tracing disabled & enabled
+static void ImplBenchLogTrace(std::ofstream &out, const char *name, bool enabled, int runs) {
+    uint32_t prevMask = GLogMask.get();
+    GLogMask.set(enabled ? LogMask_Trace : 0);
+
+    vector<uint32_t> samples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        LOG_TRACE << "Benchmark trace record " << i << ", " << i * 0.5 << END;
+        samples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    GLogMask.set(prevMask);
+    ImplBenchWriteResult(out, name, samples, (double)(GHrClock.RealNowNs() - startNs) / 1e9);
+}
+
+constexpr int ImplBenchNumLayers = 10;
+
+// the letters mapped differently in each of several layers, each activated while an F key is held -
+// either as actual layers, or emulated via conditions (as configs did before layers)
+static void ImplBenchWriteLayersConfig(const wchar_t *name, bool asConds) {
+    std::ofstream out(PathCombine(GConfig.Directory, name));
+    for (int layer = 1; layer <= ImplBenchNumLayers; layer++) {
+        if (asConds) {
+            out << "F" << layer << " : None\n";
+        } else {
+            out << "F" << layer << " : HoldLayer = bench" << layer << "\n[ !Layer bench" << layer << "\n";
+        }
+
+        for (char ch = 'A'; ch <= 'Z'; ch++) {
+            out << ch << " : " << (char)('A' + (ch - 'A' + layer) % 26);
+            if (asConds) {
+                out << " ?F" << layer;
+            }
+            out << "\n";
+        }
+
+        if (!asConds) {
+            out << "]\n";
+        }
+    }
+
+    for (char ch = 'A'; ch <= 'Z'; ch++) {
+        out << ch << " : " << ch;
+        for (int layer = 1; asConds && layer <= ImplBenchNumLayers; layer++) {
+            out << " ?~F" << layer;
+        }
+        out << "\n";
+    }
+}
+
+// letter presses & releases, with a different layer key (or none) held around every few of them
+static vector<ImplTraceEvent> ImplBenchLayerEvents(int count, hrtime_t interval) {
+    vector<ImplTraceEvent> events;
+    auto add = [&](int key, bool down) {
+        events.push_back({(hrtime_t)events.size() * interval, ImplTraceType::Keyboard, (uint8_t)(down ? ImplTraceFlag_Down : 0), (uint16_t)key});
+    };
+
+    for (int i = 0; (int)events.size() < count; i++) {
+        int layer = i % (ImplBenchNumLayers + 1);
+        if (layer) {
+            add(VK_F1 + layer - 1, true);
+        }
+        for (int j = 0; j < 3; j++) {
+            add('A' + (i * 3 + j) % 26, true);
+            add('A' + (i * 3 + j) % 26, false);
+        }
+        if (layer) {
+            add(VK_F1 + layer - 1, false);
+        }
+    }
+    return events;
+}
+
+static void ImplBenchLayers(std::ofstream &out) {
+    const wchar_t *layersName = L"_bench_layers.ini";
+    const wchar_t *condsName = L"_bench_conds.ini";
+    ImplBenchWriteLayersConfig(layersName, false);
+    ImplBenchWriteLayersConfig(condsName, true);
+
+    wstring original = GConfig.MainFile.Get();
+    auto events = ImplBenchLayerEvents(100000, HrTimePerSec / 100);
+
+    ConfigSwitch(Path(layersName));
+    ImplBenchEvents(out, "keyboard_layers", events);
+    ConfigSwitch(Path(condsName));
+    ImplBenchEvents(out, "keyboard_layers_as_conds", events);
+    ConfigSwitch(Path(original.c_str()));
+
+    ImplBenchDeleteConfig(layersName);
+    ImplBenchDeleteConfig(condsName);
+}
+
+static const tuple<int, const char *> ImplBenchModifiers[] = {{VK_LSHIFT, "LShift"}, {VK_LCONTROL, "LControl"}, {VK_LMENU, "LAlt"}, {VK_RSHIFT, "RShift"}};
+constexpr int ImplBenchNumModifiers = (int)size(ImplBenchModifiers);
+
+// each letter mapped several times, conditioned on combinations of modifiers (as in shift-style configs)
+static void ImplBenchWriteModifiersConfig(const wchar_t *name) {
+    auto modifier = [](int idx) { return std::get<1>(ImplBenchModifiers[idx % ImplBenchNumModifiers]); };
+
+    std::ofstream out(PathCombine(GConfig.Directory, name));
+    for (char ch = 'A'; ch <= 'Z'; ch++) {
+        for (int i = 0; i < ImplBenchNumModifiers; i++) {
+            out << ch << " : " << ImplBenchKeyName(ch - 'A' + i + 1) << " ?" << modifier(i) << " ?~" << modifier(i + 1)
+                << " ?(" << modifier(i + 2) << " | ~" << modifier(i + 3) << ")\n";
+        }
+    }
+}
+
+// letter keys held while modifiers are pressed & released, so that each modifier edge may reset the held mappings
+static vector<ImplTraceEvent> ImplBenchModifierEvents(int count, hrtime_t interval) {
+    vector<ImplTraceEvent> events;
+    auto add = [&](int key, bool down) {
+        events.push_back({(hrtime_t)events.size() * interval, ImplTraceType::Keyboard, (uint8_t)(down ? ImplTraceFlag_Down : 0), (uint16_t)key});
+    };
+
+    for (int i = 0; (int)events.size() < count; i++) {
+        add('A' + i % 26, true);
+        for (int j = 0; j < ImplBenchNumModifiers; j++) {
+            int vk = std::get<0>(ImplBenchModifiers[(i + j) % ImplBenchNumModifiers]);
+            add(vk, true);
+            add(vk, false);
+        }
+        add('A' + i % 26, false);
+    }
+    return events;
+}
+
+// the cost of modifier edges on a condition-heavy config, and how many mappings each edge re-checks
+// (only the mappings whose conditions the edge can break - see ConfigAddResetDeps)
+static void ImplBenchModifierResets(std::ofstream &out) {
+    const wchar_t *name = L"_bench_modifiers.ini";
+    ImplBenchWriteModifiersConfig(name);
+
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(name));
+
+    uint32_t numResets = 0;
+    for (auto &[vk, modName] : ImplBenchModifiers) {
+        ImplInput *input = G.Keyboard.Get(vk);
+        numResets += input->PressResets.Count + input->ReleaseResets.Count;
+    }
+    double resetsPerEdge = numResets / (2.0 * ImplBenchNumModifiers);
+    out << "{\"name\": \"keyboard_modifier_reset_fanout\", \"mappings\": " << G.Arena.Mappings.size()
+        << ", \"resets_per_edge\": " << resetsPerEdge << "}\n";
+    LOG << "Benchmark keyboard_modifier_reset_fanout: " << resetsPerEdge << " resets per modifier edge" << END;
+
+    ImplBenchEvents(out, "keyboard_modifier_resets", ImplBenchModifierEvents(100000, HrTimePerSec / 100));
+
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchDeleteConfig(name);
+}
+
+static vector<INPUT> GImplBenchSinkInputs;
+static int GImplBenchSinkCalls = 0;
+
+static void ImplBenchInputSink(const INPUT *inputs, UINT count) {
+    GImplBenchSinkCalls++;
+    GImplBenchSinkInputs.insert(GImplBenchSinkInputs.end(), inputs, inputs + count);
+}
+
+static bool ImplBenchSameInputs(const vector<INPUT> &left, const vector<INPUT> &right) {
+    return std::ranges::equal(left, right, [](const INPUT &l, const INPUT &r) {
+        if (l.type != r.type) {
+            return false;
+        } else if (l.type == INPUT_KEYBOARD) {
+            return l.ki.wVk == r.ki.wVk && l.ki.dwFlags == r.ki.dwFlags;
+        } else {
+            return l.mi.dwFlags == r.mi.dwFlags && l.mi.mouseData == r.mi.mouseData && l.mi.dx == r.mi.dx && l.mi.dy == r.mi.dy;
+        }
+    });
+}
+
+// each letter mapped to a chord of several keys, whose inputs are sent to a fake sink - unbatched, batched,
+// and batched with a limit below the chord's size - checking all send the same inputs, in the same order
+static void ImplBenchInputBatching(std::ofstream &out) {
+    const wchar_t *chordsName = L"_bench_chords.ini";
+    {
+        std::ofstream cfg(PathCombine(GConfig.Directory, chordsName));
+        for (char ch = 'A'; ch <= 'Z'; ch++) {
+            cfg << ch << " : LCtrl\n" << ch << " : LShift\n" << ch << " : " << (char)('A' + (ch - 'A' + 1) % 26) << "\n";
+        }
+    }
+
+    wstring original = GConfig.MainFile.Get();
+    auto events = ImplBenchKeyboardEvents(100000, HrTimePerSec / 100);
+    ConfigSwitch(Path(chordsName));
+
+    static const tuple<const char *, UINT> runs[] = {
+        {"send_input_unbatched", 1},
+        {"send_input_batched", ImplInputBatch::MaxInputs},
+        {"send_input_batched_split", 2},
+    };
+
+    vector<INPUT> expected;
+    GImplInputSink = ImplBenchInputSink;
+    for (auto &[name, limit] : runs) {
+        GImplInputBatchLimit = limit;
+        GImplBenchSinkInputs.clear();
+        GImplBenchSinkCalls = 0;
+        ImplBenchEvents(out, name, events);
+
+        if (expected.empty()) {
+            expected = GImplBenchSinkInputs;
+        }
+
+        bool ordered = ImplBenchSameInputs(GImplBenchSinkInputs, expected);
+        if (!ordered) {
+            LOG_W << "ERROR: Benchmark " << name << " sent different inputs than unbatched" << END;
+        }
+
+        out << "{\"name\": \"" << name << "_calls\", \"events\": " << events.size()
+            << ", \"inputs\": " << GImplBenchSinkInputs.size() << ", \"calls\": " << GImplBenchSinkCalls
+            << ", \"calls_per_event\": " << (double)GImplBenchSinkCalls / events.size()
+            << ", \"ordered\": " << (ordered ? "true" : "false") << "}\n";
+    }
+
+    GImplInputSink = nullptr;
+    GImplInputBatchLimit = ImplInputBatch::MaxInputs;
+    GImplBenchSinkInputs = {};
+
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchDeleteConfig(chordsName);
+}
+
+// the timer wheel alone, driven by a fake clock (per arm & cancel, and per timer fired)
+static void ImplBenchTimerWheel(std::ofstream &out) {
+    uint64_t startNs = GHrClock.RealNowNs();
+    auto result = TimerWheelBench(10000, 100);
+    double seconds = (double)(GHrClock.RealNowNs() - startNs) / 1e9;
+
+    ImplBenchWriteResult(out, "timer_wheel_arm_cancel", result.ArmCancelNs, seconds);
+    ImplBenchWriteResult(out, "timer_wheel_fire", result.FireNs, seconds);
+}
+
+// publishing the pad state 'runs' times while 'numReaders' threads poll it (as games calling XInputGetState in a loop do)
+// - timing both Publish & Read, as each can be slowed by the other (readers retry reads that raced a publish)
+static void ImplBenchSeqLock(std::ofstream &out, int numReaders, int runs) {
+    auto &state = G.Users[0].State;
+    std::atomic<bool> done = false;
+    std::atomic<int> numStarted = 0;
+
+    vector<vector<uint32_t>> readSamples(numReaders);
+    vector<std::thread> readers;
+    for (int i = 0; i < numReaders; i++) {
+        readers.emplace_back([&, i] {
+            numStarted++;
+            while (!done.load()) {
+                uint64_t readStartNs = GHrClock.RealNowNs();
+                state.Snapshot.Read();
+                readSamples[i].push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - readStartNs, UINT32_MAX));
+            }
+        });
+    }
+
+    while (numStarted < numReaders) {
+        std::this_thread::yield();
+    }
+
+    vector<uint32_t> publishSamples;
+    uint64_t startNs = GHrClock.RealNowNs();
+    for (int i = 0; i < runs; i++) {
+        uint64_t runStartNs = GHrClock.RealNowNs();
+        state.Publish();
+        publishSamples.push_back((uint32_t)min<uint64_t>(GHrClock.RealNowNs() - runStartNs, UINT32_MAX));
+    }
+
+    double seconds = (double)(GHrClock.RealNowNs() - startNs) / 1e9;
+    done = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    string suffix = numReaders ? "_" + std::to_string(numReaders) + "_readers" : "_uncontended";
+    ImplBenchWriteResult(out, ("seqlock_publish" + suffix).c_str(), publishSamples, seconds);
+
+    if (numReaders) {
+        vector<uint32_t> allReadSamples;
+        for (auto &samples : readSamples) {
+            allReadSamples.insert(allReadSamples.end(), samples.begin(), samples.end());
+        }
+        ImplBenchWriteResult(out, ("seqlock_read" + suffix).c_str(), allReadSamples, seconds);
+    }
+}
+
+static bool ImplBenchmark(const wchar_t *resultPath) {
+    DBG_ASSERT_DLL_THREAD();
+
+    std::ofstream out(resultPath);
+    if (out.fail()) {
+        LOG_W << "ERROR: Failed to open benchmark results for writing: " << resultPath << END;
+        return false;
+    }
+
+    bool ok = true;
+    ImplBenchWriteLargeConfig(ImplBenchLargeName, ImplBenchLargeLines);
+    ImplBenchConfigParse(out, "config_parse_default", ConfigDefault, 100);
+    ImplBenchConfigParse(out, "config_parse_test", L"myinput_test.ini", 100);
+    ImplBenchConfigParse(out, "config_parse_large", ImplBenchLargeName, 20);
+    ImplBenchConfigParseThroughput(out, 5);
+    ImplBenchConfigLoad(out, "config_load_text", ImplBenchLargeName, false, true, 20);
+    ImplBenchConfigLoad(out, "config_load_cached", ImplBenchLargeName, true, true, 20);
+    ImplBenchConfigLoad(out, "config_reload_unchanged", ImplBenchLargeName, true, false, 20);
+    ImplBenchDeleteConfig(ImplBenchLargeName);
+
+    vector<wstring> treeNames = ImplBenchWriteIncludeTree();
+    ImplBenchConfigLoad(out, "config_load_tree", ImplBenchTreeName, false, true, 20);
+    GConfig.ReadAhead = false;
+    ImplBenchConfigLoad(out, "config_load_tree_serial", ImplBenchTreeName, false, true, 20);
+    GConfig.ReadAhead = true;
+    for (auto &treeName : treeNames) {
+        ImplBenchDeleteConfig(treeName.c_str());
+    }
+    ok = ImplBenchConfigReloadEdited(out, 20) && ok;
+    ok = ImplBenchConfigSwitch(out, 20) && ok;
+    ImplBenchDefaultConfig(out);
+    ImplBenchManyMappings(out);
+    ImplBenchPad(out);
+    ImplBenchTimerWheel(out);
+    ImplBenchSeqLock(out, 0, 100000);
+    ImplBenchSeqLock(out, 1, 100000);
+    ImplBenchSeqLock(out, 3, 100000);
+    ImplBenchLayers(out);
+    ImplBenchModifierResets(out);
+    ImplBenchInputBatching(out);
+    ImplBenchLog(out, 1000);
+    ImplBenchLogTrace(out, "log_trace_disabled", false, 100000);
+    ImplBenchLogTrace(out, "log_trace_enabled", true, 1000);
+    return ok;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "State.h"
+#include "ImplTrace.h"
 
 static int ImplUnextend(int virtKeyCode, bool extended) {
     switch (virtKeyCode) {
@@ -171,28 +172,87 @@ static int ImplKeyboardRepeatTime() {
     return 400 - speed * 12;
 }
 
-static BufferListOfSize<sizeof(INPUT)> GImplInputBuffers;
+// Inputs generated while a ChangedMask is alive (e.g. by a chord mapping) are sent by a single SendInput once the
+// outermost one ends - so they take one syscall, and real input can't get between them. (dll thread only)
+struct ImplInputBatch {
+    static constexpr UINT MaxInputs = 32; // (larger batches are sent in several parts, in order)
+
+    UINT Count;
+    INPUT Inputs[MaxInputs];
+};
+
+static BufferListOfSize<sizeof(ImplInputBatch)> GImplInputBatches;
 static ReusableThread GImplInputThread{InputThreadPriority}; // separate from dll thread to avoid recursive hook calls
+static ImplInputBatch *GImplInputBatch = nullptr;            // (the one being filled, if any)
+static int GImplInputBatchDepth = 0;                         // (of nested ChangedMasks)
+static UINT GImplInputBatchLimit = ImplInputBatch::MaxInputs;
+static void (*GImplInputSink)(const INPUT *inputs, UINT count) = nullptr; // (if set - receives the batches instead, for benchmarks)
 
 static DWORD WINAPI ImplSendInputDelayed(void *param) {
-    SendInput_Real(1, (INPUT *)param, sizeof(INPUT));
-    GImplInputBuffers.Get()->PutBack(param);
+    ImplInputBatch *batch = (ImplInputBatch *)param;
+    SendInput_Real(batch->Count, batch->Inputs, sizeof(INPUT));
+    GImplInputBatches.Get()->PutBack(batch);
     return 0;
 }
 
-static void ImplGenerateMouseEventCommon(int flag, DWORD time, int data = 0) {
-    INPUT *input = (INPUT *)GImplInputBuffers.Get()->Take();
-    input->type = INPUT_MOUSE;
-    input->mi = {};
-    input->mi.dwFlags = flag;
-    input->mi.mouseData = data;
-    input->mi.time = time;
-    input->mi.dwExtraInfo = ExtraInfoOurInject;
+static void ImplFlushInputs() {
+    ImplInputBatch *batch = GImplInputBatch;
+    if (!batch) {
+        return;
+    }
+
+    GImplInputBatch = nullptr;
+    if (GImplInputSink) {
+        GImplInputSink(batch->Inputs, batch->Count);
+        GImplInputBatches.Get()->PutBack(batch);
+    } else if (GImplTrace.IsReplaying()) {
+        for (UINT i = 0; i < batch->Count; i++) {
+            GImplTrace.ReplayOutput(batch->Inputs[i]);
+        }
+        GImplInputBatches.Get()->PutBack(batch);
+    } else {
+        GImplInputThread.CreateThread(ImplSendInputDelayed, batch);
+    }
+}
+
+static void ImplSendInput(const INPUT &input) {
+    if (GImplInputBatch && GImplInputBatch->Count >= GImplInputBatchLimit) {
+        ImplFlushInputs();
+    }
+
+    if (!GImplInputBatch) {
+        GImplInputBatch = (ImplInputBatch *)GImplInputBatches.Get()->Take();
+        GImplInputBatch->Count = 0;
+    }
+    GImplInputBatch->Inputs[GImplInputBatch->Count++] = input;
+
+    if (!GImplInputBatchDepth) {
+        ImplFlushInputs();
+    }
+}
+
+static void ImplBeginInputBatch() {
+    GImplInputBatchDepth++;
+}
+
+static void ImplEndInputBatch() {
+    if (--GImplInputBatchDepth == 0) {
+        ImplFlushInputs();
+    }
+}
+
+static void ImplGenerateMouseEventCommon(int flag, hrtime_t time, int data = 0) {
+    INPUT input = {};
+    input.type = INPUT_MOUSE;
+    input.mi.dwFlags = flag;
+    input.mi.mouseData = data;
+    input.mi.time = GHrClock.ToTicks(time);
+    input.mi.dwExtraInfo = ExtraInfoOurInject;
 
-    GImplInputThread.CreateThread(ImplSendInputDelayed, input);
+    ImplSendInput(input);
 }
 
-static void ImplGenerateKey(int key, bool down, DWORD time) {
+static void ImplGenerateKey(int key, bool down, hrtime_t time) {
     switch (key) {
     case VK_LBUTTON:
         return ImplGenerateMouseEventCommon(down ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP, time);
@@ -210,35 +270,34 @@ static void ImplGenerateKey(int key, bool down, DWORD time) {
     key = ImplReextend(key, &extended);
     int scan = MapVirtualKeyW(key, MAPVK_VK_TO_VSC);
 
-    INPUT *input = (INPUT *)GImplInputBuffers.Get()->Take();
-    input->type = INPUT_KEYBOARD;
-    input->ki = {};
-    input->ki.wVk = key;
-    input->ki.wScan = scan;
+    INPUT input = {};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = key;
+    input.ki.wScan = scan;
     if (!down) {
-        input->ki.dwFlags |= KEYEVENTF_KEYUP;
+        input.ki.dwFlags |= KEYEVENTF_KEYUP;
     }
     if (extended) {
-        input->ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+        input.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
     }
-    input->ki.time = time;
-    input->ki.dwExtraInfo = ExtraInfoOurInject;
+    input.ki.time = GHrClock.ToTicks(time);
+    input.ki.dwExtraInfo = ExtraInfoOurInject;
 
-    GImplInputThread.CreateThread(ImplSendInputDelayed, input);
+    ImplSendInput(input);
 }
 
-static void ImplHandleKeyChange(int key, bool down, DWORD time, slot_t slot) {
+static void ImplHandleKeyChange(int key, bool down, hrtime_t time, slot_t slot) {
     auto &output = G.Keyboard.Keys[key].Output;
     ImplProcessBoolOutput(output, down, slot);
     ImplGenerateKey(key, output.Get(), time);
 }
 
-static void ImplGenerateMouseWheel(int flag, double strength, DWORD time) {
+static void ImplGenerateMouseWheel(int flag, double strength, hrtime_t time) {
     int data = (int)strength * WHEEL_DELTA;
     ImplGenerateMouseEventCommon(flag, time, data);
 }
 
-static void ImplGenerateMouseMotion(double dx, double dy, DWORD time, ChangedMask *changes) {
+static void ImplGenerateMouseMotion(double dx, double dy, hrtime_t time, ChangedMask *changes) {
     G.Mouse.MotionTotal.X += dx;
     G.Mouse.MotionTotal.Y += dy;
     G.Mouse.MotionTotal.Time = time;
@@ -248,16 +307,15 @@ static void ImplGenerateMouseMotion(double dx, double dy, DWORD time, ChangedMas
 static int RoundAway(double value) { return value > 0 ? (int)ceil(value) : (int)floor(value); }
 
 static void ImplGenerateMouseMotionFinish() {
-    INPUT *input = (INPUT *)GImplInputBuffers.Get()->Take();
-    input->type = INPUT_MOUSE;
-    input->mi = {};
-    input->mi.dwFlags = MOUSEEVENTF_MOVE;
-    input->mi.dx = RoundAway(G.Mouse.MotionTotal.X);
-    input->mi.dy = RoundAway(G.Mouse.MotionTotal.Y);
-    input->mi.time = G.Mouse.MotionTotal.Time;
-    input->mi.dwExtraInfo = ExtraInfoOurInject;
+    INPUT input = {};
+    input.type = INPUT_MOUSE;
+    input.mi.dwFlags = MOUSEEVENTF_MOVE;
+    input.mi.dx = RoundAway(G.Mouse.MotionTotal.X);
+    input.mi.dy = RoundAway(G.Mouse.MotionTotal.Y);
+    input.mi.time = GHrClock.ToTicks(G.Mouse.MotionTotal.Time);
+    input.mi.dwExtraInfo = ExtraInfoOurInject;
 
-    GImplInputThread.CreateThread(ImplSendInputDelayed, input);
+    ImplSendInput(input);
 
     G.Mouse.MotionTotal = {};
 }
@@ -266,6 +324,7 @@ static void ImplUpdateAsyncState() {
     for (int i = 0; i < ImplKeyboard::Count; i++) {
         G.Keyboard.Keys[i].AsyncDown = GetAsyncKeyState_Real(i) < 0;
         // AsyncToggle?
+        G.Keyboard.UpdateAsync(&G.Keyboard.Keys[i]);
     }
 }
 
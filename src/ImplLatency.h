@@ -0,0 +1,138 @@
+#pragma once
+#include "StateUtils.h"
+#include "Header.h"
+#include "ImplTrace.h"
+
+// Latencies of the stages of delivering the gamepad state changed by an input to the app (see MyInputHook_StatsType),
+// measured from the hook receiving the input, and kept per user - cheap enough to always measure
+
+// A histogram of latencies (in microseconds), HDR-style - linear sub-buckets within power-of-2 buckets,
+// giving ~3% precision up to ~1 minute. May be added to from any thread
+class ImplLatencyHistogram {
+    static constexpr int SubBits = 5;
+    static constexpr int MaxBits = 26; // (larger values are clamped)
+    static constexpr int NumBuckets = (MaxBits - SubBits + 1) << SubBits;
+
+    atomic<uint32_t> mCounts[NumBuckets] = {};
+    atomic<uint64_t> mCount = 0;
+    atomic<uint64_t> mSum = 0;
+    atomic<uint64_t> mMax = 0;
+
+    static int Index(uint64_t value) {
+        int bits = std::bit_width(value);
+        if (bits <= SubBits + 1) {
+            return (int)value;
+        }
+
+        int shift = bits - SubBits - 1;
+        return ((shift + 1) << SubBits) + (int)(value >> shift) - (1 << SubBits);
+    }
+
+    // (the middle of the bucket)
+    static double Value(int index) {
+        if (index < (2 << SubBits)) {
+            return index;
+        }
+
+        int shift = (index >> SubBits) - 1;
+        uint64_t low = (uint64_t)((index & ((1 << SubBits) - 1)) + (1 << SubBits)) << shift;
+        return low + ((1ull << shift) - 1) / 2.0;
+    }
+
+public:
+    void Add(uint64_t value) {
+        value = min<uint64_t>(value, (1ull << MaxBits) - 1);
+        mCounts[Index(value)].fetch_add(1, std::memory_order_relaxed);
+        mCount.fetch_add(1, std::memory_order_relaxed);
+        mSum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t max = mMax.load(std::memory_order_relaxed);
+        while (value > max && !mMax.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    void Reset() {
+        for (auto &count : mCounts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        mCount = mSum = mMax = 0;
+    }
+
+    void Get(MyInputHook_Stats *stats) {
+        uint32_t counts[NumBuckets];
+        uint64_t total = 0;
+        for (int i = 0; i < NumBuckets; i++) {
+            counts[i] = mCounts[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        auto percentile = [&](double fraction) {
+            uint64_t target = (uint64_t)ceil(fraction * total);
+            uint64_t seen = 0;
+            for (int i = 0; i < NumBuckets; i++) {
+                seen += counts[i];
+                if (seen >= max<uint64_t>(target, 1)) {
+                    return Value(i);
+                }
+            }
+            return 0.0;
+        };
+
+        stats->Count = total;
+        stats->MeanUs = total ? (double)mSum.load(std::memory_order_relaxed) / mCount.load(std::memory_order_relaxed) : 0;
+        stats->P50Us = percentile(0.5);
+        stats->P90Us = percentile(0.9);
+        stats->P99Us = percentile(0.99);
+        stats->P999Us = percentile(0.999);
+        stats->MaxUs = total ? (double)mMax.load(std::memory_order_relaxed) : 0;
+    }
+};
+
+constexpr int ImplLatencyNumTypes = MyInputHook_Stats_RawInput;
+
+class ImplLatency {
+    ImplLatencyHistogram mStages[ImplLatencyNumTypes];
+    atomic<int> mLastVersions[ImplLatencyNumTypes] = {}; // (each state is measured once per stage - when first delivered)
+
+    void Add(int type, hrtime_t inputTime) {
+        hrtime_t now = GHrClock.Now();
+        mStages[type - 1].Add(now > inputTime ? now - inputTime : 0);
+    }
+
+public:
+    // (called from the dll thread, with the time of the input that changed the state)
+    void OnMapped(hrtime_t inputTime) {
+        if (!GImplTrace.IsReplaying()) {
+            Add(MyInputHook_Stats_Mapping, inputTime);
+        }
+    }
+
+    // (called from the dll thread, before the state is published)
+    void OnFlush(hrtime_t inputTime) {
+        if (!GImplTrace.IsReplaying()) {
+            Add(MyInputHook_Stats_Flush, inputTime);
+        }
+    }
+
+    // May be called from any thread, once the published state identified by 'stamp' (as read from its snapshot)
+    // reached the stage 'type'
+    void OnDelivered(int type, const ImplStateStamp &stamp) {
+        if (stamp.Time && mLastVersions[type - 1].exchange(stamp.Version, std::memory_order_relaxed) != stamp.Version) {
+            Add(type, stamp.Time);
+        }
+    }
+
+    void Get(int type, MyInputHook_Stats *stats) {
+        if (type >= 1 && type <= ImplLatencyNumTypes) {
+            mStages[type - 1].Get(stats);
+        } else {
+            *stats = {};
+        }
+    }
+
+    void Reset() {
+        for (auto &stage : mStages) {
+            stage.Reset();
+        }
+    }
+} GImplLatency[IMPL_MAX_USERS];
@@ -2,9 +2,13 @@
 #include "StateUtils.h"
 #include "Header.h"
 #include "ImplFeedback.h"
+#include "EventTrace.h"
+#include "ImplLatency.h"
 
-static void CALLBACK ImplRepeatTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time);
+static void ImplRepeatTimerProc(void *self, hrtime_t time);
 static void ImplGenerateMouseMotionFinish();
+static void ImplBeginInputBatch();
+static void ImplEndInputBatch();
 
 class ChangedMask {
     user_mask_t TouchedUsers = 0;
@@ -12,29 +16,50 @@ class ChangedMask {
     bool ChangedMouseMotion = false;
 
 public:
+    ChangedMask() { ImplBeginInputBatch(); }
+    ChangedMask(const ChangedMask &) = delete;
+
     void TouchUser(int index, ImplState &state) {
         int mask = (1 << index);
         if (!(TouchedUsers & mask)) {
-            state.Mutex.lock();
             TouchedUsers |= mask;
         }
     }
 
-    void ChangeUser(int index, ImplState &state, DWORD time) {
+    void ChangeUser(int index, ImplState &state, hrtime_t time) {
         int mask = (1 << index);
         if (!(ChangedUsers & mask)) {
             state.Time = time;
             state.Version++;
             ChangedUsers |= mask;
+            GImplLatency[index].OnMapped(time);
         }
     }
 
     void ChangeMouseMotion() { ChangedMouseMotion = true; }
 
     ~ChangedMask() {
+        bool trace = GEventTrace.IsEnabled();
+        for (user_mask_t mask = ChangedUsers; mask;) {
+            int index = ImplNextUser(&mask);
+            auto &state = G.Users[index].State;
+            GImplLatency[index].OnFlush(state.Time);
+
+            if (trace) {
+                GEventTrace.Add(EventTraceKind::StateChange, 0, index, 0, state.Version);
+            }
+        }
+        if (trace) { // (flushes are traced even if nothing changed, as they delimit the batches of input)
+            GEventTrace.Add(EventTraceKind::Flush, 0, -1, 0, ChangedUsers, TouchedUsers);
+        }
+
+        if (GImplTrace.IsReplaying()) { // (replayed changes stay within the engine - see ImplReplayScope)
+            TouchedUsers = ChangedUsers = 0;
+        }
+
         while (TouchedUsers) {
             auto &user = G.Users[ImplNextUser(&TouchedUsers)];
-            user.State.Mutex.unlock();
+            user.State.Publish();
         }
 
         while (ChangedUsers) {
@@ -45,6 +70,8 @@ public:
         if (ChangedMouseMotion) {
             ImplGenerateMouseMotionFinish();
         }
+
+        ImplEndInputBatch();
     }
 };
 
@@ -77,20 +104,15 @@ static bool ImplHandleButtonChange(ImplButtonState &state, bool down, slot_t slo
 }
 
 static void ImplProcessStrengthOutput(ImplBoolOutput &boolOutput, ImplStrengthOutput &output, bool down, double strength, slot_t slot) {
-    if (!output.InitIfNeeded(boolOutput, slot)) {
+    if (!boolOutput.IsAllocated(slot)) {
         return;
     }
 
     bool prevDown = (boolOutput.Slots & (1 << slot)) != 0;
     if (down && !prevDown) {
-        output.Slots[slot] = strength;
-        output.Combined = max(output.Combined, strength);
+        output.Set(slot, strength);
     } else if (!down && prevDown) {
-        output.Slots[slot] = 0.0;
-        output.Combined = 0.0;
-        for (int i = 0; i < boolOutput.NumSlots; i++) {
-            output.Combined = max(output.Combined, output.Slots[i]);
-        }
+        output.Set(slot, 0.0);
     }
 
     ImplProcessBoolOutput(boolOutput, down, slot);
@@ -111,24 +133,23 @@ static bool ImplHandleTriggerChange(ImplTriggerState &state, bool down, double s
 }
 
 static double ImplProcessModifierOutput(ImplBoolOutput &boolOutput, ImplModifierOutput &output, bool down, double strength, slot_t slot) {
-    if (!output.InitIfNeeded(boolOutput, slot)) {
-        return output.Combined;
+    if (!boolOutput.IsAllocated(slot)) {
+        return output.Get();
     }
 
     bool prevDown = (boolOutput.Slots & (1 << slot)) != 0;
     if (down && !prevDown) {
-        output.Slots[slot] = strength;
-        output.Combined *= strength;
+        output.Set(slot, strength);
     } else if (!down && prevDown) {
-        output.Slots[slot] = 1.0;
-        output.Combined = 1.0;
-        for (int i = 0; i < boolOutput.NumSlots; i++) {
-            output.Combined *= output.Slots[i];
-        }
+        output.Set(slot, 1.0);
     }
 
     ImplProcessBoolOutput(boolOutput, down, slot);
-    return output.Combined;
+
+    if (!boolOutput.Get()) {
+        output.Reset(); // avoid accumulating rounding errors
+    }
+    return output.Get();
 }
 
 static bool ImplHandleTriggerModifierChange(ImplTriggerState &state, bool down, double strength, slot_t slot, ChangedMask *changes) {
@@ -374,8 +395,8 @@ static bool ImplHandleAxisRotatorModifierChange(ImplAxesState &axesState, ImplUs
     return changed;
 }
 
-static bool ImplUpdateMotion(ImplMotionState &motion, DWORD time) {
-    double deltaTime = (double)(time - motion.PrevTime) / 1000;
+static bool ImplUpdateMotion(ImplMotionState &motion, hrtime_t time) {
+    double deltaTime = (double)(time - motion.PrevTime) / HrTimePerSec;
 
     bool changed = false;
     for (auto dim : {&motion.X, &motion.Y, &motion.Z, &motion.RX, &motion.RY, &motion.RZ}) {
@@ -399,7 +420,7 @@ static bool ImplUpdateMotion(ImplMotionState &motion, DWORD time) {
 
     if (changed) {
         motion.IdleTime = time;
-    } else if (time - motion.IdleTime < 1000) { // just one idle event isn't enough (how many? forever?)
+    } else if (time - motion.IdleTime < HrTimePerSec) { // just one idle event isn't enough (how many? forever?)
         changed = true;
     }
 
@@ -407,21 +428,19 @@ static bool ImplUpdateMotion(ImplMotionState &motion, DWORD time) {
     return changed;
 }
 
-static void CALLBACK ImplMotionTimerProc(HWND window, UINT msg, UINT_PTR id, DWORD time) {
+static void ImplMotionTimerProc(void *self, hrtime_t time) {
     DBG_ASSERT_DLL_THREAD();
-    auto user = GTimerData.From<ImplUser>(id);
-    if (user) {
-        auto &motion = user->State.Motion;
-        int userIdx = user->Device->UserIdx;
-        if (time != motion.PrevTime) {
-            ChangedMask changed;
-            changed.TouchUser(userIdx, user->State);
-
-            if (ImplUpdateMotion(motion, time)) {
-                changed.ChangeUser(userIdx, user->State, time);
-            } else {
-                user->State.Motion.Timer.End();
-            }
+    auto user = (ImplUser *)self;
+    auto &motion = user->State.Motion;
+    int userIdx = user->Device->UserIdx;
+    if (time != motion.PrevTime) {
+        ChangedMask changed;
+        changed.TouchUser(userIdx, user->State);
+
+        if (ImplUpdateMotion(motion, time)) {
+            changed.ChangeUser(userIdx, user->State, time);
+        } else {
+            user->State.Motion.Timer.End();
         }
     }
 }
@@ -520,9 +539,7 @@ static bool ImplPadGetInState(ImplUser *user, int type, void *state, int size) {
 }
 
 static void ImplSetRumble(ImplUser *user, double lowFreq, double highFreq) {
-    if (G.Debug) {
-        LOG << "Rumble " << lowFreq << ", " << highFreq << END;
-    }
+    LOG_DEBUG << "Rumble " << lowFreq << ", " << highFreq << END;
 
     user->State.Feedback.LowRumble = lowFreq;
     user->State.Feedback.HighRumble = highFreq;
@@ -0,0 +1,210 @@
+#pragma once
+#include "ImplBench.h"
+
+// Self-tests of the mapping engine & config loading, run inside the hook (on the dll thread)
+// (like the benchmarks, they use synthetic configs written for them, and leave the loaded config as is)
+
+// a config with nested includes and !Replace mappings compiles to the same ops with & without read-ahead
+static bool ImplTestReadAhead() {
+    static const tuple<const wchar_t *, const char *> configs[] = {
+        {L"_test_read_ahead.ini", "A : B\n!Include _test_read_ahead_1\nC : D\nA : E !Replace\n"},
+        {L"_test_read_ahead_1.ini", "F : G\n!Include _test_read_ahead_2\nH : %A\nF : %B !Replace\n[ !Layer test\nA : X\n]\n"},
+        {L"_test_read_ahead_2.ini", "A : Y !Replace\nI : J\n!Include _test_read_ahead_3\n!Include _test_read_ahead_3\n"},
+        {L"_test_read_ahead_3.ini", "I : K !Replace\nF : L ?A\n"},
+    };
+
+    for (auto &[name, text] : configs) {
+        ImplBenchWriteConfig(name, text);
+    }
+
+    ConfigResident serial, readAhead;
+    for (auto [result, useReadAhead] : {tuple(&serial, false), tuple(&readAhead, true)}) {
+        ConfigCustom custom;
+        custom.NoLoad = true;
+        ConfigCompileFile(std::get<0>(configs[0]), result, custom, useReadAhead, false);
+    }
+
+    bool ok = !serial.Ops.Ops.empty() && serial.Ops.Data == readAhead.Ops.Data && serial.LoadedFiles == readAhead.LoadedFiles;
+    if (!ok) {
+        LOG_W << "ERROR: Test read_ahead: ops differ with read-ahead (" << serial.Ops.Ops.size() << " vs " << readAhead.Ops.Ops.size() << " ops)" << END;
+    }
+
+    for (auto &[name, text] : configs) {
+        ImplBenchDeleteConfig(name);
+    }
+    return ok;
+}
+
+// a SeqLocked value, written continuously while read by several threads - no read may be torn or go back in time
+static bool ImplTestSeqLockStress() {
+    struct Value {
+        uint64_t Words[16];
+    };
+
+    constexpr uint64_t NumWrites = 1000000;
+    SeqLocked<Value> locked;
+    std::atomic<bool> done = false;
+    std::atomic<int> numBad = 0;
+
+    vector<std::thread> readers;
+    for (int i = 0; i < 3; i++) {
+        readers.emplace_back([&] {
+            uint64_t last = 0;
+            while (!done.load()) {
+                Value value = locked.Read();
+                bool torn = std::any_of(value.Words, value.Words + 16, [&](uint64_t word) { return word != value.Words[0]; });
+                if (torn || value.Words[0] < last) {
+                    numBad++;
+                }
+                last = value.Words[0];
+            }
+        });
+    }
+
+    Value value;
+    for (uint64_t i = 1; i <= NumWrites; i++) {
+        std::fill(value.Words, value.Words + 16, i);
+        locked.Write(value);
+    }
+
+    done = true;
+    for (auto &reader : readers) {
+        reader.join();
+    }
+
+    if (numBad) {
+        LOG_W << "ERROR: Test seqlock_stress: " << numBad.load() << " bad reads" << END;
+    }
+    return numBad == 0 && locked.Read().Words[0] == NumWrites;
+}
+
+// a reload (which resets all state) publishes the reset state to readers of the snapshot
+static bool ImplTestResetPublishes() {
+    const wchar_t *name = L"_test_reset.ini";
+    ImplBenchWriteConfig(name, "A : %A\n");
+
+    wstring original = GConfig.MainFile.Get();
+    ConfigSwitch(Path(name));
+
+    auto &state = G.Users[0].State;
+    state.A.State = true; // (as if held)
+    state.Version++;
+    state.Publish();
+    int heldVersion = state.Snapshot.Read().Version;
+
+    ConfigReloadFull();
+    ImplStateSnapshot snapshot = state.Snapshot.Read();
+    bool ok = !snapshot.A.State && snapshot.Version != heldVersion;
+    if (!ok) {
+        LOG_W << "ERROR: Test reset_publishes: snapshot still has the state from before the reload" << END;
+    }
+
+    ConfigSwitch(Path(original.c_str()));
+    ImplBenchDeleteConfig(name);
+    return ok;
+}
+
+// checks the read form of 'conds' directly, without the packed masks of ConfigBuildConds (as ImplCheckConds did before them)
+static bool ImplTestCheckCondsRef(ImplCond *conds, bool isAnd) {
+    for (ImplCond *cond = conds; cond; cond = cond->Next) {
+        bool value;
+        if (cond->Key == MY_VK_META_COND_AND || cond->Key == MY_VK_META_COND_OR) {
+            value = ImplTestCheckCondsRef(cond->Child, cond->Key == MY_VK_META_COND_AND) == cond->State;
+        } else {
+            ImplInput *input = ImplGetInput(cond->Key, cond->User);
+            value = input && (cond->Toggle ? input->AsyncToggle : input->AsyncDown) == cond->State;
+        }
+
+        if (value != isAnd) {
+            return value;
+        }
+    }
+    return isAnd;
+}
+
+// built conditions (with and-ed keyboard conditions packed into masks) check the same as the read form,
+// on random condition trees and random key states
+static bool ImplTestCondMasks() {
+    static const key_t keys[] = {'A', 'B', 'C', 'D', VK_LSHIFT, VK_CAPITAL, VK_LBUTTON, MY_VK_WHEEL_UP, MY_VK_MOUSE_LEFT, MY_VK_PAD_A};
+    std::mt19937 random(1);
+    int numChecks = 0, numMismatches = 0;
+
+    auto makeConds = [&](auto &self, int depth) -> SharedPtr<ImplCond> {
+        SharedPtr<ImplCond> first;
+        SharedPtr<ImplCond> *next = &first;
+        for (int count = 1 + random() % 5; count > 0; count--) {
+            auto cond = SharedPtr<ImplCond>::New();
+            if (depth < 3 && random() % 4 == 0) {
+                cond->Key = random() % 2 ? MY_VK_META_COND_AND : MY_VK_META_COND_OR;
+                cond->Child = self(self, depth + 1);
+            } else {
+                cond->Key = keys[random() % size(keys)];
+            }
+            cond->State = random() % 2;
+            cond->Toggle = random() % 2;
+
+            *next = cond;
+            next = &cond->Next;
+        }
+        return first;
+    };
+
+    ImplKeySet savedDown = G.Keyboard.Down; // (not restored by the scratch scope, as it's not reset by it)
+    {
+        ConfigScratchScope scratch;
+
+        for (int tree = 0; tree < 2000; tree++) {
+            G.Arena.Reset();
+            SharedPtr<ImplCond> root = makeConds(makeConds, 0);
+            ImplCondList list = ConfigBuildConds(G.Arena, root, true);
+
+            for (int state = 0; state < 32; state++) {
+                for (key_t key : keys) {
+                    ImplInput *input = ImplGetInput(key, -1);
+                    if (input) {
+                        input->AsyncDown = random() % 2;
+                        input->AsyncToggle = random() % 2;
+                        G.Keyboard.UpdateAsync(input);
+                    }
+                }
+
+                numChecks++;
+                if (ImplCheckCondsAnd(list) != ImplTestCheckCondsRef(root, true)) {
+                    numMismatches++;
+                }
+            }
+        }
+    }
+    G.Keyboard.Down = savedDown;
+
+    if (numMismatches) {
+        LOG_W << "ERROR: Test cond_masks: " << numMismatches << " of " << numChecks << " checks differ from the unpacked conditions" << END;
+    }
+    return numMismatches == 0;
+}
+
+static bool ImplSelfTest(const wchar_t *name) {
+    DBG_ASSERT_DLL_THREAD();
+
+    static const tuple<const wchar_t *, bool (*)()> tests[] = {
+        {L"read_ahead", ImplTestReadAhead},
+        {L"seqlock_stress", ImplTestSeqLockStress},
+        {L"reset_publishes", ImplTestResetPublishes},
+        {L"cond_masks", ImplTestCondMasks},
+    };
+
+    bool ok = true, found = false;
+    for (auto &[testName, test] : tests) {
+        if (tstreq(name, L"all") || tstreq(name, testName)) {
+            found = true;
+            bool passed = test();
+            LOG << "Test " << testName << (passed ? " passed" : " FAILED") << END;
+            ok = ok && passed;
+        }
+    }
+
+    if (!found) {
+        LOG_W << "ERROR: Unknown test: " << name << END;
+    }
+    return ok && found;
+}
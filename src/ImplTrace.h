@@ -0,0 +1,169 @@
+#pragma once
+#include "State.h"
+#include <fstream>
+
+// Traces of the input events entering the mapping engine, for replaying them later
+// File format: ImplTraceHeader, followed by ImplTraceEvents until the end of the file
+
+enum class ImplTraceType : uint8_t {
+    Keyboard = 1,
+    MouseButton,
+    MouseMotion,
+    MouseWheel,
+    CustomKey,
+};
+
+enum ImplTraceFlags : uint8_t {
+    ImplTraceFlag_Down = 0x1,
+    ImplTraceFlag_Extended = 0x2,
+    ImplTraceFlag_Horizontal = 0x4,
+};
+
+#pragma pack(push, 1)
+struct ImplTraceHeader {
+    static constexpr uint32_t MagicValue = 0x5449594d; // "MYIT"
+    static constexpr uint32_t CurrentVersion = 1;
+
+    uint32_t Magic = MagicValue;
+    uint32_t Version = CurrentVersion;
+};
+
+struct ImplTraceEvent {
+    hrtime_t Time;
+    ImplTraceType Type;
+    uint8_t Flags;
+    uint16_t Key;   // virtual key code, or custom key index
+    int32_t X, Y;   // mouse motion, or wheel delta (in X)
+    float Strength; // for custom keys
+};
+#pragma pack(pop)
+
+// A chunk of recorded events, written to the trace file by GImplTraceWriter
+struct ImplTraceChunk {
+    HANDLE File;
+    vector<ImplTraceEvent> Events;
+    bool Close; // (the last chunk)
+};
+
+static ReusableThread GImplTraceWriter{THREAD_PRIORITY_BELOW_NORMAL}; // (so that recording doesn't block the hooks on file io)
+
+static DWORD WINAPI ImplTraceWriteChunk(void *param) {
+    ImplTraceChunk *chunk = (ImplTraceChunk *)param;
+    DWORD size = (DWORD)(chunk->Events.size() * sizeof(ImplTraceEvent));
+    DWORD written;
+    if (size && (!WriteFile(chunk->File, chunk->Events.data(), size, &written, nullptr) || written != size)) {
+        LOG_W << "ERROR: Failed to write input trace" << END;
+    }
+
+    if (chunk->Close) {
+        CloseHandle(chunk->File);
+    }
+    delete chunk;
+    return 0;
+}
+
+class ImplTrace {
+    static constexpr size_t ChunkEvents = 0x1000;
+
+    HANDLE mRecordFile = nullptr;
+    vector<ImplTraceEvent> mRecordChunk; // (filled by the dll thread, then handed to GImplTraceWriter)
+    std::ofstream mReplay;
+    bool mReplaying = false;
+    hrtime_t mReplayStart = 0;
+
+    void FlushRecord(bool close) {
+        GImplTraceWriter.CreateThread(ImplTraceWriteChunk, new ImplTraceChunk{mRecordFile, move(mRecordChunk), close});
+        mRecordChunk = {};
+        if (!close) {
+            mRecordChunk.reserve(ChunkEvents);
+        }
+    }
+
+public:
+    bool IsRecording() const { return mRecordFile != nullptr; }
+    bool IsReplaying() const { return mReplaying; }
+    bool HasReplayOutput() const { return mReplay.is_open(); }
+
+    bool StartRecord(const wchar_t *path) {
+        EndRecord();
+        HANDLE file = CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, 0, nullptr);
+        ImplTraceHeader header;
+        DWORD written;
+        if (file == INVALID_HANDLE_VALUE || !WriteFile(file, &header, sizeof(header), &written, nullptr)) {
+            LOG_W << "ERROR: Failed to open trace for writing: " << path << END;
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            return false;
+        }
+
+        mRecordFile = file;
+        mRecordChunk.reserve(ChunkEvents);
+        LOG << "Recording input trace to: " << path << END;
+        return true;
+    }
+
+    void EndRecord() {
+        if (mRecordFile) {
+            FlushRecord(true);
+            mRecordFile = nullptr;
+            LOG << "Finished recording input trace" << END;
+        }
+    }
+
+    void Record(hrtime_t time, ImplTraceType type, uint8_t flags, int key, int x = 0, int y = 0, double strength = 0) {
+        mRecordChunk.push_back({time, type, flags, (uint16_t)key, x, y, (float)strength});
+        if (mRecordChunk.size() >= ChunkEvents) {
+            FlushRecord(false);
+        }
+    }
+
+    bool StartReplay(const wchar_t *outPath, hrtime_t start) {
+        if (outPath) {
+            mReplay.open(outPath);
+            if (mReplay.fail()) {
+                LOG_W << "ERROR: Failed to open replay output for writing: " << outPath << END;
+                return false;
+            }
+        }
+
+        mReplaying = true;
+        mReplayStart = start;
+        return true;
+    }
+
+    void EndReplay() {
+        mReplaying = false;
+        if (mReplay.is_open()) {
+            mReplay.close();
+        }
+    }
+
+    // Starts a line of replay output, prefixed by the (replayed) time since the replay began
+    std::ofstream &ReplayLine() {
+        mReplay << GHrClock.Now() - mReplayStart << " ";
+        return mReplay;
+    }
+
+    // Commands that act outside the engine (written instead of being done, while replaying)
+    void ReplayCommand(int key, bool down) {
+        if (HasReplayOutput()) {
+            ReplayLine() << "command " << key << (down ? " down" : " up") << "\n";
+        }
+    }
+
+    // Generated key/mouse output (written instead of being sent, while replaying)
+    void ReplayOutput(const INPUT &input) {
+        if (!HasReplayOutput()) {
+            return;
+        }
+
+        auto &out = ReplayLine();
+        if (input.type == INPUT_KEYBOARD) {
+            out << "key " << input.ki.wVk << ((input.ki.dwFlags & KEYEVENTF_KEYUP) ? " up" : " down") << "\n";
+        } else {
+            out << "mouse " << std::hex << input.mi.dwFlags << std::dec << " " << (int)input.mi.mouseData << " "
+                << input.mi.dx << " " << input.mi.dy << "\n";
+        }
+    }
+} GImplTrace;
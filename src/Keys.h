@@ -139,6 +139,10 @@ enum {
     MY_VK_TOGGLE_SPARE_FOR_DEBUG,
     MY_VK_LOAD_CONFIG,
     MY_VK_TOGGLE_BOUND_CURSOR,
+    MY_VK_TOGGLE_LAYER,
+    MY_VK_HOLD_LAYER,
+    MY_VK_PUSH_LAYER,
+    MY_VK_POP_LAYER,
     MY_VK_LAST_CMD,
 
     MY_VK_FIRST_USER_CMD = 0xc500,
@@ -448,6 +452,10 @@ enum class MyVkGroup {
     e(MY_VK_TOGGLE_ALWAYS, "ToggleAlways", L"Toggle Mapping in Background", Command, "togglealways");                                                     \
     e(MY_VK_TOGGLE_HIDE_CURSOR, "ToggleHideCursor", L"Toggle Hide Cursor", Command, "togglehidecursor");                                                  \
     e(MY_VK_TOGGLE_BOUND_CURSOR, "ToggleBoundCursor", L"Toggle Bound Cursor", Command, "toggleboundcursor");                                              \
+    e(MY_VK_TOGGLE_LAYER, "ToggleLayer", L"Toggle Layer", Command, "togglelayer");                                                                        \
+    e(MY_VK_HOLD_LAYER, "HoldLayer", L"Activate Layer while Held", Command, "holdlayer");                                                                 \
+    e(MY_VK_PUSH_LAYER, "PushLayer", L"Activate Layer", Command, "pushlayer");                                                                            \
+    e(MY_VK_POP_LAYER, "PopLayer", L"Deactivate Layer", Command, "poplayer");                                                                             \
     /* Command Debug group */                                                                                                                             \
     e(MY_VK_TOGGLE_SPARE_FOR_DEBUG, "ToggleSpareForDebug", L"(Debug) No Effect Toggle", CommandDebug, "togglesparefordebug");                             \
     //
@@ -2,9 +2,108 @@
 #include "UtilsBase.h"
 #include "UtilsPath.h"
 #include "LogUtils.h"
+#include "PerfCounters.h"
 #include <Windows.h>
 
+// A bounded multi-producer ring of formatted log records, drained into the log file by a background thread
+// (so that logging - e.g. from within input hooks - costs a copy, never waiting on a lock or on I/O)
+// Records that don't fit are dropped (and counted), rather than waited on
+class LogRing {
+    static constexpr uint64_t NumSlots = 0x2000; // (power of 2)
+    static constexpr size_t SlotDataSize = 112;
+    static constexpr size_t MaxRecordSize = SlotDataSize * 64; // (longer records are truncated)
+
+    struct Slot {
+        atomic<uint64_t> Seq; // pos while free for pos, pos + 1 once written, pos + NumSlots once read
+        uint32_t Size;        // of the whole record
+        LogLevel Level;
+        char Data[SlotDataSize];
+    };
+
+    Slot mSlots[NumSlots];
+    alignas(64) atomic<uint64_t> mHead = 0;
+    alignas(64) atomic<uint64_t> mDropped = 0;
+    uint64_t mTail = 0; // (consumer only)
+    string mRecord;     // (consumer only)
+
+    Slot &At(uint64_t pos) { return mSlots[pos & (NumSlots - 1)]; }
+
+public:
+    LogRing() {
+        for (uint64_t i = 0; i < NumSlots; i++) {
+            mSlots[i].Seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t Dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+    // May be called from any thread
+    bool Push(LogLevel level, const char *str, size_t size) {
+        size = min(size, MaxRecordSize);
+        uint64_t count = max<uint64_t>(DivRoundUp(size, SlotDataSize), 1);
+
+        // (the slots are freed in order, so if the last one is free, all are)
+        uint64_t pos = mHead.load(std::memory_order_relaxed);
+        while (true) {
+            if (At(pos + count - 1).Seq.load(std::memory_order_acquire) != pos + count - 1) {
+                uint64_t head = mHead.load(std::memory_order_relaxed);
+                if (head == pos) {
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                pos = head;
+            } else if (mHead.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            Slot &slot = At(pos + i);
+            size_t offset = (size_t)i * SlotDataSize;
+            memcpy(slot.Data, str + offset, min(size - offset, SlotDataSize));
+            slot.Size = (uint32_t)size;
+            slot.Level = level;
+            slot.Seq.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+    }
+
+    // Calls 'cb' with each complete record, in order (must not be called concurrently)
+    template <class TCb>
+    void Drain(TCb &&cb) {
+        while (true) {
+            Slot &first = At(mTail);
+            if (first.Seq.load(std::memory_order_acquire) != mTail + 1) {
+                break;
+            }
+
+            size_t size = first.Size;
+            LogLevel level = first.Level;
+            uint64_t count = max<uint64_t>(DivRoundUp(size, SlotDataSize), 1);
+            if (At(mTail + count - 1).Seq.load(std::memory_order_acquire) != mTail + count) {
+                break; // (still being written)
+            }
+
+            mRecord.clear();
+            for (uint64_t i = 0; i < count; i++) {
+                Slot &slot = At(mTail + i);
+                size_t offset = (size_t)i * SlotDataSize;
+                mRecord.append(slot.Data, min(size - offset, SlotDataSize));
+                slot.Seq.store(mTail + i + NumSlots, std::memory_order_release);
+            }
+
+            mTail += count;
+            cb(level, mRecord);
+        }
+    }
+};
+
 HANDLE GLogFile = nullptr;
+LogRing GLogRing;
+mutex GLogDrainMutex;
+uint64_t GLogDroppedWritten = 0; // (under GLogDrainMutex)
+string GLogBatch;                // (under GLogDrainMutex)
+constexpr DWORD LogWriteIntervalMs = 10;
 
 struct LogCbType {
     void (*Func)(const char *str, size_t size, char level, void *data) = nullptr;
@@ -12,6 +111,53 @@ struct LogCbType {
 };
 WeakAtomic<LogCbType> GLogCb;
 
+static void LogWrite(const char *str, size_t size) {
+    if (GLogFile) {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = -1;
+        overlapped.OffsetHigh = -1;
+
+        DWORD count;
+        WriteFile(GLogFile, str, (DWORD)size, &count, &overlapped);
+    }
+}
+
+// Writes out all logged records, as a single write
+static void LogFlushLocked() {
+    GLogBatch.clear();
+    GLogRing.Drain([](LogLevel level, const string &record) { GLogBatch += record; });
+
+    uint64_t dropped = GLogRing.Dropped();
+    if (dropped != GLogDroppedWritten) {
+        GLogBatch += "(dropped " + std::to_string(dropped - GLogDroppedWritten) + " log records)\n";
+        GLogDroppedWritten = dropped;
+    }
+
+    if (!GLogBatch.empty()) {
+        LogWrite(GLogBatch.data(), GLogBatch.size());
+    }
+}
+
+void LogFlush() {
+    lock_guard<mutex> lock(GLogDrainMutex);
+    LogFlushLocked();
+}
+
+// (for when other threads may have been stopped while holding the lock - e.g. on process exit)
+void LogTryFlush() {
+    if (GLogDrainMutex.try_lock()) {
+        LogFlushLocked();
+        GLogDrainMutex.unlock();
+    }
+}
+
+static DWORD WINAPI LogWriterThread(LPVOID param) {
+    while (true) {
+        Sleep(LogWriteIntervalMs);
+        LogFlush();
+    }
+}
+
 void LogInit(const Path &inputPath) {
     Path fallbackPath;
     int num = 0;
@@ -29,24 +175,30 @@ void LogInit(const Path &inputPath) {
         fileNameStream << PathGetBaseNameWithoutExt(inputPath).Get() << L"." << ++num << L"." << PathGetExt(inputPath).Get();
         fallbackPath = PathCombine(dirName, fileNameStream.str().c_str());
     }
+
+    HANDLE thread = CreateThread(nullptr, 0, LogWriterThread, nullptr, 0, nullptr);
+    if (thread) {
+        SetThreadPriority(thread, THREAD_PRIORITY_BELOW_NORMAL);
+        CloseHandle(thread);
+    }
 }
 
 void Log(LogLevel level, const char *str, size_t size) {
-    if (GLogFile) {
-        OVERLAPPED overlapped = {};
-        overlapped.Offset = -1;
-        overlapped.OffsetHigh = -1;
-
-        DWORD count;
-        WriteFile(GLogFile, str, (DWORD)size, &count, &overlapped);
+    if (!GLogRing.Push(level, str, size)) {
+        GPerfCounters.Add(PerfCounter_LogRecordsDropped);
     }
 
+    // (called synchronously, as its owner may go away once it's unset)
     auto logCb = GLogCb.get();
     if (logCb.Func) {
         logCb.Func(str, size, (char)level, logCb.Data);
     }
 
-    if (level == LogLevel::Error && IsDebuggerPresent()) {
-        DebugBreak();
+    if (level == LogLevel::Error) {
+        LogFlush(); // (in case we're about to go down)
+
+        if (IsDebuggerPresent()) {
+            DebugBreak();
+        }
     }
 }
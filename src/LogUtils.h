@@ -1,6 +1,7 @@
 #pragma once
 #include "UtilsBase.h"
 #include <Windows.h>
+#include <charconv>
 
 enum class LogLevel {
     // Will add more if needed...
@@ -11,23 +12,166 @@ enum class LogLevel {
 
 void Log(LogLevel level, const char *str, size_t size);
 
-template <class LogFunc>
-void Log(LogLevel level, LogFunc &&func) {
-    stringstream stream;
-    func(stream);
-    auto str = stream.str();
-    Log(level, str.data(), str.size());
-}
+// The log buffer of a thread (log calls nested within the formatting of another continue past its text)
+struct LogBuffer {
+    static constexpr size_t Size = 0x1000;
+
+    char Data[Size];
+    size_t Used = 0;
+};
+thread_local LogBuffer GLogBuffer;
+
+// Types that LogStream formats directly (pointers to types with their own ostream operator need a LogStream operator too)
+template <class T>
+concept LogDirect = std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T> ||
+                    std::is_convertible_v<const T &, string_view> || std::is_convertible_v<const T &, wstring_view> ||
+                    std::is_convertible_v<const T &, const char *> || std::is_convertible_v<const T &, const wchar_t *>;
+
+// Formats a log record into the thread's log buffer - without allocating - and logs it once destroyed
+// (records that don't fit in the buffer are truncated)
+class LogStream {
+    LogLevel mLevel;
+    size_t mBegin;
+    size_t mPos;
+    bool mHex = false;
+
+    void Write(const char *str, size_t size) {
+        size = min(size, LogBuffer::Size - 1 - mPos); // (keeping room for a null terminator)
+        memcpy(GLogBuffer.Data + mPos, str, size);
+        mPos += size;
+        GLogBuffer.Used = mPos;
+    }
+
+    template <class T>
+    void WriteNumber(T value) {
+        char buffer[32];
+        char *end;
+        if constexpr (std::is_floating_point_v<T>) {
+            end = std::to_chars(buffer, std::end(buffer), (double)value, std::chars_format::general, 6).ptr;
+        } else if (mHex || !std::is_signed_v<T>) {
+            end = std::to_chars(buffer, std::end(buffer), (uint64_t)(make_unsigned_t<T>)value, mHex ? 16 : 10).ptr;
+        } else {
+            end = std::to_chars(buffer, std::end(buffer), (int64_t)value).ptr;
+        }
+        Write(buffer, end - buffer);
+    }
+
+public:
+    LogStream(LogLevel level) : mLevel(level), mBegin(GLogBuffer.Used), mPos(mBegin) {}
+    LogStream(const LogStream &) = delete;
+
+    ~LogStream() {
+        GLogBuffer.Data[mPos] = '\0';
+        Log(mLevel, GLogBuffer.Data + mBegin, mPos - mBegin);
+        GLogBuffer.Used = mBegin;
+    }
+
+    LogStream &Self() { return *this; }
+
+    LogStream &operator<<(string_view str) {
+        Write(str.data(), str.size());
+        return *this;
+    }
+
+    LogStream &operator<<(const char *str) { return *this << string_view(str); }
+
+    LogStream &operator<<(wstring_view str) {
+        size_t space = LogBuffer::Size - 1 - mPos;
+        int size = (int)min(str.size(), space / 3); // (utf-8 needs at most 3 bytes per utf-16 unit)
+        mPos += WideCharToMultiByte(CP_UTF8, 0, str.data(), size, GLogBuffer.Data + mPos, (int)space, nullptr, nullptr);
+        GLogBuffer.Used = mPos;
+        return *this;
+    }
+
+    LogStream &operator<<(const wchar_t *str) { return *this << wstring_view(str); }
+
+    LogStream &operator<<(char ch) {
+        Write(&ch, 1);
+        return *this;
+    }
+
+    LogStream &operator<<(bool value) { return *this << (value ? '1' : '0'); }
+
+    template <class T>
+        requires std::is_arithmetic_v<T>
+    LogStream &operator<<(T value) {
+        WriteNumber(value);
+        return *this;
+    }
+
+    template <class T>
+        requires std::is_enum_v<T>
+    LogStream &operator<<(T value) {
+        WriteNumber((std::underlying_type_t<T>)value);
+        return *this;
+    }
+
+    LogStream &operator<<(const void *ptr) {
+        char buffer[sizeof(uintptr_t) * 2];
+        for (int i = 0; i < (int)size(buffer); i++) {
+            buffer[i] = "0123456789ABCDEF"[((uintptr_t)ptr >> ((size(buffer) - 1 - i) * 4)) & 0xf];
+        }
+        Write(buffer, size(buffer));
+        return *this;
+    }
+
+    // (std::hex & std::dec)
+    LogStream &operator<<(std::ios_base &(*manip)(std::ios_base &)) {
+        if (manip == std::hex) {
+            mHex = true;
+        } else if (manip == std::dec) {
+            mHex = false;
+        }
+        return *this;
+    }
+
+    // Anything else is formatted via its ostream operator (allocating, but such types are rarely logged)
+    template <class T>
+        requires(!LogDirect<T>)
+    LogStream &operator<<(const T &value) {
+        stringstream stream;
+        stream << value;
+        return *this << string_view(stream.str());
+    }
+};
+
+// Bits of GLogMask - which of the optional log calls are enabled
+enum LogMaskFlags : uint32_t {
+    LogMask_Debug = 0x1,
+    LogMask_Trace = 0x2,
+    LogMask_ApiDebug = 0x4,
+    LogMask_ApiTrace = 0x8,
+};
+WeakAtomic<uint32_t> GLogMask;
 
-#define LOG_OF(level) Log (level, [&] (std::ostream& LogTarget) { LogTarget
-#define END    \
-    std::endl; \
-    })
+#define LOG_OF(level) LogStream(level).Self()
+#define END '\n'
 
 #define LOG LOG_OF(LogLevel::Default)
 #define LOG_W LOG_OF(LogLevel::Warning)
 #define LOG_ERR LOG_OF(LogLevel::Error)
 
+// Logs only if the given GLogMask flag is set (e.g. LOG_IF(LogMask_Debug) << ... << END)
+#define LOG_IF(flag)                  \
+    if (!(GLogMask.get() & (flag))) { \
+    } else                            \
+        LOG
+
+// Define LOG_NO_TRACE to compile out the trace-level log calls (which may be on the hot path of input processing)
+#ifdef LOG_NO_TRACE
+#define LOG_IF_TRACE(flag) \
+    if constexpr (true) {  \
+    } else                 \
+        LOG
+#else
+#define LOG_IF_TRACE(flag) LOG_IF(flag)
+#endif
+
+#define LOG_DEBUG LOG_IF(LogMask_Debug)
+#define LOG_API_DEBUG LOG_IF(LogMask_ApiDebug)
+#define LOG_TRACE LOG_IF_TRACE(LogMask_Trace)
+#define LOG_API_TRACE LOG_IF_TRACE(LogMask_ApiTrace)
+
 int Fatal(const char *str) {
     LOG_ERR << "FATAL: " << str << END;
     return 0;
@@ -11,6 +11,8 @@
 #include "NotifyApi.h"
 #include "Log.h"
 #include "WbemApi.h"
+#include "ImplBench.h"
+#include "ImplTest.h"
 #include <Windows.h>
 
 void UpdateAll() {
@@ -25,6 +27,7 @@ void UpdateAll() {
 ReliablePostThreadMessage GDllThreadMsgQueue;
 
 void PostAppCallback(AppCallback cb, void *data) {
+    GPerfCounters.Add(PerfCounter_DllQueueDepth);
     GDllThreadMsgQueue.Post(WM_APP, (WPARAM)data, (LPARAM)cb);
 }
 
@@ -41,6 +44,7 @@ static DWORD WINAPI DllThread(LPVOID param) {
 
     G.DllThread = GetCurrentThreadId(); // set both here and by CreateThread - needed by both
 
+    GUserTimers.Initialize();
     RegisterGlobalNotify();
     WinHooksInitOnThread();
     RawInputInitDllWindow();
@@ -54,16 +58,34 @@ static DWORD WINAPI DllThread(LPVOID param) {
 
     SetThreadPriority(GetCurrentThread(), InputThreadPriority);
 
-    MSG msg;
-    while (GetMessageW(&msg, NULL, 0, 0) > 0) {
-        if (msg.message == WM_APP) {
-            ((AppCallback)msg.lParam)((void *)msg.wParam);
-        } else {
-            TranslateMessage(&msg);
-            DispatchMessageW(&msg);
+    while (true) {
+        HANDLE handles[MAXIMUM_WAIT_OBJECTS - 1];
+        DWORD numHandles = 0;
+        handles[numHandles++] = GUserTimers.WaitHandle();
+        for (HANDLE handle : GConfig.Watcher.Handles()) {
+            if (numHandles < size(handles)) {
+                handles[numHandles++] = handle;
+            }
         }
+
+        MsgWaitForMultipleObjectsEx(numHandles, handles, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+        MSG msg;
+        while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                return 0;
+            } else if (msg.message == WM_APP) {
+                GPerfCounters.Add(PerfCounter_DllQueueDepth, -1);
+                ((AppCallback)msg.lParam)((void *)msg.wParam);
+            } else {
+                TranslateMessage(&msg);
+                DispatchMessageW(&msg);
+            }
+        }
+
+        ConfigCheckWatcher();
+        GPerfCounters.Add(PerfCounter_TimerTicks, GUserTimers.Update());
     }
-    return 0;
 }
 
 void MyInputHook_Log(const char *data, intptr_t size, char level) {
@@ -87,7 +109,7 @@ void *MyInputHook_RegisterCustomKey(const char *name, void (*cb)(const MyInputHo
         MyInputHook_KeyInfo info = {};
         info.Down = value.Down;
         info.Strength = value.Strength;
-        info.Time = value.Time;
+        info.Time = GHrClock.ToTicks(value.Time);
         if (mapping->Data) {
             info.Flags |= MyInputHook_KeyFlag_Has_Data;
             info.Data = mapping->Data->c_str();
@@ -103,7 +125,7 @@ void *MyInputHook_RegisterCustomKey(const char *name, void (*cb)(const MyInputHo
 void MyInputHook_UpdateCustomKey(void *customKeyObj, const MyInputHook_KeyInfo *info) {
     DBG_ASSERT_DLL_THREAD();
     int index = (int)(uintptr_t)customKeyObj - 1;
-    ImplOnCustomKey(index, InputValue{info->Down, info->Strength, info->Time});
+    ImplOnCustomKey(index, InputValue{info->Down, info->Strength, GHrClock.FromTicks(info->Time)});
 }
 
 void *MyInputHook_RegisterCustomVar(const char *name, void (*cb)(const char *, void *), void *data) {
@@ -164,6 +186,21 @@ void MyInputHook_SetOutState(int userIdx, int type, const void *state, int size)
     }
 }
 
+void MyInputHook_GetStats(int userIdx, int type, MyInputHook_Stats *stats, int size) {
+    if ((DWORD)userIdx >= IMPL_MAX_USERS || size < sizeof(*stats)) {
+        memset(stats, 0, size);
+        return;
+    }
+
+    GImplLatency[userIdx].Get(type, stats);
+}
+
+void MyInputHook_ResetStats() {
+    for (auto &latency : GImplLatency) {
+        latency.Reset();
+    }
+}
+
 void MyInputHook_LoadConfig(const wchar_t *name) {
     DBG_ASSERT_DLL_THREAD();
     if (name) {
@@ -197,6 +234,45 @@ bool MyInputHook_InternalIsVirtual(const wchar_t *path) {
     return false;
 }
 
+bool MyInputHook_InternalRecordTrace(const wchar_t *path) {
+    DBG_ASSERT_DLL_THREAD();
+    if (!path) {
+        GImplTrace.EndRecord();
+        return true;
+    }
+    return GImplTrace.StartRecord(path);
+}
+
+bool MyInputHook_InternalReplayTrace(const wchar_t *path, const wchar_t *outPath) {
+    DBG_ASSERT_DLL_THREAD();
+    return ImplReplayTrace(path, outPath);
+}
+
+bool MyInputHook_InternalBenchmark(const wchar_t *resultPath) {
+    DBG_ASSERT_DLL_THREAD();
+    return ImplBenchmark(resultPath);
+}
+
+bool MyInputHook_InternalDumpConfigCache(const wchar_t *outPath) {
+    DBG_ASSERT_DLL_THREAD();
+    return ConfigDumpCache(ConfigGetCachePath(GConfig.MainFile), outPath);
+}
+
+bool MyInputHook_InternalLintConfig(const wchar_t *configPath, const wchar_t *outPath) {
+    DBG_ASSERT_DLL_THREAD();
+    return ConfigLint(configPath, outPath);
+}
+
+bool MyInputHook_InternalSelfTest(const wchar_t *name) {
+    DBG_ASSERT_DLL_THREAD();
+    return ImplSelfTest(name);
+}
+
+int MyInputHook_InternalGetNumReloads() {
+    DBG_ASSERT_DLL_THREAD();
+    return GConfig.NumReloads;
+}
+
 BOOL APIENTRY DllMain(HINSTANCE hInstance, DWORD ul_reason_for_call, LPVOID lpReserved) {
     if (ul_reason_for_call == DLL_PROCESS_ATTACH) {
         // Prevent unload since we have a thread and various hooks
@@ -211,6 +287,8 @@ BOOL APIENTRY DllMain(HINSTANCE hInstance, DWORD ul_reason_for_call, LPVOID lpRe
         Path baseName = PathGetBaseNameWithoutExt(PathGetModulePath(nullptr));
 
         LogInit(PathCombine(PathCombine(rootDir, L"Logs"), PathCombineExt(baseName, L"log")));
+        GEventTrace.Init(PathCombine(PathCombine(rootDir, L"Logs"), PathCombineExt(baseName, L"trace")));
+        GPerfCounters.Init();
         LOG << "Initializing..." << END;
 
         RawInputPreregisterEarly();
@@ -232,6 +310,8 @@ BOOL APIENTRY DllMain(HINSTANCE hInstance, DWORD ul_reason_for_call, LPVOID lpRe
         G.DllThread = 0;
         CloseHandle(CreateThread(nullptr, 0, DllThread, NULL, 0, &G.DllThread)); // do the rest on the thread, as it's not dllmain-safe
         LOG << "Initialized!" << END;
+    } else if (ul_reason_for_call == DLL_PROCESS_DETACH) {
+        LogTryFlush();
     } else if (ul_reason_for_call == DLL_THREAD_DETACH) {
         DWORD threadId = GetCurrentThreadId();
         WinHooksDetachThread(threadId);
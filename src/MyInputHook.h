@@ -50,6 +50,22 @@ struct MyInputHook_OutState_Rumble {
     double Low, High;
 };
 
+// Stages of delivering the gamepad state changed by an input to the app, each measured from the hook receiving the input
+enum MyInputHook_StatsType {
+    MyInputHook_Stats_Mapping = 1, // a mapping changed the state
+    MyInputHook_Stats_Flush,       // the changed state was published
+    MyInputHook_Stats_HidReport,   // a hid report of the state was queued
+    MyInputHook_Stats_HidRead,     // the app read a hid report of the state
+    MyInputHook_Stats_XUsbRead,    // the app read the state via xusb (e.g. xinput)
+    MyInputHook_Stats_RawInput,    // a raw input message of the state was posted to the app
+};
+
+struct MyInputHook_Stats {
+    uint64_t Count;
+    double MeanUs; // latencies, in microseconds (the percentiles are precise to ~3%)
+    double P50Us, P90Us, P99Us, P999Us, MaxUs;
+};
+
 extern "C" {
 // Log the string at 'data', of size 'size'.
 // If 'size' is negative, string is assumed to be null-terminated
@@ -114,6 +130,16 @@ MYINPUT_HOOK_DLL_DECLSPEC void MyInputHook_GetInState(int userIdx, int type, voi
 // state is corresponding MyInputHook_OutState_*, and size is its sizeof
 MYINPUT_HOOK_DLL_DECLSPEC void MyInputHook_SetOutState(int userIdx, int type, const void *state, int size);
 
+// Can be called from any thread
+// Gets the latency of gamepad index 'userIdx' reaching the stage 'type' (one of MyInputHook_StatsType),
+// since the dll was loaded or the stats were last reset
+// stats is MyInputHook_Stats, and size is its sizeof
+MYINPUT_HOOK_DLL_DECLSPEC void MyInputHook_GetStats(int userIdx, int type, MyInputHook_Stats *stats, int size);
+
+// Can be called from any thread
+// Resets the stats of all gamepads
+MYINPUT_HOOK_DLL_DECLSPEC void MyInputHook_ResetStats();
+
 // Must be called directly from a MyInputHook_PostInDllThread callback (not just from any callback in the dll thread)
 // Loads the given config.
 // NULL will reload the current config
@@ -128,4 +154,33 @@ MYINPUT_HOOK_DLL_DECLSPEC void MyInputHook_DisallowInjectChildren(bool disallow)
 // For internal testing purposes, will be removed or changed
 MYINPUT_HOOK_DLL_DECLSPEC int MyInputHook_InternalGetNumVirtual(char type);
 MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalIsVirtual(const wchar_t *path);
+
+// Must be called from dll thread
+// Starts recording the input events seen by the mappings into a trace at 'path' (NULL stops recording)
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalRecordTrace(const wchar_t *path);
+
+// Must be called from dll thread
+// Replays the trace at 'path' through the current config, writing the resulting state & output to 'outPath'
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalReplayTrace(const wchar_t *path, const wchar_t *outPath);
+
+// Must be called directly from a MyInputHook_PostInDllThread callback
+// Benchmarks the engine with the current config, writing the results (as json lines) to 'resultPath'
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalBenchmark(const wchar_t *resultPath);
+
+// Must be called from dll thread
+// Dumps the compiled cache of the current config to 'outPath', returning whether it's valid for its sources
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalDumpConfigCache(const wchar_t *outPath);
+
+// Must be called from dll thread
+// Compiles the config 'configPath' (relative to the configs directory) from text, without applying it, writing its
+// errors, mappings & per-phase timing to 'outPath', returning whether it has no errors
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalLintConfig(const wchar_t *configPath, const wchar_t *outPath);
+
+// Must be called from dll thread
+// Runs the hook's self-test 'name' (or all of them, if "all"), logging the results & returning whether they passed
+MYINPUT_HOOK_DLL_DECLSPEC bool MyInputHook_InternalSelfTest(const wchar_t *name);
+
+// Must be called from dll thread
+// Returns how many times the config was reloaded (e.g. due to changes in its files)
+MYINPUT_HOOK_DLL_DECLSPEC int MyInputHook_InternalGetNumReloads();
 }
@@ -0,0 +1,74 @@
+// Prints the live performance counters of hooked processes (see PerfCountersFormat.h)
+// Usage: myinput_perf [<pid>] [--watch] (with --watch, prints them every second, along with their change since the last print)
+#include "UtilsBase.h"
+#include "PerfCountersView.h"
+#include <Windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+static void PerfPrint(DWORD processId, std::map<DWORD, vector<uint64_t>> *prevValues) {
+    auto processes = PerfCountersOpenAll(processId);
+    if (processes.empty()) {
+        printf(processId ? "Process %lu isn't hooked (or is inaccessible)\n" : "No hooked processes found\n", processId);
+    }
+
+    std::map<DWORD, vector<uint64_t>> values;
+    for (auto &process : processes) {
+        printf("%ls (%lu):\n", process.Name.c_str(), process.ProcessId);
+
+        const vector<uint64_t> *prev = nullptr;
+        if (prevValues) {
+            auto prevIter = prevValues->find(process.ProcessId);
+            if (prevIter != prevValues->end()) {
+                prev = &prevIter->second;
+            }
+        }
+
+        auto &processValues = values[process.ProcessId];
+        for (int i = 0; i < process.View.NumCounters(); i++) {
+            uint64_t value = process.View.Get(i);
+            processValues.push_back(value);
+
+            printf("  %-22s %12llu", PerfCounterNames[i], (unsigned long long)value);
+            if (prev && i < (int)prev->size() && i != PerfCounter_DllQueueDepth) {
+                printf(" (+%llu)", (unsigned long long)(value - (*prev)[i]));
+            }
+            printf("\n");
+        }
+    }
+
+    if (prevValues) {
+        *prevValues = move(values);
+    }
+}
+
+int main(int argc, char **argv) {
+    DWORD processId = 0;
+    bool watch = false;
+    for (int i = 1; i < argc; i++) {
+        char *end;
+        if (!strcmp(argv[i], "--watch") || !strcmp(argv[i], "-w")) {
+            watch = true;
+        } else if (!processId && (processId = strtoul(argv[i], &end, 10)) != 0 && !*end) {
+            continue;
+        } else {
+            fprintf(stderr, "Usage: %s [<pid>] [--watch]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!watch) {
+        PerfPrint(processId, nullptr);
+        return 0;
+    }
+
+    std::map<DWORD, vector<uint64_t>> prevValues;
+    while (true) {
+        PerfPrint(processId, &prevValues);
+        printf("\n");
+        fflush(stdout);
+        Sleep(1000);
+    }
+}
@@ -8,6 +8,7 @@
 #include "ComUtils.h"
 #include "TestUtils.h"
 #include "UiTest.h"
+#include "UtilsTimerTest.h"
 
 #include <Windows.h>
 #include <hidusage.h>
@@ -17,6 +18,7 @@
 #include <SetupAPI.h>
 #include <cfgmgr32.h>
 #include <stdio.h>
+#include <fstream>
 #include <Shlwapi.h>
 #include <Dbt.h>
 #include <Xinput.h>
@@ -3064,6 +3066,60 @@ void ReadWmi(bool print, bool printAll) {
 #endif
 }
 
+// Calls 'func' in the hook's dll thread, waiting for it to return
+void CallInHookThread(function<void()> func) {
+    struct Request {
+        function<void()> Func;
+        HANDLE Done;
+    } request{move(func), CreateEventW(nullptr, true, false, nullptr)};
+
+    MyInputHook_PostInDllThread([](void *data) {
+        auto request = (Request *)data;
+        request->Func();
+        SetEvent(request->Done);
+    },
+                                &request);
+
+    WaitForSingleObject(request.Done, INFINITE);
+    CloseHandle(request.Done);
+}
+
+// Loads a config that includes another file, then edits the included file (in two writes, as some editors do),
+// checking that the config is reloaded exactly once
+bool TestConfigWatch(HMODULE hookLib) {
+    Path dir = PathCombine(PathGetDirName(PathGetDirName(PathGetModulePath(hookLib))), L"Configs");
+    Path mainPath = PathCombine(dir, L"_test_watch.ini");
+    Path includePath = PathCombine(dir, L"_test_watch_inc.ini");
+    std::ofstream(mainPath) << "!AutoReload = True\n!Include _test_watch_inc\nA : B\n";
+    std::ofstream(includePath) << "C : D\n";
+
+    int numReloads = 0;
+    CallInHookThread([] { MyInputHook_LoadConfig(L"_test_watch"); });
+    Sleep(500); // (let any reloads due to the writes above settle)
+    CallInHookThread([&] { numReloads = MyInputHook_InternalGetNumReloads(); });
+
+    {
+        std::ofstream include(includePath);
+        include << "C : D\n";
+        include.flush();
+        Sleep(20);
+        include << "E : F\n";
+    }
+
+    Sleep(1000);
+    int newNumReloads = 0;
+    CallInHookThread([&] { newNumReloads = MyInputHook_InternalGetNumReloads(); });
+    AssertEquals("config.watch.reloads", newNumReloads - numReloads, 1);
+    printf("Config watch test: %d reloads after an edit of an included file\n", newNumReloads - numReloads);
+
+    DeleteFileW(mainPath);
+    DeleteFileW(includePath);
+    for (const wchar_t *cacheExt : {L"x64.cache", L"Win32.cache"}) {
+        DeleteFileW(PathCombineExt(mainPath, cacheExt));
+    }
+    return newNumReloads - numReloads == 1;
+}
+
 void *gTestKey = nullptr;
 void *gTestVar = nullptr;
 
@@ -3144,6 +3200,15 @@ int main(int argc, char **argv) {
     Args args;
     BOOL_ARG(loadHook, "hook");
     STR_ARG(hookConfig, "hook-config");
+    STR_ARG(hookRecord, "hook-record");
+    STR_ARG(hookReplay, "hook-replay");
+    STR_ARG(hookReplayOut, "hook-replay-out");
+    STR_ARG(hookBench, "hook-bench");
+    STR_ARG(hookCacheDump, "hook-cache-dump");
+    STR_ARG(hookLint, "hook-lint");
+    STR_ARG(hookLintOut, "hook-lint-out");
+    BOOL_ARG(hookTestWatch, "hook-test-watch");
+    STR_ARG(hookSelfTest, "hook-self-test");
     BOOL_ARG(testWindow, "test-win");
     INT_ARG(testWindowCount, "test-win-count", 1);
     BOOL_ARG(visualizeWindow, "vis-win");
@@ -3213,6 +3278,7 @@ int main(int argc, char **argv) {
     BOOL_ARG(isChild, "child");
     BOOL_ARG(printProcessArgs, "print-process-args");
     BOOL_ARG(uiTest, "ui-test");
+    BOOL_ARG(testTimers, "test-timers");
 
     IsWow64Process(GetCurrentProcess(), &gWow64);
 
@@ -3220,6 +3286,12 @@ int main(int argc, char **argv) {
         testWindow = readDevice = gPrintGamepad = visualizeWindow = true;
     }
 
+    if (testTimers) {
+        string error = TimerWheelTest();
+        printf("Timer wheel test: %s\n", error.empty() ? "passed" : error.c_str());
+        return error.empty() ? 0 : 1;
+    }
+
     if (uiTest) {
         FreeConsole();
         DoUiTest(); // instead of everything else
@@ -3249,6 +3321,89 @@ int main(int argc, char **argv) {
         Alert(L"Hook not loaded in child!");
     }
 
+    if (hookLib && !hookRecord.empty()) {
+        MyInputHook_WaitInit();
+        MyInputHook_PostInDllThread([](void *data) {
+            MyInputHook_InternalRecordTrace((const wchar_t *)data);
+            delete[] (wchar_t *)data;
+        },
+                                    PathFromStr(hookRecord.c_str()).Take());
+    }
+
+    if (hookLib && !hookReplay.empty()) {
+        struct ReplayPaths {
+            Path In, Out;
+        };
+
+        if (hookReplayOut.empty()) {
+            hookReplayOut = hookReplay + ".txt";
+        }
+
+        MyInputHook_WaitInit();
+        MyInputHook_PostInDllThread([](void *data) {
+            auto paths = (ReplayPaths *)data;
+            MyInputHook_InternalReplayTrace(paths->In, paths->Out);
+            delete paths;
+        },
+                                    new ReplayPaths{PathFromStr(hookReplay.c_str()), PathFromStr(hookReplayOut.c_str())});
+    }
+
+    if (hookLib && !hookBench.empty()) {
+        MyInputHook_WaitInit();
+        MyInputHook_PostInDllThread([](void *data) {
+            MyInputHook_InternalBenchmark((const wchar_t *)data);
+            delete[] (wchar_t *)data;
+        },
+                                    PathFromStr(hookBench.c_str()).Take());
+    }
+
+    if (hookLib && !hookCacheDump.empty()) {
+        MyInputHook_WaitInit();
+        MyInputHook_PostInDllThread([](void *data) {
+            MyInputHook_InternalDumpConfigCache((const wchar_t *)data);
+            delete[] (wchar_t *)data;
+        },
+                                    PathFromStr(hookCacheDump.c_str()).Take());
+    }
+
+    if (hookLib && !hookLint.empty()) {
+        struct LintRequest {
+            Path Config, Out;
+            HANDLE Done;
+            bool Result;
+        };
+
+        if (hookLintOut.empty()) {
+            hookLintOut = hookLint + ".lint.txt";
+        }
+
+        LintRequest request{PathFromStr(hookLint.c_str()), PathFromStr(hookLintOut.c_str()), CreateEventW(nullptr, true, false, nullptr), false};
+        MyInputHook_WaitInit();
+        MyInputHook_PostInDllThread([](void *data) {
+            auto request = (LintRequest *)data;
+            request->Result = MyInputHook_InternalLintConfig(request->Config, request->Out);
+            SetEvent(request->Done);
+        },
+                                    &request);
+
+        WaitForSingleObject(request.Done, INFINITE);
+        CloseHandle(request.Done);
+        return request.Result ? 0 : 1; // (instead of everything else, so that scripts can fail on lint errors)
+    }
+
+    if (hookLib && !hookSelfTest.empty()) {
+        bool passed = false;
+        MyInputHook_WaitInit();
+        CallInHookThread([&] { passed = MyInputHook_InternalSelfTest(PathFromStr(hookSelfTest.c_str())); });
+        printf("Hook self-test %s: %s\n", hookSelfTest.c_str(), passed ? "passed" : "FAILED");
+        return passed ? 0 : 1;
+    }
+
+    if (hookLib && hookTestWatch) {
+        MyInputHook_WaitInit();
+        return TestConfigWatch(hookLib) ? 0 : 1;
+    }
+
 #if ZERO // TODO - create dll, or just don't bother
     if (hookTest) {
         MyInputHook_PostInDllThread([](void *) {
@@ -0,0 +1,207 @@
+// Decodes the event traces recorded by the hook (see EventTrace & EventTraceFormat.h),
+// printing their timeline and the latency of each stage of the input pipeline
+// Unlike the rest, this is portable - e.g. build via: c++ -std=c++20 -O2 MyInputTraceDecode.cpp -o myinput_trace_decode
+// Usage: myinput_trace_decode <trace> [timeline|latency] (prints both by default)
+#include "EventTraceFormat.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::deque;
+using std::map;
+using std::string;
+using std::vector;
+
+static const char *TraceKindName(EventTraceKind kind) {
+    switch (kind) {
+    case EventTraceKind::KeyboardIn:
+        return "keyboard";
+    case EventTraceKind::MouseButtonIn:
+        return "mouse_button";
+    case EventTraceKind::MouseMotionIn:
+        return "mouse_motion";
+    case EventTraceKind::MouseWheelIn:
+        return "mouse_wheel";
+    case EventTraceKind::CustomKeyIn:
+        return "custom_key";
+    case EventTraceKind::Mapping:
+        return "mapping";
+    case EventTraceKind::StateChange:
+        return "state_change";
+    case EventTraceKind::Flush:
+        return "flush";
+    case EventTraceKind::Report:
+        return "report";
+    case EventTraceKind::XUsbIoctl:
+        return "xusb_ioctl";
+    default:
+        return "unknown";
+    }
+}
+
+static bool TraceIsInput(EventTraceKind kind) { return kind >= EventTraceKind::KeyboardIn && kind <= EventTraceKind::CustomKeyIn; }
+
+static bool TraceRead(const char *path, EventTraceHeader *header, vector<EventTraceRecord> *records, uint64_t *lost) {
+    std::ifstream file(path, std::ios::binary);
+    if (file.fail() || !file.read((char *)header, sizeof(*header))) {
+        fprintf(stderr, "Failed to read trace: %s\n", path);
+        return false;
+    }
+
+    if (header->Magic != EventTraceHeader::MagicValue || header->Version != EventTraceHeader::CurrentVersion ||
+        header->RecordSize != sizeof(EventTraceRecord) || !header->Capacity || !header->Frequency) {
+        fprintf(stderr, "Not a supported trace: %s\n", path);
+        return false;
+    }
+
+    vector<EventTraceRecord> ring(header->Capacity);
+    file.read((char *)ring.data(), ring.size() * sizeof(EventTraceRecord));
+    if (file.fail()) {
+        fprintf(stderr, "Truncated trace: %s\n", path);
+        return false;
+    }
+
+    // (records older than the ring's capacity were overwritten; records being written during a crash are incomplete)
+    uint64_t count = header->Count;
+    uint64_t first = count > header->Capacity ? count - header->Capacity : 0;
+    *lost = first;
+    for (uint64_t i = first; i < count; i++) {
+        const EventTraceRecord &record = ring[i % header->Capacity];
+        if (record.Seq == i + 1) {
+            records->push_back(record);
+        } else {
+            (*lost)++;
+        }
+    }
+    return true;
+}
+
+static void TracePrintTimeline(const EventTraceHeader &header, const vector<EventTraceRecord> &records) {
+    uint64_t start = records.empty() ? 0 : records[0].Ticks;
+    uint64_t prev = start;
+    for (auto &record : records) {
+        double timeUs = (double)(int64_t)(record.Ticks - start) * 1e6 / header.Frequency;
+        double deltaUs = (double)(int64_t)(record.Ticks - prev) * 1e6 / header.Frequency;
+        prev = record.Ticks;
+
+        printf("%14.3f %+10.3f  %-12s", timeUs, deltaUs, TraceKindName(record.Kind));
+        if (record.User != EventTraceNoUser) {
+            printf(" user=%d", record.User + 1);
+        }
+        if (record.Key) {
+            printf(" key=0x%x", record.Key);
+        }
+        if (record.Slot) {
+            printf(" slot=%d", record.Slot);
+        }
+        printf(" value=%d", record.Value);
+        if (record.Value2) {
+            printf(" value2=%d", record.Value2);
+        }
+        if (record.Flags & EventTraceFlag_Down) {
+            printf(" down");
+        }
+        if (record.Flags & EventTraceFlag_Extended) {
+            printf(" extended");
+        }
+        if (record.Flags & EventTraceFlag_Horizontal) {
+            printf(" horizontal");
+        }
+        if (record.Flags & EventTraceFlag_Read) {
+            printf(" read");
+        }
+        printf("\n");
+    }
+}
+
+// Latencies between the stages of the pipeline:
+// input - the first input event of a batch processed by the dll thread (a batch ends with a flush)
+// flush - the end of the batch, publishing the new state of the users it changed
+// report/xusb - the first hid report or xusb state read of a user that includes the new state
+static void TracePrintLatency(const EventTraceHeader &header, const vector<EventTraceRecord> &records) {
+    struct Pending {
+        int Version;
+        uint64_t InputTicks; // (0 if the batch had no input - e.g. changed by a timer)
+        uint64_t FlushTicks;
+    };
+
+    map<string, vector<double>> stages;
+    deque<Pending> pending[EventTraceNoUser];
+    uint64_t batchInput = 0;
+
+    auto add = [&](const char *stage, uint64_t from, uint64_t to) {
+        stages[stage].push_back((double)(int64_t)(to - from) * 1e6 / header.Frequency);
+    };
+
+    for (auto &record : records) {
+        if (TraceIsInput(record.Kind)) {
+            if (!batchInput) {
+                batchInput = record.Ticks;
+            }
+        } else if (record.Kind == EventTraceKind::StateChange && record.User != EventTraceNoUser) {
+            pending[record.User].push_back({record.Value, batchInput, record.Ticks});
+        } else if (record.Kind == EventTraceKind::Flush) {
+            if (batchInput && record.Value) {
+                add("input_to_flush", batchInput, record.Ticks);
+            }
+            batchInput = 0;
+        } else if ((record.Kind == EventTraceKind::Report || (record.Kind == EventTraceKind::XUsbIoctl && (record.Flags & EventTraceFlag_Read))) &&
+                   record.User != EventTraceNoUser) {
+            bool report = record.Kind == EventTraceKind::Report;
+            auto &userPending = pending[record.User];
+            while (!userPending.empty() && userPending.front().Version <= record.Value) {
+                auto &entry = userPending.front();
+                add(report ? "flush_to_report" : "flush_to_xusb", entry.FlushTicks, record.Ticks);
+                if (entry.InputTicks) {
+                    add(report ? "input_to_report" : "input_to_xusb", entry.InputTicks, record.Ticks);
+                }
+                userPending.pop_front();
+            }
+        }
+    }
+
+    printf("%-18s %10s %12s %12s %12s %12s\n", "stage", "count", "p50_us", "p90_us", "p99_us", "max_us");
+    for (auto &[name, samples] : stages) {
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double fraction) {
+            return samples[std::min((size_t)(fraction * samples.size()), samples.size() - 1)];
+        };
+
+        printf("%-18s %10zu %12.3f %12.3f %12.3f %12.3f\n", name.c_str(), samples.size(),
+               percentile(0.5), percentile(0.9), percentile(0.99), percentile(1));
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *mode = argc >= 3 ? argv[2] : "";
+    bool timeline = !*mode || !strcmp(mode, "timeline");
+    bool latency = !*mode || !strcmp(mode, "latency");
+    if (argc < 2 || argc > 3 || !(timeline || latency)) {
+        fprintf(stderr, "Usage: %s <trace> [timeline|latency]\n", argv[0]);
+        return 2;
+    }
+
+    EventTraceHeader header;
+    vector<EventTraceRecord> records;
+    uint64_t lost = 0;
+    if (!TraceRead(argv[1], &header, &records, &lost)) {
+        return 1;
+    }
+
+    printf("%zu records (%llu lost)\n", records.size(), (unsigned long long)lost);
+    if (timeline) {
+        TracePrintTimeline(header, records);
+    }
+    if (latency) {
+        if (timeline) {
+            printf("\n");
+        }
+        TracePrintLatency(header, records);
+    }
+    return 0;
+}
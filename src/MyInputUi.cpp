@@ -3,6 +3,7 @@
 #include "ExeUi.h"
 #include "ConfigUi.h"
 #include "ConfigTestUi.h"
+#include "PerfUi.h"
 #include <Windows.h>
 
 DEFINE_ALERT_ON_ERROR()
@@ -11,17 +12,20 @@ class MyInputWindow : public ModalWindow, public BaseUiIntf {
     ExePanel *mExePanel = nullptr;
     ConfigPanel *mConfigPanel = nullptr;
     ConfigTestPanel *mTestPanel = nullptr;
+    PerfPanel *mPerfPanel = nullptr;
     UnionTab *mTab = nullptr;
 
     Control *OnCreate() override {
         mExePanel = New<ExePanel>(this);
         mConfigPanel = New<ConfigPanel>(mExePanel);
         mTestPanel = New<ConfigTestPanel>(mConfigPanel);
+        mPerfPanel = New<PerfPanel>();
 
         mTab = New<UnionTab>();
         mTab->Add(L"Executables", mExePanel);
         mTab->Add(L"Configs", mConfigPanel);
         mTab->Add(L"Test Config", mTestPanel);
+        mTab->Add(L"Counters", mPerfPanel);
 
         ProcessArgs();
         return mTab;
@@ -90,9 +90,7 @@ bool ThreadPoolNotificationUnregister(void *handle, bool wait) { return GThreadP
 // A and W share same exact implementation, though just to be safe - I've kept each calling the right real function
 HDEVNOTIFY WINAPI RegisterDeviceNotification_Hook(HANDLE hRecepient, LPVOID NotificationFilter, DWORD Flags,
                                                   decltype(RegisterDeviceNotificationA) RegisterDeviceNotification_Real) {
-    if (G.ApiDebug) {
-        LOG << "RegisterDeviceNotification " << NotificationFilter << " " << Flags << END;
-    }
+    LOG_API_DEBUG << "RegisterDeviceNotification " << NotificationFilter << " " << Flags << END;
 
     if (Flags & DEVICE_NOTIFY_SERVICE_HANDLE) {
         LOG_ERR << "Unsupported service device notification" << END;
@@ -186,9 +184,7 @@ HDEVNOTIFY WINAPI RegisterDeviceNotificationW_Hook(HANDLE hRecepient, LPVOID Not
 }
 
 BOOL WINAPI UnregisterDeviceNotification_Hook(HDEVNOTIFY Handle) {
-    if (G.ApiDebug) {
-        LOG << "UnregisterDeviceNotification" << END;
-    }
+    LOG_API_DEBUG << "UnregisterDeviceNotification" << END;
 
     if (ThreadPoolNotificationUnregister(Handle, false)) {
         return TRUE;
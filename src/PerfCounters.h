@@ -0,0 +1,43 @@
+#pragma once
+#include "UtilsBase.h"
+#include "LogUtils.h"
+#include "PerfCountersFormat.h"
+#include <Windows.h>
+
+// Maintains this process's performance counters page (see PerfCountersFormat.h), which others can read without
+// any round trips to us. Counts into a local block until Init (or if the shared one couldn't be created)
+class PerfCounters {
+    PerfCountersBlock mLocal;
+    PerfCountersBlock *mBlock = &mLocal;
+
+public:
+    // (called from dllmain, before any other threads of ours exist)
+    void Init() {
+        DWORD processId = GetCurrentProcessId();
+        wstring name = PerfCountersNamePrefix + std::to_wstring(processId);
+
+        // (the mapping is kept open for the process's lifetime - it's what keeps the name alive for readers)
+        HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(PerfCountersBlock), name.c_str());
+        void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, sizeof(PerfCountersBlock)) : nullptr;
+        if (!view) {
+            LOG_W << "ERROR: Failed to create performance counters page" << END;
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            return;
+        }
+
+        PerfCountersBlock *block = (PerfCountersBlock *)view;
+        memcpy(block->Counters, mLocal.Counters, sizeof(block->Counters));
+        block->Header.Version = PerfCountersHeader::CurrentVersion;
+        block->Header.NumCounters = PerfCounter_Count;
+        block->Header.ProcessId = processId;
+        std::atomic_ref(block->Header.Magic).store(PerfCountersHeader::MagicValue, std::memory_order_release);
+        mBlock = block;
+    }
+
+    // May be called from any thread
+    void Add(PerfCounter counter, int64_t delta = 1) {
+        std::atomic_ref(mBlock->Counters[counter]).fetch_add((uint64_t)delta, std::memory_order_relaxed);
+    }
+} GPerfCounters;
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+// Format of the performance counters page - a block of shared memory per hooked process, updated live by the hook
+// (shared by the hook, which writes it, and the ui & MyInputPerf.cpp, which map it read-only)
+// The block is named PerfCountersNamePrefix followed by the process id (in decimal).
+// New counters are only ever appended - readers show the first min(NumCounters, PerfCounter_Count) they know of.
+// Version changes only on incompatible changes
+
+enum PerfCounter : uint32_t {
+    PerfCounter_KeyboardEvents,    // (events processed, per source)
+    PerfCounter_MouseButtonEvents, //
+    PerfCounter_MouseMotionEvents, //
+    PerfCounter_MouseWheelEvents,  //
+    PerfCounter_CustomKeyEvents,   //
+    PerfCounter_MappingsFired,
+    PerfCounter_TimerTicks,
+    PerfCounter_HidReports,        // produced for the app's hid reads
+    PerfCounter_HidReportsDropped, // as the app didn't read them in time (beyond its MaxBuffers)
+    PerfCounter_RawInputs,         // posted to the app's windows
+    PerfCounter_RawInputsDropped,  // as the app didn't read them in time
+    PerfCounter_LogRecordsDropped,
+    PerfCounter_DllQueueDepth, // (current value, not a count)
+
+    PerfCounter_Count
+};
+
+constexpr const char *PerfCounterNames[PerfCounter_Count] = {
+    "keyboard_events",
+    "mouse_button_events",
+    "mouse_motion_events",
+    "mouse_wheel_events",
+    "custom_key_events",
+    "mappings_fired",
+    "timer_ticks",
+    "hid_reports",
+    "hid_reports_dropped",
+    "raw_inputs",
+    "raw_inputs_dropped",
+    "log_records_dropped",
+    "dll_queue_depth",
+};
+
+constexpr const wchar_t *PerfCountersNamePrefix = L"Local\\MyInputPerf.";
+
+#pragma pack(push, 1)
+struct PerfCountersHeader {
+    static constexpr uint32_t MagicValue = 0x4350594d; // "MYPC"
+    static constexpr uint32_t CurrentVersion = 1;
+    static constexpr uint32_t MaxCounters = 120;
+
+    uint32_t Magic = 0; // written last, once the block is initialized
+    uint32_t Version = CurrentVersion;
+    uint32_t NumCounters = PerfCounter_Count;
+    uint32_t ProcessId = 0;
+    uint8_t Reserved[48] = {};
+};
+
+struct PerfCountersBlock {
+    PerfCountersHeader Header;
+    uint64_t Counters[PerfCountersHeader::MaxCounters] = {}; // (updated atomically)
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PerfCountersHeader) == 64 && sizeof(PerfCountersBlock) == 1024);
@@ -0,0 +1,83 @@
+#pragma once
+#include "UtilsBase.h"
+#include "PerfCountersFormat.h"
+#include <Windows.h>
+#include <TlHelp32.h>
+
+// A read-only view of a hooked process's performance counters page (see PerfCountersFormat.h)
+class PerfCountersView {
+    const PerfCountersBlock *mBlock = nullptr;
+
+public:
+    PerfCountersView() {}
+    PerfCountersView(const PerfCountersView &) = delete;
+    PerfCountersView(PerfCountersView &&other) : mBlock(other.mBlock) { other.mBlock = nullptr; }
+    ~PerfCountersView() { Close(); }
+
+    // (fails if the process isn't hooked, or if its hook is of an incompatible version)
+    bool Open(DWORD processId) {
+        Close();
+
+        wstring name = PerfCountersNamePrefix + std::to_wstring(processId);
+        HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, false, name.c_str());
+        if (!mapping) {
+            return false;
+        }
+
+        mBlock = (const PerfCountersBlock *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(PerfCountersBlock));
+        CloseHandle(mapping); // (kept open by the view)
+
+        if (mBlock && (std::atomic_ref((uint32_t &)mBlock->Header.Magic).load(std::memory_order_acquire) != PerfCountersHeader::MagicValue ||
+                       mBlock->Header.Version != PerfCountersHeader::CurrentVersion || mBlock->Header.ProcessId != processId)) {
+            Close();
+        }
+        return mBlock != nullptr;
+    }
+
+    void Close() {
+        if (mBlock) {
+            UnmapViewOfFile(mBlock);
+            mBlock = nullptr;
+        }
+    }
+
+    bool IsOpen() const { return mBlock != nullptr; }
+
+    int NumCounters() const { return (int)min<uint32_t>(mBlock->Header.NumCounters, PerfCounter_Count); }
+
+    uint64_t Get(int counter) const {
+        return std::atomic_ref((uint64_t &)mBlock->Counters[counter]).load(std::memory_order_relaxed);
+    }
+};
+
+struct PerfCountersProcess {
+    DWORD ProcessId;
+    wstring Name;
+    PerfCountersView View;
+};
+
+// Opens the counters of all hooked processes we can access, or just of 'processId', if given
+vector<PerfCountersProcess> PerfCountersOpenAll(DWORD processId = 0) {
+    vector<PerfCountersProcess> processes;
+
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return processes;
+    }
+
+    PROCESSENTRY32W entry;
+    entry.dwSize = sizeof(entry);
+    for (bool ok = Process32FirstW(snapshot, &entry); ok; ok = Process32NextW(snapshot, &entry)) {
+        if (processId && entry.th32ProcessID != processId) {
+            continue;
+        }
+
+        PerfCountersView view;
+        if (view.Open(entry.th32ProcessID)) {
+            processes.push_back(PerfCountersProcess{entry.th32ProcessID, entry.szExeFile, move(view)});
+        }
+    }
+
+    CloseHandle(snapshot);
+    return processes;
+}
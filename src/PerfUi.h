@@ -0,0 +1,84 @@
+#pragma once
+#include "CommonUi.h"
+#include "PerfCountersView.h"
+#include <map>
+
+class PerfScrollPanel : public ScrollPanel {
+    Label *mCountersLbl = nullptr;
+    std::map<DWORD, vector<uint64_t>> mPrevValues;
+
+public:
+    using ScrollPanel::ScrollPanel;
+    ScrollType GetScrollType() override { return ScrollType::Vert; }
+
+    Control *OnCreate() override {
+        mCountersLbl = New<Label>();
+        return mCountersLbl;
+    }
+
+    void Update() {
+        std::map<DWORD, vector<uint64_t>> values;
+        wstringstream text;
+        for (auto &process : PerfCountersOpenAll()) {
+            auto prevIter = mPrevValues.find(process.ProcessId);
+            auto &processValues = values[process.ProcessId];
+
+            text << process.Name << L" (" << process.ProcessId << L"):\n";
+            for (int i = 0; i < process.View.NumCounters(); i++) {
+                uint64_t value = process.View.Get(i);
+                processValues.push_back(value);
+
+                text << L"    " << PerfCounterNames[i] << L": " << value;
+                if (prevIter != mPrevValues.end() && i < (int)prevIter->second.size() && i != PerfCounter_DllQueueDepth) {
+                    text << L" (+" << value - prevIter->second[i] << L"/s)";
+                }
+                text << L"\n";
+            }
+            text << L"\n";
+        }
+
+        mPrevValues = move(values);
+
+        wstring str = text.str();
+        mCountersLbl->SetText(str.empty() ? L"No hooked processes found" : str.c_str());
+    }
+
+    void Clear() {
+        mPrevValues.clear();
+    }
+};
+
+// Shows the live performance counters of all hooked processes
+class PerfPanel : public Panel {
+    PerfScrollPanel *mCounters = nullptr;
+    Timer *mTimer = nullptr;
+
+    Control *OnCreate() override {
+        mCounters = New<PerfScrollPanel>();
+        mTimer = New<Timer>(1, false, [this] { mCounters->Update(); });
+
+        auto layout = New<Layout>(true);
+        layout->AddTop(New<Label>(L"Performance counters of running hooked processes (and their change per second):"));
+        layout->AddTop(New<Separator>());
+        layout->AddRemaining(mCounters);
+        return layout;
+    }
+
+    void OnActivate(bool activate, void *root, void *prev) override {
+        if (root) // only when switching tabs
+        {
+            if (activate) {
+                mCounters->Clear();
+                mCounters->Update();
+                mTimer->Start();
+            } else {
+                mTimer->End();
+            }
+        }
+    }
+
+public:
+    using Panel::Panel;
+
+    Control *InitialFocus() override { return mCounters; }
+};
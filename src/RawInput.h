@@ -26,9 +26,7 @@ DeviceIntf *GetCustomHandleDevice(HANDLE handle) {
 }
 
 UINT WINAPI GetRawInputDeviceList_Hook(PRAWINPUTDEVICELIST pRawInputDeviceList, PUINT puiNumDevices, UINT cbSize) {
-    if (G.ApiDebug) {
-        LOG << "GetRawInputDeviceList ()" << END;
-    }
+    LOG_API_DEBUG << "GetRawInputDeviceList ()" << END;
 
     user_mask_t usersMask;
     int usersCount = ImplGetUsers(&usersMask, DEVICE_NODE_TYPE_HID);
@@ -121,9 +119,7 @@ static UINT GetRawCustomDeviceInfo(UINT uiCommand, LPVOID pData, PUINT pcbSize,
 }
 
 UINT WINAPI GetRawInputDeviceInfoA_Hook(HANDLE hDevice, UINT uiCommand, LPVOID pData, PUINT pcbSize) {
-    if (G.ApiDebug) {
-        LOG << "GetRawInputDeviceInfoA (" << (uintptr_t)hDevice << ", " << uiCommand << ")" << END;
-    }
+    LOG_API_DEBUG << "GetRawInputDeviceInfoA (" << (uintptr_t)hDevice << ", " << uiCommand << ")" << END;
 
     DeviceIntf *device = GetCustomHandleDevice(hDevice);
     if (device && device->HasHid()) {
@@ -134,9 +130,7 @@ UINT WINAPI GetRawInputDeviceInfoA_Hook(HANDLE hDevice, UINT uiCommand, LPVOID p
 }
 
 UINT WINAPI GetRawInputDeviceInfoW_Hook(HANDLE hDevice, UINT uiCommand, LPVOID pData, PUINT pcbSize) {
-    if (G.ApiDebug) {
-        LOG << "GetRawInputDeviceInfoW (" << (uintptr_t)hDevice << ", " << uiCommand << ")" << END;
-    }
+    LOG_API_DEBUG << "GetRawInputDeviceInfoW (" << (uintptr_t)hDevice << ", " << uiCommand << ")" << END;
 
     DeviceIntf *device = GetCustomHandleDevice(hDevice);
     if (device && device->HasHid()) {
@@ -147,27 +141,19 @@ UINT WINAPI GetRawInputDeviceInfoW_Hook(HANDLE hDevice, UINT uiCommand, LPVOID p
 }
 
 UINT WINAPI GetRawInputData_Hook(HRAWINPUT hRawInput, UINT uiCommand, LPVOID pData, PUINT pCbSize, UINT cbSizeHeader) {
-    if (G.ApiTrace) {
-        LOG << "GetRawInputData (" << hRawInput << "," << uiCommand << ")" << END;
-    }
+    LOG_API_TRACE << "GetRawInputData (" << hRawInput << "," << uiCommand << ")" << END;
 
     WORD handleHigh = GetOurHandle(hRawInput);
     if (cbSizeHeader == sizeof(RAWINPUTHEADER) && handleHigh) {
         UINT count;
         if (GRawInputRegMouse.Read(handleHigh, uiCommand, pData, pCbSize, &count)) {
-            if (G.ApiTrace) {
-                LOG << "GetRawInputData read mouse data" << END;
-            }
+            LOG_API_TRACE << "GetRawInputData read mouse data" << END;
             return count;
         } else if (GRawInputRegGamepad.Read(handleHigh, uiCommand, pData, pCbSize, &count)) {
-            if (G.ApiTrace) {
-                LOG << "GetRawInputData read gamepad data" << END;
-            }
+            LOG_API_TRACE << "GetRawInputData read gamepad data" << END;
             return count;
         } else if (GRawInputRegKeyboard.Read(handleHigh, uiCommand, pData, pCbSize, &count)) {
-            if (G.ApiTrace) {
-                LOG << "GetRawInputData read keyboard data" << END;
-            }
+            LOG_API_TRACE << "GetRawInputData read keyboard data" << END;
             return count;
         }
     }
@@ -199,9 +185,7 @@ void FixupRawInputBufferData(UINT *pResult, PRAWINPUT pData, UINT *pSize, UINT r
 UINT WINAPI GetRawInputBuffer_Hook(PRAWINPUT pData, PUINT pCbSize, UINT cbSizeHeader) {
     // can't rely on GetRawInputBuffer_Real - must simulate it
     if (cbSizeHeader == sizeof(RAWINPUTHEADER) && pCbSize) {
-        if (G.ApiTrace) {
-            LOG << "GetRawInputBuffer () custom impl." << END;
-        }
+        LOG_API_TRACE << "GetRawInputBuffer () custom impl." << END;
 
         enum { PM_QS_OUR_WM_INPUT = (QS_RAWINPUT | QS_POSTMESSAGE) << 16 };
 
@@ -305,9 +289,7 @@ BOOL WINAPI RegisterRawInputDevices_Hook(PCRAWINPUTDEVICE pRawInputDevices, UINT
 
         for (UINT i = 0; i < uiNumDevices; i++) {
             auto &instr = pRawInputDevices[i];
-            if (G.ApiDebug) {
-                LOG << "RegisterRawInputDevices - " << instr.usUsagePage << ", " << instr.usUsage << ", " << instr.dwFlags << END;
-            }
+            LOG_API_DEBUG << "RegisterRawInputDevices - " << instr.usUsagePage << ", " << instr.usUsage << ", " << instr.dwFlags << END;
 
             if (instr.usUsagePage == HID_USAGE_PAGE_GENERIC &&
                 (instr.usUsage == HID_USAGE_GENERIC_KEYBOARD || instr.usUsage == HID_USAGE_GENERIC_MOUSE)) {
@@ -355,9 +337,7 @@ bool TryGetRegisteredRawInputDevice(RAWINPUTDEVICE &instr, int usage, const RawI
 }
 
 UINT WINAPI GetRegisteredRawInputDevices_Hook(PRAWINPUTDEVICE pRawInputDevices, PUINT puiNumDevices, UINT cbSize) {
-    if (G.ApiDebug) {
-        LOG << "GetRegisteredRawInputDevices" << END;
-    }
+    LOG_API_DEBUG << "GetRegisteredRawInputDevices" << END;
 
     if (cbSize == sizeof(RAWINPUTDEVICE) && puiNumDevices) {
         auto keyInfo = GRawInputRegKeyboard.GetRegisteredInfo();
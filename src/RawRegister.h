@@ -1,5 +1,6 @@
 #pragma once
 #include "Impl.h"
+#include "PerfCounters.h"
 #include "Header.h"
 
 UniqueLog gUniqLogRawInputRegister;
@@ -184,10 +185,9 @@ protected:
             }
 
             if (BufDeque->size() >= MaxDequeSize) {
-                if (G.ApiTrace) {
-                    LOG << "Too many raw input messages to " << window << END;
-                }
+                LOG_API_TRACE << "Too many raw input messages to " << window << END;
                 BufDeque->pop_front();
+                GPerfCounters.Add(PerfCounter_RawInputsDropped);
 
                 HandleHighFront++;
                 if (HandleHighFront == HandleHighEnd) {
@@ -200,16 +200,13 @@ protected:
             }
         }
 
-        if (G.ApiTrace) {
-            LOG << "Pushing Raw input data for " << (HRAWINPUT)MakeOurHandle(handleHigh) << " to " << window << END;
-        }
+        LOG_API_TRACE << "Pushing Raw input data for " << (HRAWINPUT)MakeOurHandle(handleHigh) << " to " << window << END;
         PostMessageW(window, WM_INPUT, wparam, (LPARAM)MakeOurHandle(handleHigh));
+        GPerfCounters.Add(PerfCounter_RawInputs);
     }
 
     void EnqueueNotify(HWND window, HANDLE handle, bool added) {
-        if (G.ApiTrace) {
-            LOG << "Pushing device change notify to " << window << END;
-        }
+        LOG_API_TRACE << "Pushing device change notify to " << window << END;
         PostMessageW(window, WM_INPUT_DEVICE_CHANGE, added ? GIDC_ARRIVAL : GIDC_REMOVAL, (LPARAM)handle);
     }
 
@@ -257,9 +254,7 @@ public:
         }
 
         if (!bufDeque || bufDeque->empty() || handleDelta < 0) {
-            if (G.Debug) {
-                LOG << "Read of old or unknown raw input handle" << END;
-            }
+            LOG_DEBUG << "Read of old or unknown raw input handle" << END;
             return false;
         }
 
@@ -427,9 +422,11 @@ class RawInputRegGamepad : public RawInputReg {
         rawInput->header.hDevice = GetCustomDeviceHandle(idx);
         rawInput->header.wParam = foreground ? RIM_INPUT : RIM_INPUTSINK;
         rawInput->data.hid.dwCount = 1;
-        rawInput->data.hid.dwSizeHid = device->CopyInputTo(rawInput->data.hid.bRawData);
+        ImplStateStamp stamp;
+        rawInput->data.hid.dwSizeHid = device->CopyInputTo(rawInput->data.hid.bRawData, &stamp);
 
         Enqueue(window, rawInput->header.wParam, move(buffer));
+        GImplLatency[idx].OnDelivered(MyInputHook_Stats_RawInput, stamp);
     }
 
     void OnNotifyMessage(ImplUser *user, bool added) {
@@ -454,9 +451,7 @@ public:
         if (gUniqLogRawInputRegister) {
             LOG << "Listening to device events via RawInput API" << END;
         }
-        if (G.ApiDebug) {
-            LOG << "RegisterRawInputGamepad - registering for " << window << END;
-        }
+        LOG_API_DEBUG << "RegisterRawInputGamepad - registering for " << window << END;
 
         RawInputRegBase::Register(window, flags, [this] {
             for (int i = 0; i < IMPL_MAX_USERS; i++) {
@@ -488,9 +483,7 @@ public:
     }
 
     void Unregister(UINT flags) {
-        if (G.ApiDebug) {
-            LOG << "RegisterRawInputGamepad - unregistering" << END;
-        }
+        LOG_API_DEBUG << "RegisterRawInputGamepad - unregistering" << END;
 
         RawInputRegBase::Unregister(flags, [this] {
             for (int i = 0; i < IMPL_MAX_USERS; i++) {
@@ -567,19 +560,19 @@ void RawInputUpdateMouse() {
     GRawInputRegMouse.UpdateRealRegister(false);
 }
 
-void ProcessMouseWheel(RAWMOUSE &mouse, int mask, bool horiz, DWORD time, ChangedMask *changes) {
+void ProcessMouseWheel(RAWMOUSE &mouse, int mask, bool horiz, hrtime_t time, ChangedMask *changes) {
     if ((mouse.usButtonFlags & mask) && ImplMouseWheelHook(horiz, (SHORT)mouse.usButtonData, time, changes)) {
         mouse.usButtonFlags &= ~mask;
     }
 }
 
-void ProcessMouseButton(RAWMOUSE &mouse, int mask, int key, bool down, DWORD time, ChangedMask *changes) {
+void ProcessMouseButton(RAWMOUSE &mouse, int mask, int key, bool down, hrtime_t time, ChangedMask *changes) {
     if ((mouse.usButtonFlags & mask) && ImplProcessMouseButton(key, down, time, changes)) {
         mouse.usButtonFlags &= ~mask;
     }
 }
 
-void ProcessRawInput(HRAWINPUT handle, DWORD time) {
+void ProcessRawInput(HRAWINPUT handle, hrtime_t time) {
     RAWINPUT input;
     UINT inputSize = sizeof(input);
     if ((int)GetRawInputData_Real(handle, RID_INPUT, &input, &inputSize, sizeof(RAWINPUTHEADER)) >= 0 &&
@@ -600,9 +593,7 @@ void ProcessRawInput(HRAWINPUT handle, DWORD time) {
             mouse.ulExtraInformation = (ULONG)GAppExtraInfo.GetOrig(mouse.ulExtraInformation);
         }
 
-        if (G.Trace) {
-            LOG << "raw mouse event: " << mouse.lLastX << "," << mouse.lLastY << ", " << mouse.usButtonFlags << ", " << injected << END;
-        }
+        LOG_TRACE << "raw mouse event: " << mouse.lLastX << "," << mouse.lLastY << ", " << mouse.usButtonFlags << ", " << injected << END;
 
         if (!locallyInjected) {
             ChangedMask changes;
@@ -697,7 +688,7 @@ void ProcessRawDeviceChange(HANDLE handle, bool added) {
 LRESULT CALLBACK DllWindowProc(HWND win, UINT msg, WPARAM w, LPARAM l) {
     switch (msg) {
     case WM_INPUT:
-        ProcessRawInput((HRAWINPUT)l, GetMessageTime());
+        ProcessRawInput((HRAWINPUT)l, GHrClock.Now());
         break;
 
     case WM_INPUT_DEVICE_CHANGE:
@@ -17,21 +17,36 @@ static_assert(CHAR_BIT * sizeof(user_mask_t) >= IMPL_MAX_USERS);
 
 #pragma pack(push, 1) // just because it's often followed by more uint8_t's
 struct ImplBoolOutput {
-    unsigned Slots = 0;
-    slot_t NumSlots = 0;
+    unsigned Slots = 0;     // bit per pressed slot
+    unsigned Allocated = 0; // bit per allocated slot (once all are, the last slot is shared, and so is never freed)
 
-    slot_t AllocSlot() {
-        if (NumSlots > IMPL_MAX_SLOTS) {
+    static slot_t FirstFreeSlot(unsigned allocated, bool *exhausted) {
+        if (allocated == ~0u) {
+            if (exhausted) {
+                *exhausted = true;
+            }
             return IMPL_MAX_SLOTS; // better than failing
         }
 
-        return NumSlots++;
+        return (slot_t)std::countr_one(allocated);
     }
 
-    void UndoAllocSlot() { NumSlots--; }
+    slot_t AllocSlot(bool *exhausted = nullptr) {
+        slot_t slot = FirstFreeSlot(Allocated, exhausted);
+        Allocated |= 1u << slot;
+        return slot;
+    }
+
+    void FreeSlot(slot_t slot) {
+        if (slot < IMPL_MAX_SLOTS) {
+            Allocated &= ~(1u << slot);
+        }
+    }
+
+    bool IsAllocated(slot_t slot) const { return slot <= IMPL_MAX_SLOTS && ((Allocated >> slot) & 1); }
 
     void Reset() {
-        NumSlots = Slots = 0;
+        Allocated = Slots = 0;
     }
 
     bool Get() { return Slots != 0; }
@@ -46,36 +61,57 @@ struct ImplButtonState {
     void Reset() { Pressed.Reset(); }
 };
 
-template <double Default>
-struct ImplDoubleOutput {
-    double *Slots = nullptr;
-    double Combined = Default;
-    double Get() { return Combined; }
+#define IMPL_NUM_SLOTS (IMPL_MAX_SLOTS + 1)
+
+// max of the strengths of all slots, kept in a tournament tree
+struct ImplStrengthOutput {
+    double Tree[2 * IMPL_NUM_SLOTS] = {}; // Tree[1] is the root, the slots are the leaves
 
-    bool InitIfNeeded(ImplBoolOutput &boolOutput, slot_t slot) {
-        if (slot >= boolOutput.NumSlots) {
-            return false;
+    double Get() { return Tree[1]; }
+
+    void Set(slot_t slot, double value) {
+        int i = IMPL_NUM_SLOTS + slot;
+        Tree[i] = value;
+        for (i >>= 1; i > 0; i >>= 1) {
+            Tree[i] = max(Tree[2 * i], Tree[2 * i + 1]);
         }
+    }
 
-        if (!Slots) {
-            int numDoubles = boolOutput.NumSlots;
-            Slots = new double[numDoubles];
-            for (int i = 0; i < numDoubles; i++) {
-                Slots[i] = Default;
-            }
+    void Reset() { *this = {}; }
+};
+
+// product of the strengths of all slots, kept as a running product of the non-zero ones
+struct ImplModifierOutput {
+    double Slots[IMPL_NUM_SLOTS];
+    double Product;
+    slot_t NumZero;
+
+    double Get() { return NumZero ? 0.0 : Product; }
+
+    void Set(slot_t slot, double value) {
+        double &oldValue = Slots[slot];
+        if (oldValue == 0) {
+            NumZero--;
+        } else {
+            Product /= oldValue;
+        }
+
+        oldValue = value;
+        if (value == 0) {
+            NumZero++;
+        } else {
+            Product *= value;
         }
-        return true;
     }
 
     void Reset() {
-        Combined = Default;
-        delete[] Slots;
-        Slots = nullptr;
+        std::fill(std::begin(Slots), std::end(Slots), 1.0);
+        Product = 1.0;
+        NumZero = 0;
     }
-};
 
-using ImplStrengthOutput = ImplDoubleOutput<0.0>;
-using ImplModifierOutput = ImplDoubleOutput<1.0>;
+    ImplModifierOutput() { Reset(); }
+};
 
 struct ImplTriggerState : public ImplButtonState {
     ImplStrengthOutput PressedStrength;
@@ -180,8 +216,8 @@ struct ImplMotionState {
     ImplMotionDimState X, Y, Z;    // value is metres
     ImplMotionDimState RX, RY, RZ; // value is radians
     UserTimer Timer;
-    DWORD PrevTime = 0;
-    DWORD IdleTime = 0;
+    hrtime_t PrevTime = 0;
+    hrtime_t IdleTime = 0;
 
     Vector3 XAxis() {
         auto [sy, cy] = SinCos(RY.NewValue);
@@ -216,15 +252,110 @@ struct ImplFeedbackState {
     double LowRumble = 0, HighRumble = 0;
 };
 
-struct ImplState {
-    mutable mutex Mutex;
+// the output-relevant part of ImplState, as seen by threads reading the device state
+struct ImplButtonSnapshot {
+    bool State = false;
+};
+
+struct ImplTriggerSnapshot : public ImplButtonSnapshot {
+    double Value = 0;
+
+    uint8_t Value8() const { return (uint8_t)nearbyint(Value * 0xff); }
+};
+
+struct ImplAxisSnapshot {
+    double Value = 0;
+
+    int8_t Value8() const { return (int8_t)nearbyint(Value * 0x7f); }
+    int16_t Value16() const { return (int16_t)nearbyint(Value * 0x7fff); }
+};
+
+struct ImplAxesSnapshot {
+    ImplAxisSnapshot X, Y;
+};
+
+struct ImplMotionDimSnapshot {
+    double Speed = 0;
+    double GAccel = 0;
+};
+
+struct ImplMotionSnapshot {
+    ImplMotionDimSnapshot X, Y, Z, RX, RY, RZ;
+};
+
+// identifies a published state - by the time of the input that changed it, and its version
+struct ImplStateStamp {
+    hrtime_t Time = 0;
+    int Version = 0;
+};
+
+struct ImplStateSnapshot {
+    ImplButtonSnapshot A, B, X, Y, LB, RB, L, R, DL, DR, DU, DD, Start, Back, Guide, Extra;
+    ImplTriggerSnapshot LT, RT;
+    ImplAxesSnapshot LA, RA;
+    ImplMotionSnapshot Motion;
+    hrtime_t Time = 0;
+    int Version = 0;
+
+    ImplStateStamp Stamp() const { return ImplStateStamp{Time, Version}; }
+};
+
+// the dll thread's part of ImplState (copyable - e.g. to save it around replays)
+struct ImplStateData {
     ImplButtonState A, B, X, Y, LB, RB, L, R, DL, DR, DU, DD, Start, Back, Guide, Extra;
     ImplTriggerState LT, RT;
     ImplAxesState LA, RA;
     ImplMotionState Motion;
     ImplFeedbackState Feedback;
-    DWORD Time = 0;
+    hrtime_t Time = 0;
     int Version = 0;
+};
+
+struct ImplState : public ImplStateData {
+    SeqLocked<ImplStateSnapshot> Snapshot; // written on the dll thread, read by any thread
+
+    void Publish() {
+        ImplStateSnapshot snap;
+        snap.A.State = A.State;
+        snap.B.State = B.State;
+        snap.X.State = X.State;
+        snap.Y.State = Y.State;
+        snap.LB.State = LB.State;
+        snap.RB.State = RB.State;
+        snap.L.State = L.State;
+        snap.R.State = R.State;
+        snap.DL.State = DL.State;
+        snap.DR.State = DR.State;
+        snap.DU.State = DU.State;
+        snap.DD.State = DD.State;
+        snap.Start.State = Start.State;
+        snap.Back.State = Back.State;
+        snap.Guide.State = Guide.State;
+        snap.Extra.State = Extra.State;
+        snap.LT.State = LT.State;
+        snap.LT.Value = LT.Value;
+        snap.RT.State = RT.State;
+        snap.RT.Value = RT.Value;
+        snap.LA.X.Value = LA.X.Value;
+        snap.LA.Y.Value = LA.Y.Value;
+        snap.RA.X.Value = RA.X.Value;
+        snap.RA.Y.Value = RA.Y.Value;
+        snap.Motion.X.Speed = Motion.X.Speed;
+        snap.Motion.X.GAccel = Motion.X.GAccel;
+        snap.Motion.Y.Speed = Motion.Y.Speed;
+        snap.Motion.Y.GAccel = Motion.Y.GAccel;
+        snap.Motion.Z.Speed = Motion.Z.Speed;
+        snap.Motion.Z.GAccel = Motion.Z.GAccel;
+        snap.Motion.RX.Speed = Motion.RX.Speed;
+        snap.Motion.RX.GAccel = Motion.RX.GAccel;
+        snap.Motion.RY.Speed = Motion.RY.Speed;
+        snap.Motion.RY.GAccel = Motion.RY.GAccel;
+        snap.Motion.RZ.Speed = Motion.RZ.Speed;
+        snap.Motion.RZ.GAccel = Motion.RZ.GAccel;
+        snap.Time = Time;
+        snap.Version = Version;
+        Snapshot.Write(snap);
+    }
 
     void Reset() {
         A.Reset();
@@ -275,15 +406,93 @@ struct ImplUser {
 
 using ImplUserCb = decltype(ImplUser::Callbacks)::CbIter;
 
+// a range of elements within G.Arena
+struct ImplSpan {
+    uint32_t Begin = 0;
+    uint32_t Count = 0;
+};
+
+// a set of keyboard inputs (indexed by key)
+struct ImplKeySet {
+    uint64_t Bits[4] = {};
+
+    bool Get(int key) const { return (Bits[key >> 6] >> (key & 63)) & 1; }
+
+    void Set(int key, bool value) {
+        uint64_t bit = (uint64_t)1 << (key & 63);
+        if (value) {
+            Bits[key >> 6] |= bit;
+        } else {
+            Bits[key >> 6] &= ~bit;
+        }
+    }
+
+    bool HasAll(const ImplKeySet &other) const {
+        return ((~Bits[0] & other.Bits[0]) | (~Bits[1] & other.Bits[1]) | (~Bits[2] & other.Bits[2]) | (~Bits[3] & other.Bits[3])) == 0;
+    }
+
+    bool HasAny(const ImplKeySet &other) const {
+        return ((Bits[0] & other.Bits[0]) | (Bits[1] & other.Bits[1]) | (Bits[2] & other.Bits[2]) | (Bits[3] & other.Bits[3])) != 0;
+    }
+};
+
+// keyboard conditions that are and-ed together, checked at once
+struct ImplCondMask {
+    ImplKeySet DownSet, DownClear;
+    ImplKeySet ToggleSet, ToggleClear;
+
+    bool Check(const ImplKeySet &down, const ImplKeySet &toggle) const {
+        return down.HasAll(DownSet) && !down.HasAny(DownClear) &&
+               toggle.HasAll(ToggleSet) && !toggle.HasAny(ToggleClear);
+    }
+};
+
+// a list of conditions, as loaded
+struct ImplCondList {
+    ImplSpan Conds;
+    uint32_t MaskIdx = 0; // 1-based, into G.Arena.CondMasks (only for and-ed lists)
+
+    bool IsEmpty() const { return !Conds.Count && !MaskIdx; }
+};
+
+struct ImplInput;
+
 struct ImplCond {
     key_t Key = 0;
     user_t User = -1;
     bool State = false;
     bool Toggle = false;
-    SharedPtr<ImplCond> Child;
-    SharedPtr<ImplCond> Next;
+    SharedPtr<ImplCond> Child;  // (read form only)
+    SharedPtr<ImplCond> Next;   // (read form only)
+    ImplCondList ChildList;     // (loaded form only)
+    ImplInput *Input = nullptr; // (loaded form only)
+};
+
+struct ImplMapping;
+class ChangedMask;
+struct InputValue;
+
+using ImplActionHandler = bool (*)(ImplMapping &mapping, ImplUser *user, int userIndex, InputValue &v, ChangedMask *changes);
+
+// Resolved from DestKey when the mapping is loaded, so that processing needn't look at DestKey again
+struct ImplAction {
+    ImplActionHandler Handler = nullptr;
+    uint16_t Offsets[3] = {}; // of the states the handler acts on, within ImplState, plus 1 (0 if unused)
+    uint8_t Corners = 0;      // for rotators - c1..c8 as bits
+    bool UserCmd = false;
+    bool External = false; // acts outside the engine - on the process, cursor or config (not done while replaying)
+    int Param = 0; // key, custom key index or wheel flags
+    double X = 0, Y = 0;
+
+    template <class T>
+    T &Get(ImplState &state, int idx = 0) const { return *(T *)((uint8_t *)&state + Offsets[idx] - 1); }
+
+    template <class T>
+    T *GetOpt(ImplState &state, int idx) const { return Offsets[idx] ? &Get<T>(state, idx) : nullptr; }
 };
 
+static_assert(sizeof(ImplState) < UINT16_MAX); // (for ImplAction::Offsets)
+
 struct ImplMapping {
     key_t SrcKey = 0;
     key_t DestKey = 0;
@@ -302,29 +511,30 @@ struct ImplMapping {
     bool ToggleValue : 1 = false;
     bool Replace : 1 = false; // r/w only
     bool Reset : 1 = false;   // r/w only
+    uint8_t Layer = 0;        // (see ImplLayers)
 
     double Rate = 0;
     double Strength = 0;
-    SharedPtr<ImplMapping> Next;
-    SharedPtr<ImplCond> Conds;
+    ImplAction Action;
+    SharedPtr<ImplMapping> Next; // (read form only)
+    SharedPtr<ImplCond> Conds;   // (read form only)
+    ImplCondList CondList;       // (loaded form only)
     SharedPtr<string> Data;
     UserTimer Timer;
 
     bool HasTimer() const { return Timer.IsSet(); }
-    void StartTimerMs(DWORD timeMs, TIMERPROC timerCb) { Timer.StartMs(timeMs, timerCb, this); }
-    void StartTimerS(double time, TIMERPROC timerCb) { Timer.StartS(time, timerCb, this); }
+    void StartTimerMs(DWORD timeMs, UserTimerCb timerCb) { Timer.StartMs(timeMs, timerCb, this); }
+    void StartTimerS(double time, UserTimerCb timerCb) { Timer.StartS(time, timerCb, this); }
     void EndTimer() { Timer.End(); }
-    static ImplMapping *FromTimer(UINT_PTR id) { return GTimerData.From<ImplMapping>(id); }
-};
-
-struct ImplReset {
-    SharedPtr<ImplMapping> Mapping;
-    SharedPtr<ImplReset> Next;
 };
 
 struct ImplInput {
-    SharedPtr<ImplMapping> Mappings;
-    SharedPtr<ImplReset> Resets;
+    ImplSpan Mappings;
+    ImplSpan PressResets;   // mappings whose conditions may stop holding when this is pressed
+    ImplSpan ReleaseResets; // (same, for release)
+    ImplSpan LayerSpans;    // spans of the input's mappings in each layer of LayerMask, by ascending layer
+    uint64_t LayerMask = 0; // layers (other than the base layer) that map the input
+    uint8_t PressLayer = 0; // the layer whose mappings got the current press
     ImplBoolOutput Output;
 
     bool AsyncDown : 1 = false;
@@ -333,13 +543,36 @@ struct ImplInput {
     bool ObservedPressForCheck : 1 = false;
 
     void Reset() {
-        Mappings = nullptr;
-        Resets = nullptr;
+        Mappings = PressResets = ReleaseResets = LayerSpans = {};
+        LayerMask = 0;
+        PressLayer = 0;
         AsyncToggle = false;
         Output.Reset();
     }
 };
 
+// The loaded mappings & conditions, owned by the current config
+// (never resized after load, so pointers into it are stable - e.g. for timers)
+struct ImplArena {
+    vector<ImplMapping> Mappings;
+    vector<ImplCond> Conds;
+    vector<ImplCondMask> CondMasks;
+    vector<ImplMapping *> Resets;
+    vector<ImplSpan> LayerSpans;
+
+    span<ImplMapping> GetMappings(ImplSpan range) { return {Mappings.data() + range.Begin, range.Count}; }
+    span<ImplCond> GetConds(ImplSpan range) { return {Conds.data() + range.Begin, range.Count}; }
+    span<ImplMapping *> GetResets(ImplSpan range) { return {Resets.data() + range.Begin, range.Count}; }
+
+    void Reset() {
+        Mappings = {};
+        Conds = {};
+        CondMasks = {};
+        Resets = {};
+        LayerSpans = {};
+    }
+};
+
 struct ImplDeviceBase {
     HHOOK HLowHook = nullptr;
     bool IsMapped = false;
@@ -349,6 +582,7 @@ struct ImplKeyboard : public ImplDeviceBase {
     enum { Count = MY_VK_LAST_REAL };
 
     ImplInput Keys[Count] = {};
+    ImplKeySet Down, Toggle; // packed AsyncDown/AsyncToggle of Keys
 
     ImplInput *Get(int input) {
         if (input > 0 && input < Count) {
@@ -358,10 +592,19 @@ struct ImplKeyboard : public ImplDeviceBase {
         }
     }
 
+    void UpdateAsync(ImplInput *input) {
+        if (input >= Keys && input < Keys + Count) {
+            int key = (int)(input - Keys);
+            Down.Set(key, input->AsyncDown);
+            Toggle.Set(key, input->AsyncToggle);
+        }
+    }
+
     void Reset() {
         for (int i = 0; i < Count; i++) {
             Keys[i].Reset();
         }
+        Toggle = {};
     }
 };
 
@@ -386,7 +629,7 @@ struct ImplMouseMotion {
 
 struct ImplMouseMotionTotal {
     double X = 0, Y = 0;
-    int Time = 0;
+    hrtime_t Time = 0;
 };
 
 struct ImplMouse : public ImplDeviceBase {
@@ -404,10 +647,10 @@ struct ImplMouse : public ImplDeviceBase {
 
 struct InputValue {
     bool Down;
-    DWORD Time;
+    hrtime_t Time;
     double Strength;
 
-    InputValue(bool down, double strength, DWORD time) : Down(down), Strength(strength), Time(time) {}
+    InputValue(bool down, double strength, hrtime_t time) : Down(down), Strength(strength), Time(time) {}
 };
 
 struct ImplCustomKey {
@@ -416,18 +659,73 @@ struct ImplCustomKey {
     function<void(const InputValue &, const ImplMapping *)> Callback;
 };
 
+// Named groups of mappings, activated & deactivated by commands.
+// Layer 0 is the base layer (always active) - an input mapped by active layers is handled by the mappings of the
+// most recently activated one only, else by those of the base layer
+struct ImplLayers {
+    static constexpr int Max = 64;
+
+    vector<string> Names = {""}; // (normalized, indexed by layer)
+    uint64_t Active = 0;         // bit per layer
+    uint8_t Stack[Max] = {};     // the active layers, most recently activated last
+    int Depth = 0;
+
+    // (returns 0 if there's no room for another layer - callers report what's dropped)
+    int Get(const string &name) {
+        for (size_t i = 1; i < Names.size(); i++) {
+            if (Names[i] == name) {
+                return (int)i;
+            }
+        }
+
+        if (Names.size() >= Max) {
+            return 0;
+        }
+
+        Names.push_back(name);
+        return (int)Names.size() - 1;
+    }
+
+    bool IsActive(int layer) const { return (Active >> layer) & 1; }
+
+    void Activate(int layer) {
+        Deactivate(layer);
+        Stack[Depth++] = (uint8_t)layer;
+        Active |= 1ull << layer;
+    }
+
+    void Deactivate(int layer) {
+        if (IsActive(layer)) {
+            int idx = (int)(std::find(Stack, Stack + Depth, (uint8_t)layer) - Stack);
+            memmove(Stack + idx, Stack + idx + 1, Depth - idx - 1);
+            Depth--;
+            Active &= ~(1ull << layer);
+        }
+    }
+
+    int Top() const { return Depth ? Stack[Depth - 1] : 0; }
+
+    void Reset() {
+        Names = {""};
+        Active = 0;
+        Depth = 0;
+    }
+};
+
 struct ImplG {
     ImplUser Users[IMPL_MAX_USERS];
     ImplKeyboard Keyboard; // also includes mouse buttons, though...
     ImplMouse Mouse;
     vector<UniquePtr<ImplCustomKey>> CustomKeys;
+    ImplArena Arena;
+    ImplLayers Layers;
     int ActiveUser = 0;
     int DefaultActiveUser = 0;
     bool InForeground = false;
     bool Paused = false;
 
     // reset by ResetVars
-    bool Trace, Debug, ApiTrace, ApiDebug, WaitDebugger, SpareForDebug;
+    bool Trace, Debug, ApiTrace, ApiDebug, EventTrace, WaitDebugger, SpareForDebug;
     bool Forward, Always, Disable, HideCursor, BoundCursor, RumbleWindow;
     bool InjectChildren, AutoReload;
 
@@ -441,12 +739,20 @@ struct ImplG {
 
     bool IsActive() { return InForeground || Always; }
 
+    // (to be called once the debug vars change)
+    void UpdateLogMask() {
+        GLogMask.set((Debug ? LogMask_Debug : 0) | (Trace ? LogMask_Trace : 0) |
+                     (ApiDebug ? LogMask_ApiDebug : 0) | (ApiTrace ? LogMask_ApiTrace : 0));
+    }
+
     void Reset() {
         ResetVars();
         Keyboard.IsMapped = Mouse.IsMapped = false;
 
         for (int i = 0; i < IMPL_MAX_USERS; i++) {
             Users[i].Reset();
+            Users[i].State.Version++; // (so that readers see the reset as a change)
+            Users[i].State.Publish();
         }
 
         Keyboard.Reset();
@@ -456,13 +762,16 @@ struct ImplG {
         for (auto &custom : CustomKeys) {
             custom->Key.Reset();
         }
+
+        Arena.Reset();
+        Layers.Reset();
     }
 
     ImplG() { ResetVars(); }
 
 private:
     void ResetVars() {
-        Trace = Debug = ApiTrace = ApiDebug = WaitDebugger = SpareForDebug = false;
+        Trace = Debug = ApiTrace = ApiDebug = EventTrace = WaitDebugger = SpareForDebug = false;
         Forward = Always = Disable = HideCursor = BoundCursor = RumbleWindow = false;
         InjectChildren = AutoReload = true;
     }
@@ -122,126 +122,136 @@ ImplInput *ImplGetInput(key_t key, user_t userIdx) {
     return nullptr;
 }
 
-slot_t ImplAllocSlotForUser(int userIndex, ImplBoolOutput &(*getter)(ImplState *)) {
+using ImplSlotGetter = ImplBoolOutput &(*)(ImplState *);
+
+slot_t ImplAllocSlotForUser(int userIndex, ImplSlotGetter getter, bool *exhausted) {
     if (userIndex >= 0) {
         ImplUser *user = ImplGetUser(userIndex, true);
         if (user) {
-            return getter(&user->State).AllocSlot();
+            return getter(&user->State).AllocSlot(exhausted);
         } else {
             return IMPL_MAX_SLOTS;
         }
     } else {
         // Allocate the same slot for all users, for simplicity
 
-        slot_t targetSlot = IMPL_MAX_SLOTS;
+        unsigned allocated = 0;
         for (int i = 0; i < IMPL_MAX_USERS; i++) {
-            auto &output = getter(&G.Users[i].State);
-
-            slot_t userSlot = output.AllocSlot();
-            if (userSlot == IMPL_MAX_SLOTS) {
-                return IMPL_MAX_SLOTS;
-            }
-
-            if (targetSlot == IMPL_MAX_SLOTS) {
-                targetSlot = userSlot;
-            }
-
-            while (userSlot < targetSlot) {
-                userSlot = output.AllocSlot();
-                if (userSlot == IMPL_MAX_SLOTS) {
-                    return IMPL_MAX_SLOTS;
-                }
-            }
+            allocated |= getter(&G.Users[i].State).Allocated;
+        }
 
-            if (userSlot > targetSlot) {
-                output.UndoAllocSlot();
-                targetSlot = userSlot;
-                i = -1; // restart from the beginning, using the new target
-            }
+        slot_t slot = ImplBoolOutput::FirstFreeSlot(allocated, exhausted);
+        for (int i = 0; i < IMPL_MAX_USERS; i++) {
+            getter(&G.Users[i].State).Allocated |= 1u << slot;
         }
-        return targetSlot;
+        return slot;
     }
 }
 
-slot_t ImplAllocSlot(key_t key, user_t userIndex) {
-    ImplInput *input = ImplGetInput(key, userIndex);
-    if (input) {
-        return input->Output.AllocSlot();
-    }
-
+// The output of each user that a pad key's slots are in (or null for keys without slots, e.g. LoadConfig)
+static ImplSlotGetter ImplGetSlotGetter(key_t key) {
 #define STATE_LAMBDA(value) [](ImplState *state) -> ImplBoolOutput & { return state->value; }
 
     switch (key) {
     case MY_VK_PAD_A:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(A.Pressed));
+        return STATE_LAMBDA(A.Pressed);
     case MY_VK_PAD_B:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(B.Pressed));
+        return STATE_LAMBDA(B.Pressed);
     case MY_VK_PAD_X:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(X.Pressed));
+        return STATE_LAMBDA(X.Pressed);
     case MY_VK_PAD_Y:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(Y.Pressed));
+        return STATE_LAMBDA(Y.Pressed);
     case MY_VK_PAD_START:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(Start.Pressed));
+        return STATE_LAMBDA(Start.Pressed);
     case MY_VK_PAD_BACK:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(Back.Pressed));
+        return STATE_LAMBDA(Back.Pressed);
     case MY_VK_PAD_GUIDE:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(Guide.Pressed));
+        return STATE_LAMBDA(Guide.Pressed);
     case MY_VK_PAD_EXTRA:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(Extra.Pressed));
+        return STATE_LAMBDA(Extra.Pressed);
     case MY_VK_PAD_DPAD_LEFT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(DL.Pressed));
+        return STATE_LAMBDA(DL.Pressed);
     case MY_VK_PAD_DPAD_RIGHT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(DR.Pressed));
+        return STATE_LAMBDA(DR.Pressed);
     case MY_VK_PAD_DPAD_UP:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(DU.Pressed));
+        return STATE_LAMBDA(DU.Pressed);
     case MY_VK_PAD_DPAD_DOWN:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(DD.Pressed));
+        return STATE_LAMBDA(DD.Pressed);
     case MY_VK_PAD_LTHUMB_LEFT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.L.Pressed));
+        return STATE_LAMBDA(LA.L.Pressed);
     case MY_VK_PAD_LTHUMB_RIGHT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.R.Pressed));
+        return STATE_LAMBDA(LA.R.Pressed);
     case MY_VK_PAD_LTHUMB_UP:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.U.Pressed));
+        return STATE_LAMBDA(LA.U.Pressed);
     case MY_VK_PAD_LTHUMB_DOWN:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.D.Pressed));
+        return STATE_LAMBDA(LA.D.Pressed);
     case MY_VK_PAD_RTHUMB_LEFT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.L.Pressed));
+        return STATE_LAMBDA(RA.L.Pressed);
     case MY_VK_PAD_RTHUMB_RIGHT:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.R.Pressed));
+        return STATE_LAMBDA(RA.R.Pressed);
     case MY_VK_PAD_RTHUMB_UP:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.U.Pressed));
+        return STATE_LAMBDA(RA.U.Pressed);
     case MY_VK_PAD_RTHUMB_DOWN:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.D.Pressed));
+        return STATE_LAMBDA(RA.D.Pressed);
     case MY_VK_PAD_LSHOULDER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LB.Pressed));
+        return STATE_LAMBDA(LB.Pressed);
     case MY_VK_PAD_RSHOULDER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RB.Pressed));
+        return STATE_LAMBDA(RB.Pressed);
     case MY_VK_PAD_LTRIGGER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LT.Pressed));
+        return STATE_LAMBDA(LT.Pressed);
     case MY_VK_PAD_RTRIGGER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RT.Pressed));
+        return STATE_LAMBDA(RT.Pressed);
     case MY_VK_PAD_LTHUMB_PRESS:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(L.Pressed));
+        return STATE_LAMBDA(L.Pressed);
     case MY_VK_PAD_RTHUMB_PRESS:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(R.Pressed));
+        return STATE_LAMBDA(R.Pressed);
     case MY_VK_PAD_LTHUMB_HORZ_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.X.Modifier));
+        return STATE_LAMBDA(LA.X.Modifier);
     case MY_VK_PAD_LTHUMB_VERT_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.Y.Modifier));
+        return STATE_LAMBDA(LA.Y.Modifier);
     case MY_VK_PAD_RTHUMB_HORZ_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.X.Modifier));
+        return STATE_LAMBDA(RA.X.Modifier);
     case MY_VK_PAD_RTHUMB_VERT_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.Y.Modifier));
+        return STATE_LAMBDA(RA.Y.Modifier);
     case MY_VK_PAD_LTRIGGER_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LT.Modifier));
+        return STATE_LAMBDA(LT.Modifier);
     case MY_VK_PAD_RTRIGGER_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RT.Modifier));
+        return STATE_LAMBDA(RT.Modifier);
     case MY_VK_PAD_LTHUMB_ROTATOR_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(LA.RotateModifier));
+        return STATE_LAMBDA(LA.RotateModifier);
     case MY_VK_PAD_RTHUMB_ROTATOR_MODIFIER:
-        return ImplAllocSlotForUser(userIndex, STATE_LAMBDA(RA.RotateModifier));
+        return STATE_LAMBDA(RA.RotateModifier);
     default:
-        return IMPL_MAX_SLOTS;
+        return nullptr;
+    }
+
+#undef STATE_LAMBDA
+}
+
+// (outputs without slots - e.g. LoadConfig - get IMPL_MAX_SLOTS, while 'exhausted' is set only if an output ran out of slots)
+slot_t ImplAllocSlot(key_t key, user_t userIndex, bool *exhausted = nullptr) {
+    ImplInput *input = ImplGetInput(key, userIndex);
+    if (input) {
+        return input->Output.AllocSlot(exhausted);
+    }
+
+    ImplSlotGetter getter = ImplGetSlotGetter(key);
+    return getter ? ImplAllocSlotForUser(userIndex, getter, exhausted) : IMPL_MAX_SLOTS;
+}
+
+// Frees a slot allocated by ImplAllocSlot, once no mapping uses it
+void ImplFreeSlot(key_t key, user_t userIndex, slot_t slot) {
+    ImplInput *input = ImplGetInput(key, userIndex);
+    if (input) {
+        input->Output.FreeSlot(slot);
+        return;
+    }
+
+    ImplSlotGetter getter = ImplGetSlotGetter(key);
+    for (int i = 0; getter && i < IMPL_MAX_USERS; i++) {
+        if (userIndex < 0 || userIndex == i) {
+            getter(&G.Users[i].State).FreeSlot(slot);
+        }
     }
 }
 
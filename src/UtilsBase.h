@@ -15,6 +15,8 @@
 #include <bit>
 #include <ranges>
 #include <array>
+#include <span>
+#include <thread>
 
 #pragma warning(disable : 4995)
 
@@ -46,6 +48,7 @@ using std::once_flag;
 using std::ostream;
 using std::popcount;
 using std::size;
+using std::span;
 using std::string;
 using std::string_view;
 using std::stringstream;
@@ -197,6 +200,37 @@ public:
     T operator->() { return get(); }
 };
 
+// a value written by a single thread and read by any thread without blocking the writer
+// (readers retry if they raced a write; T must be trivially copyable)
+template <class T>
+class SeqLocked {
+    std::atomic<uint32_t> mSeq = 0;
+    T mValue = {};
+
+public:
+    void Write(const T &value) {
+        uint32_t seq = mSeq.load(std::memory_order_relaxed);
+        mSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        mValue = value;
+        mSeq.store(seq + 2, std::memory_order_release);
+    }
+
+    T Read() const {
+        while (true) {
+            uint32_t seq = mSeq.load(std::memory_order_acquire);
+            if (!(seq & 1)) {
+                T value = mValue;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (mSeq.load(std::memory_order_relaxed) == seq) {
+                    return value;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+};
+
 template <class F>
 class CallbackList {
     mutex Mutex;
@@ -70,6 +70,17 @@ std::basic_string<TChar> StrTrimmed(const std::basic_string<TChar> &str) {
     return str.substr(start, end - start);
 }
 
+template <class TChar>
+std::basic_string_view<TChar> StrTrimmed(std::basic_string_view<TChar> str) {
+    while (!str.empty() && isspace(str.front())) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && isspace(str.back())) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
 wstring ToStdWStr(std::string_view str) {
     int size = MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), nullptr, 0);
 
@@ -131,6 +142,79 @@ std::basic_string<TChar> StrLowerCase(const std::basic_string<TChar> &str) // as
     return dest;
 }
 
+// A table of names -> values, built at compile time (open addressing, names must be non-empty)
+// Lookups hash once, then compare against the few entries in the probed run
+template <class TValue, size_t Count>
+class ConstNameTable {
+    static constexpr size_t Size = std::bit_ceil(Count * 2);
+
+    struct Entry {
+        string_view Name;
+        TValue Value = {};
+    };
+    array<Entry, Size> mEntries = {};
+
+    static constexpr size_t Hash(string_view name) {
+        uint32_t hash = 2166136261u; // fnv-1a
+        for (char ch : name) {
+            hash = (hash ^ (uint8_t)ch) * 16777619u;
+        }
+        return hash;
+    }
+
+public:
+    constexpr void Add(string_view name, TValue value) {
+        for (size_t i = Hash(name);; i++) {
+            Entry &entry = mEntries[i & (Size - 1)];
+            if (entry.Name.empty()) {
+                entry.Name = name;
+                entry.Value = value;
+                return;
+            }
+            if (entry.Name == name) {
+                return; // (first one wins)
+            }
+        }
+    }
+
+    constexpr const TValue *Find(string_view name) const {
+        for (size_t i = Hash(name);; i++) {
+            const Entry &entry = mEntries[i & (Size - 1)];
+            if (entry.Name.empty()) {
+                return nullptr;
+            }
+            if (entry.Name == name) {
+                return &entry.Value;
+            }
+        }
+    }
+};
+
+struct ConstNameCounter {
+    size_t Count = 0;
+    constexpr void Add(string_view, auto) { Count++; }
+};
+
+// Builds a ConstNameTable from a captureless lambda that calls table.Add(name, value) for each name
+template <class TValue, class TEnumerate>
+constexpr auto ConstNameTableFrom(TEnumerate enumerate) {
+    constexpr size_t count = [] {
+        ConstNameCounter counter;
+        TEnumerate()(counter);
+        return counter.Count;
+    }();
+
+    ConstNameTable<TValue, count> table;
+    enumerate(table);
+    return table;
+}
+
+bool StrIEquals(string_view str1, string_view str2) // ascii tolower!
+{
+    return str1.size() == str2.size() &&
+           std::equal(str1.begin(), str1.end(), str2.begin(), [](char ch1, char ch2) { return tolower(ch1) == tolower(ch2); });
+}
+
 int tstrcmp(const char *str1, const char *str2) { return strcmp(str1, str2); }
 int tstricmp(const char *str1, const char *str2) { return _stricmp(str1, str2); }
 bool tstreq(const char *str1, const char *str2) { return strcmp(str1, str2) == 0; }
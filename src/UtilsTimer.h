@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// (standard c++ only - see UtilsTimerTest.h)
+
+// A timer inside a TimerWheel (intrusive, so arming & cancelling doesn't allocate)
+struct WheelTimer {
+    WheelTimer *Prev = nullptr;
+    WheelTimer *Next = nullptr;
+    uint64_t Deadline = 0; // in ticks
+    uint64_t Period = 0;   // in ticks, or 0 if one-shot
+    void (*Callback)(WheelTimer *timer) = nullptr;
+
+    bool IsSet() const { return Next != nullptr; }
+
+    void LinkBefore(WheelTimer *head) {
+        Prev = head->Prev;
+        Next = head;
+        head->Prev->Next = this;
+        head->Prev = this;
+    }
+
+    void Unlink() {
+        Prev->Next = Next;
+        Next->Prev = Prev;
+        Prev = Next = nullptr;
+    }
+};
+
+// Hierarchical timing wheel - O(1) arm & cancel, firing in deadline order.
+// Platform-neutral - the owner supplies the current tick (from whatever clock it likes)
+class TimerWheel {
+    static constexpr int LevelBits = 6;
+    static constexpr int NumSlots = 1 << LevelBits;
+    static constexpr int NumLevels = 4;
+    static constexpr uint64_t SlotMask = NumSlots - 1;
+    static constexpr uint64_t MaxDelta = (1ull << (LevelBits * NumLevels)) - 1; // further timers get re-cascaded
+
+    WheelTimer mSlots[NumLevels][NumSlots]; // list heads
+    uint64_t mTick = 0;                     // everything due at or before this has fired
+    size_t mCount = 0;
+
+    static bool IsEmpty(const WheelTimer &head) { return head.Next == &head; }
+
+    void Link(WheelTimer *timer) {
+        uint64_t delta = timer->Deadline > mTick ? timer->Deadline - mTick : 0;
+        uint64_t slotTick = mTick + std::min(delta, MaxDelta);
+
+        int level = 0;
+        while (level < NumLevels - 1 && delta >> (LevelBits * (level + 1))) {
+            level++;
+        }
+
+        timer->LinkBefore(&mSlots[level][(slotTick >> (LevelBits * level)) & SlotMask]);
+    }
+
+    void Cascade(WheelTimer &head) {
+        while (!IsEmpty(head)) {
+            WheelTimer *timer = head.Next;
+            timer->Unlink();
+            Link(timer);
+        }
+    }
+
+    size_t Fire(WheelTimer &head, uint64_t now) {
+        size_t count = 0;
+        WheelTimer due;
+        due.Prev = due.Next = &due;
+        while (!IsEmpty(head)) {
+            WheelTimer *timer = head.Next;
+            timer->Unlink();
+            timer->LinkBefore(&due);
+        }
+
+        // (callbacks may arm/cancel any timer - including ones still in 'due')
+        while (!IsEmpty(due)) {
+            WheelTimer *timer = due.Next;
+            timer->Unlink();
+            mCount--;
+
+            if (timer->Period) {
+                uint64_t next = timer->Deadline + timer->Period;
+                Start(timer, next > now ? next : now + timer->Period, timer->Period); // no bursts after stalls
+            }
+
+            timer->Callback(timer);
+            count++;
+        }
+        return count;
+    }
+
+public:
+    TimerWheel() {
+        for (auto &level : mSlots) {
+            for (auto &head : level) {
+                head.Prev = head.Next = &head;
+            }
+        }
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+
+    uint64_t Tick() const { return mTick; }
+    size_t Count() const { return mCount; }
+
+    void Start(WheelTimer *timer, uint64_t deadline, uint64_t period = 0) {
+        Cancel(timer);
+        timer->Deadline = std::max(deadline, mTick + 1);
+        timer->Period = period;
+        Link(timer);
+        mCount++;
+    }
+
+    void Cancel(WheelTimer *timer) {
+        if (timer->IsSet()) {
+            timer->Unlink();
+            mCount--;
+        }
+    }
+
+    // The next tick at which Advance has something to do (or UINT64_MAX if no timers)
+    uint64_t NextTick() const {
+        uint64_t best = UINT64_MAX;
+        if (mCount) {
+            for (int level = 0; level < NumLevels; level++) {
+                int shift = LevelBits * level;
+                uint64_t base = mTick >> shift;
+                for (uint64_t i = 1; i <= NumSlots; i++) {
+                    if (!IsEmpty(mSlots[level][(base + i) & SlotMask])) {
+                        best = std::min(best, (base + i) << shift);
+                        break;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    // Fires all timers due at or before 'now', returning how many fired
+    size_t Advance(uint64_t now) {
+        size_t count = 0;
+        while (mTick < now) {
+            uint64_t next = NextTick();
+            if (next > now) {
+                mTick = now;
+                break;
+            }
+
+            mTick = next;
+            for (int level = 1; level < NumLevels; level++) {
+                int shift = LevelBits * level;
+                if (mTick & ((1ull << shift) - 1)) {
+                    break;
+                }
+                Cascade(mSlots[level][(mTick >> shift) & SlotMask]);
+            }
+
+            count += Fire(mSlots[0][mTick & SlotMask], now);
+        }
+        return count;
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include "UtilsTimer.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Tests & benchmarks of TimerWheel, driven by a fake clock (standard c++ only, so they can run on any platform)
+
+struct TimerWheelTestTimer : WheelTimer {
+    uint64_t LastFired = 0;
+    int NumFired = 0;
+    TimerWheelTestTimer *CancelOnFire = nullptr;
+    uint64_t RearmOnFire = 0;
+};
+
+struct TimerWheelTestState {
+    TimerWheel Wheel;
+    uint64_t LastFired = 0;
+    std::string Error;
+};
+
+static TimerWheelTestState *GTimerWheelTest = nullptr;
+
+static void TimerWheelTestOnTimer(WheelTimer *wheelTimer) {
+    auto timer = (TimerWheelTestTimer *)wheelTimer;
+    auto &state = *GTimerWheelTest;
+    uint64_t tick = state.Wheel.Tick();
+
+    if (state.Error.empty() && !timer->Period && tick != timer->Deadline) {
+        state.Error = "fired at " + std::to_string(tick) + " instead of " + std::to_string(timer->Deadline);
+    }
+    if (state.Error.empty() && tick < state.LastFired) {
+        state.Error = "fired at " + std::to_string(tick) + " after firing at " + std::to_string(state.LastFired);
+    }
+
+    state.LastFired = tick;
+    timer->LastFired = tick;
+    timer->NumFired++;
+
+    if (timer->CancelOnFire) {
+        state.Wheel.Cancel(timer->CancelOnFire);
+    }
+    if (timer->RearmOnFire) {
+        state.Wheel.Start(timer, tick + timer->RearmOnFire);
+        timer->RearmOnFire = 0;
+    }
+}
+
+// Checks that timers fire exactly at their deadlines, in order - including timers beyond the wheel's range,
+// periodic timers (also across a stall of the clock), and timers cancelled & re-armed by callbacks.
+// Returns a description of the first failure, or an empty string
+static std::string TimerWheelTest() {
+    TimerWheelTestState state;
+    GTimerWheelTest = &state;
+    auto check = [&](bool cond, const char *what) {
+        if (!cond && state.Error.empty()) {
+            state.Error = what;
+        }
+    };
+
+    // random one-shot timers, with the fake clock advancing in random steps
+    std::mt19937_64 random(1);
+    std::vector<TimerWheelTestTimer> timers(2000);
+    for (auto &timer : timers) {
+        timer.Callback = TimerWheelTestOnTimer;
+        state.Wheel.Start(&timer, 1 + random() % (1ull << 26));
+    }
+    check(state.Wheel.Count() == timers.size(), "count after start");
+
+    uint64_t now = 0;
+    while (state.Wheel.Count() && state.Error.empty()) {
+        now += 1 + random() % 5000;
+        state.Wheel.Advance(now);
+    }
+    for (auto &timer : timers) {
+        check(timer.NumFired == 1 && timer.LastFired == timer.Deadline, "one-shot timer fired once, at its deadline");
+    }
+
+    // a periodic timer - fires once per period, and just once after a stall
+    TimerWheelTestTimer periodic;
+    periodic.Callback = TimerWheelTestOnTimer;
+    uint64_t start = state.Wheel.Tick();
+    state.Wheel.Start(&periodic, start + 5, 10);
+    for (uint64_t tick = start + 1; tick <= start + 100; tick++) {
+        state.Wheel.Advance(tick);
+    }
+    check(periodic.NumFired == 10 && periodic.LastFired == start + 95, "periodic timer fired once per period");
+
+    state.Wheel.Advance(start + 1000);
+    check(periodic.NumFired == 11, "periodic timer fired once after a stall");
+    check(periodic.Deadline > start + 1000, "periodic timer's next deadline is after the stall");
+    state.Wheel.Cancel(&periodic);
+    check(!periodic.IsSet() && state.Wheel.Count() == 0, "cancelled periodic timer");
+
+    // a callback cancelling a timer due at the same tick, and re-arming its own timer
+    TimerWheelTestTimer canceller, cancelled;
+    canceller.Callback = cancelled.Callback = TimerWheelTestOnTimer;
+    canceller.CancelOnFire = &cancelled;
+    canceller.RearmOnFire = 7;
+    start = state.Wheel.Tick();
+    state.Wheel.Start(&canceller, start + 3);
+    state.Wheel.Start(&cancelled, start + 3);
+    state.Wheel.Advance(start + 3);
+    check(canceller.NumFired == 1 && cancelled.NumFired == 0, "timer cancelled by a callback didn't fire");
+    check(canceller.IsSet() && state.Wheel.Count() == 1, "timer re-armed by its callback");
+    check(state.Wheel.NextTick() <= start + 10, "next tick of re-armed timer");
+    state.Wheel.Advance(start + 10);
+    check(canceller.NumFired == 2 && canceller.LastFired == start + 10, "re-armed timer fired");
+
+    GTimerWheelTest = nullptr;
+    return state.Error;
+}
+
+struct TimerWheelBenchResult {
+    std::vector<uint32_t> ArmCancelNs; // per arm & cancel, averaged over batches
+    std::vector<uint32_t> FireNs;      // per fired timer, averaged over batches
+};
+
+// Arms & cancels, then arms & fires, 'numTimers' timers with random deadlines - 'runs' times
+static TimerWheelBenchResult TimerWheelBench(int numTimers, int runs) {
+    using clock = std::chrono::steady_clock;
+    auto elapsedNs = [](clock::time_point start, int count) {
+        return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / count);
+    };
+
+    TimerWheelBenchResult result;
+    TimerWheel wheel;
+    std::mt19937_64 random(1);
+    std::vector<WheelTimer> timers(numTimers);
+    std::vector<uint64_t> deadlines(numTimers);
+    for (auto &timer : timers) {
+        timer.Callback = [](WheelTimer *) {};
+    }
+
+    for (int run = 0; run < runs; run++) {
+        for (auto &deadline : deadlines) {
+            deadline = wheel.Tick() + 1 + random() % 100000;
+        }
+
+        auto start = clock::now();
+        for (int i = 0; i < numTimers; i++) {
+            wheel.Start(&timers[i], deadlines[i]);
+        }
+        for (auto &timer : timers) {
+            wheel.Cancel(&timer);
+        }
+        result.ArmCancelNs.push_back(elapsedNs(start, numTimers));
+
+        for (int i = 0; i < numTimers; i++) {
+            wheel.Start(&timers[i], deadlines[i]);
+        }
+
+        start = clock::now();
+        size_t fired = 0;
+        for (uint64_t now = wheel.Tick(); wheel.Count(); ) {
+            now += 100;
+            fired += wheel.Advance(now);
+        }
+        result.FireNs.push_back(elapsedNs(start, (int)std::max<size_t>(fired, 1)));
+    }
+    return result;
+}
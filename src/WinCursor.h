@@ -101,9 +101,7 @@ static void MouseCaptureUpdate(HWND activeWindow, bool updateClip) {
         GetClientRect(activeWindow, &r);
         MapWindowPoints(activeWindow, nullptr, (POINT *)&r, 2);
         ClipCursor_Real(&r);
-        if (G.Debug) {
-            LOG << "set cursor rect to " << r.left << ".." << r.right << ", " << r.top << ".." << r.bottom << END;
-        }
+        LOG_DEBUG << "set cursor rect to " << r.left << ".." << r.right << ", " << r.top << ".." << r.bottom << END;
     }
 
     if (GCapture.CaptureFlags & MOUSE_CAPTURE_HIDE) {
@@ -201,9 +199,7 @@ static void UpdateCursor() {
         GCapture.CaptureThread = captureThread;
         GCapture.CaptureFlags = captureFlags;
 
-        if (G.Debug) {
-            LOG << "mouse thread changed to: " << captureThread << END;
-        }
+        LOG_DEBUG << "mouse thread changed to: " << captureThread << END;
 
         if (captureThread) {
             lock_guard<mutex> lock(GCapture.HooksMutex);
@@ -10,9 +10,7 @@ static LRESULT CALLBACK LowKeyboardHook(int nCode, WPARAM wParam, LPARAM lParam)
 
     KBDLLHOOKSTRUCT *data = (KBDLLHOOKSTRUCT *)lParam;
 
-    if (G.Trace) {
-        LOG << "ll keyboard hook: " << nCode << ", " << data->vkCode << ", " << data->flags << END;
-    }
+    LOG_TRACE << "ll keyboard hook: " << nCode << ", " << data->vkCode << ", " << data->flags << END;
 
     // we do the real processing here, and send raw keyboard events, since we can't cheaply
     // have both a raw keyboard registration and lowlevel event hook in the same process (for whatever bad reason)
@@ -21,7 +19,7 @@ static LRESULT CALLBACK LowKeyboardHook(int nCode, WPARAM wParam, LPARAM lParam)
         bool injected = (data->flags & LLKHF_INJECTED) != 0;
         bool locallyInjected = injected && IsExtraInfoLocal(data->dwExtraInfo);
 
-        if (!locallyInjected && ImplKeyboardHook(data->vkCode, !(data->flags & LLKHF_UP), !!(data->flags & LLKHF_EXTENDED), data->time)) {
+        if (!locallyInjected && ImplKeyboardHook(data->vkCode, !(data->flags & LLKHF_UP), !!(data->flags & LLKHF_EXTENDED), GHrClock.Now())) {
             return 1;
         }
 
@@ -67,9 +65,7 @@ static LRESULT CALLBACK LowMouseHook(int nCode, WPARAM wParam, LPARAM lParam) {
 
     MSLLHOOKSTRUCT *data = (MSLLHOOKSTRUCT *)lParam;
 
-    if (G.Trace) {
-        LOG << "ll mouse hook: " << nCode << ", " << wParam << ", " << data->mouseData << ", " << data->flags << END;
-    }
+    LOG_TRACE << "ll mouse hook: " << nCode << ", " << wParam << ", " << data->mouseData << ", " << data->flags << END;
 
     // we do the real processing in the raw mouse event, here we just block events if needed
 
@@ -88,14 +84,12 @@ static LRESULT CALLBACK LowMouseHook(int nCode, WPARAM wParam, LPARAM lParam) {
 static void UpdateInForeground(bool allowUpdateAll = true) {
     bool inForeground = IsWindowInOurProcess(GetForegroundWindow());
     if (inForeground != G.InForeground) {
-        if (inForeground && allowUpdateAll && G.AutoReload) {
-            ConfigReloadIfNeeded();
+        if (inForeground && allowUpdateAll && G.AutoReload && !GConfig.Watcher.IsWatchingAll()) {
+            ConfigReloadIfNeeded(); // (only if changes to some of the files can't be watched)
         }
 
         ImplToggleForeground(allowUpdateAll);
-        if (G.Debug) {
-            LOG << "App " << (inForeground ? "entered" : "left") << " foreground" << END;
-        }
+        LOG_DEBUG << "App " << (inForeground ? "entered" : "left") << " foreground" << END;
     }
 }
 
@@ -121,9 +115,7 @@ static void AddForegroundHook(HWND window) {
     if (thread) {
         auto &hook = GForegroundHooks[thread];
         if (!hook) {
-            if (G.Debug) {
-                LOG << "Setting foreground hook" << END;
-            }
+            LOG_DEBUG << "Setting foreground hook" << END;
             hook = SetWindowsHookExW_Real(WH_CALLWNDPROC, ForegroundHook, nullptr, thread);
         }
     }
@@ -196,9 +188,7 @@ static LRESULT AUGHOOKPROC_CALLCONV LowHookWrapper(AUGHOOKPROC_PARAMS(int nCode,
         case WH_KEYBOARD_LL: {
             KBDLLHOOKSTRUCT *data = (KBDLLHOOKSTRUCT *)lParam;
 
-            if (G.Trace) {
-                LOG << "app ll keyboard hook: " << nCode << ", " << data->vkCode << ", " << data->flags << END;
-            }
+            LOG_TRACE << "app ll keyboard hook: " << nCode << ", " << data->vkCode << ", " << data->flags << END;
 
             bool injected = data->flags & LLKHF_INJECTED;
             if (injected && data->dwExtraInfo == ExtraInfoOurInject) {
@@ -213,9 +203,7 @@ static LRESULT AUGHOOKPROC_CALLCONV LowHookWrapper(AUGHOOKPROC_PARAMS(int nCode,
         case WH_MOUSE_LL: {
             MSLLHOOKSTRUCT *data = (MSLLHOOKSTRUCT *)lParam;
 
-            if (G.Trace) {
-                LOG << "app ll mouse hook: " << nCode << ", " << wParam << ", " << data->mouseData << END;
-            }
+            LOG_TRACE << "app ll mouse hook: " << nCode << ", " << wParam << ", " << data->mouseData << END;
 
             bool injected = data->flags & LLMHF_INJECTED;
             if (injected && data->dwExtraInfo == ExtraInfoOurInject) {
@@ -230,9 +218,7 @@ static LRESULT AUGHOOKPROC_CALLCONV LowHookWrapper(AUGHOOKPROC_PARAMS(int nCode,
         case WH_MOUSE: {
             MOUSEHOOKSTRUCT *data = (MOUSEHOOKSTRUCT *)lParam;
 
-            if (G.Trace) {
-                LOG << "app mouse hook: " << nCode << ", " << wParam << END;
-            }
+            LOG_TRACE << "app mouse hook: " << nCode << ", " << wParam << END;
 
             if (IsExtraInfoLocal(data->dwExtraInfo)) {
                 data->dwExtraInfo = GAppExtraInfo.GetOrig(data->dwExtraInfo);
@@ -350,9 +336,7 @@ static void WinHooksPostMouseSet(void *data) {
 
 HHOOK WINAPI SetWindowsHookEx_Hook(int idHook, HOOKPROC lpfn, HINSTANCE hmod, DWORD dwThreadId,
                                    decltype(SetWindowsHookExA) SetWindowsHookEx_Real) {
-    if (G.ApiDebug) {
-        LOG << "SetWindowsHookEx " << idHook << " " << dwThreadId << END;
-    }
+    LOG_API_DEBUG << "SetWindowsHookEx " << idHook << " " << dwThreadId << END;
 
     if ((idHook == WH_KEYBOARD_LL || idHook == WH_MOUSE_LL) ||
         (idHook == WH_MOUSE && dwThreadId)) {
@@ -15,9 +15,7 @@ SHORT WINAPI GetAsyncKeyState_Hook(int vKey) {
     if (GManualAsync.Enabled &&
         vKey >= 0 && vKey < ManualAsyncKeyState::Count &&
         !IsVkMouseButton(vKey)) {
-        if (G.ApiTrace) {
-            LOG << "GetAsyncKeyState (manual)" << END;
-        }
+        LOG_API_TRACE << "GetAsyncKeyState (manual)" << END;
 
         bool state = GManualAsync.State[vKey];
         bool sticky = GManualAsync.Sticky[vKey].exchange(false);
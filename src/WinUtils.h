@@ -2,53 +2,270 @@
 #include "UtilsBase.h"
 #include "UtilsStr.h"
 #include "UtilsPath.h"
+#include "UtilsTimer.h"
 #include <Windows.h>
 #include <cstdarg>
 
-struct UserTimers {
-    // (it's not safe to use 'this' as UINT_PTR, since timers may get called after EndTimer)
-    unordered_map<UINT_PTR, void *> Map;
+// A high-resolution timestamp, in microseconds (from the performance counter)
+using hrtime_t = uint64_t;
+constexpr hrtime_t HrTimePerSec = 1000000;
 
-    template <class T>
-    T *From(UINT_PTR id) {
-        auto iter = Map.find(id);
-        return iter == Map.end() ? nullptr : (T *)iter->second;
+class HrClock {
+    uint64_t mFrequency;
+    static inline thread_local hrtime_t sFixedTime = 0; // if non-zero, returned by Now (for replays, on the dll thread only)
+
+public:
+    HrClock() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        mFrequency = frequency.QuadPart;
     }
-} GTimerData;
 
-class UserTimer {
-    UINT_PTR Value = 0;
+    // (ignores FixTime)
+    hrtime_t RealNow() const {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        uint64_t value = counter.QuadPart;
+        return value / mFrequency * HrTimePerSec + value % mFrequency * HrTimePerSec / mFrequency;
+    }
 
-public:
-    bool IsSet() const { return Value != 0; }
+    // (for measuring short durations)
+    uint64_t RealNowNs() const {
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+        uint64_t value = counter.QuadPart;
+        return value / mFrequency * 1000000000 + value % mFrequency * 1000000000 / mFrequency;
+    }
 
-    // self must be constant for the lifetime of a UserTimer
-    void StartMs(DWORD timeMs, TIMERPROC timerCb, void *self) {
-        if (Value) {
-            SetTimer(nullptr, Value, timeMs, timerCb);
+    hrtime_t Now() const { return sFixedTime ? sFixedTime : RealNow(); }
+
+    // Fixes Now for the calling thread only - other threads keep seeing real time
+    // (never backwards; as Now returns to real time after UnfixTime, anything timed on the fixed timeline - e.g.
+    // timers - must be kept apart from the real one, see UserTimers::Isolate)
+    void FixTime(hrtime_t time) { sFixedTime = time; }
+
+    void UnfixTime() { sFixedTime = 0; }
+
+    // Converts to/from GetTickCount-based times, as used by windows messages & SendInput
+    // (relative to now, so the two clocks drifting apart doesn't matter)
+    DWORD ToTicks(hrtime_t time) const {
+        hrtime_t now = Now();
+        return GetTickCount() - (DWORD)((now > time ? now - time : 0) / (HrTimePerSec / 1000));
+    }
+
+    hrtime_t FromTicks(DWORD ticks) const {
+        int64_t age = (int64_t)(int32_t)(GetTickCount() - ticks) * (HrTimePerSec / 1000);
+        return Now() - age;
+    }
+} GHrClock;
+
+using UserTimerCb = void (*)(void *self, hrtime_t time);
+
+// Timers of the dll thread, kept in a timer wheel over a high-resolution clock
+// (the thread waits on WaitHandle and calls Update when it's signalled)
+class UserTimers {
+    TimerWheel mMainWheel;
+    TimerWheel *mWheel = &mMainWheel;
+    HANDLE mWaitable = nullptr;
+    uint64_t mWaitTick = UINT64_MAX;
+
+    void Rearm(uint64_t next) {
+        mWaitTick = next;
+        if (next == UINT64_MAX) {
+            CancelWaitableTimer(mWaitable);
         } else {
-            Value = SetTimer(nullptr, 0, timeMs, timerCb);
-            GTimerData.Map[Value] = self;
+            uint64_t now = Now();
+            LARGE_INTEGER due;
+            due.QuadPart = next > now ? -(LONGLONG)((next - now) * (10000000 / TicksPerSec)) : -1; // (relative, in 100ns)
+            SetWaitableTimer(mWaitable, &due, 0, nullptr, nullptr, FALSE);
         }
     }
 
-    void StartS(double time, TIMERPROC timerCb, void *self) {
-        StartMs((DWORD)ceil(time * 1000), timerCb, self);
+public:
+    static constexpr uint64_t TicksPerSec = 10000;
+
+    void Initialize() {
+        mWaitable = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!mWaitable) { // (not supported before win10 1803)
+            mWaitable = CreateWaitableTimerW(nullptr, FALSE, nullptr);
+        }
+
+        mWheel->Advance(Now());
     }
 
-    void End() {
-        if (Value) {
-            GTimerData.Map.erase(Value);
-            KillTimer(nullptr, Value);
-            Value = 0;
+    HANDLE WaitHandle() const { return mWaitable; }
+
+    uint64_t Now() const { return GHrClock.Now() / (HrTimePerSec / TicksPerSec); }
+
+    void Start(WheelTimer *timer, uint64_t period) { StartAt(timer, Now() + period, period); }
+
+    void StartAt(WheelTimer *timer, uint64_t deadline, uint64_t period) {
+        mWheel->Start(timer, deadline, period);
+        if (timer->Deadline < mWaitTick) {
+            Rearm(timer->Deadline);
         }
     }
 
+    void Cancel(WheelTimer *timer) { mWheel->Cancel(timer); }
+
+    // Runs timers in 'wheel' instead of the main one (until called with null), so that they can follow a separate
+    // timeline (e.g. a replay's) without firing or disturbing the timers of the main one.
+    // (timers running in the main wheel mustn't be touched meanwhile - suspend them beforehand, see UserTimer::Suspend)
+    void Isolate(TimerWheel *wheel) {
+        mWheel = wheel ? wheel : &mMainWheel;
+        if (wheel) {
+            wheel->Advance(Now());
+        }
+        Rearm(mWheel->NextTick());
+    }
+
+    // Moves a running timer's deadline & period to another timer
+    void Transfer(WheelTimer *from, WheelTimer *to) {
+        if (from->IsSet()) {
+            mWheel->Start(to, from->Deadline, from->Period);
+            mWheel->Cancel(from);
+        }
+    }
+
+    // The next time Update has something to do (or UINT64_MAX if no timers)
+    hrtime_t NextTime() const {
+        uint64_t next = mWheel->NextTick();
+        return next == UINT64_MAX ? UINT64_MAX : next * (HrTimePerSec / TicksPerSec);
+    }
+
+    // (returns how many timers fired)
+    size_t Update() {
+        size_t count = mWheel->Advance(Now());
+        Rearm(mWheel->NextTick()); // (always - the waitable may have woken us early)
+        return count;
+    }
+} GUserTimers;
+
+// The remaining run of a suspended UserTimer
+struct UserTimerRun {
+    uint64_t Deadline = 0; // (0 if it wasn't running)
+    uint64_t Period = 0;
+};
+
+class UserTimer : WheelTimer {
+    UserTimerCb mCb = nullptr;
+    void *mSelf = nullptr;
+
+    static void OnTimer(WheelTimer *timer) {
+        UserTimer *self = (UserTimer *)timer;
+        self->mCb(self->mSelf, GHrClock.Now());
+    }
+
+public:
+    UserTimer() { Callback = OnTimer; }
+    UserTimer(const UserTimer &other) : UserTimer() {} // (copies start out unset)
+    UserTimer &operator=(const UserTimer &other) {
+        End();
+        return *this;
+    }
+
+    bool IsSet() const { return WheelTimer::IsSet(); }
+
+    // self must be constant for the lifetime of a UserTimer
+    void StartTicks(uint64_t ticks, UserTimerCb timerCb, void *self) {
+        mCb = timerCb;
+        mSelf = self;
+        GUserTimers.Start(this, max(ticks, 1ull));
+    }
+
+    void StartMs(DWORD timeMs, UserTimerCb timerCb, void *self) {
+        StartTicks((uint64_t)timeMs * UserTimers::TicksPerSec / 1000, timerCb, self);
+    }
+
+    void StartS(double time, UserTimerCb timerCb, void *self) {
+        StartTicks((uint64_t)llround(time * UserTimers::TicksPerSec), timerCb, self);
+    }
+
+    void End() { GUserTimers.Cancel(this); }
+
+    // Stops the timer, returning its run - to continue later via Resume
+    UserTimerRun Suspend() {
+        UserTimerRun run;
+        if (IsSet()) {
+            run = {Deadline, Period};
+            End();
+        }
+        return run;
+    }
+
+    // (with the callback & self it was last started with)
+    void Resume(const UserTimerRun &run) {
+        if (run.Deadline) {
+            GUserTimers.StartAt(this, run.Deadline, run.Period);
+        }
+    }
+
+    // Continues other's run (if any) in this timer, with a new self
+    void TakeOver(UserTimer &other, void *self) {
+        mCb = other.mCb;
+        mSelf = self;
+        GUserTimers.Transfer(&other, this);
+    }
+
     ~UserTimer() {
         End();
     }
 };
 
+// Watches directories for changes to their files
+// (the thread waits on Handles and calls Check when any is signalled)
+class DirWatcher {
+    vector<HANDLE> mHandles;
+    vector<wstring> mDirs;
+    bool mMissed = false; // (a dir failed to be added since the last Clear)
+
+public:
+    DirWatcher() {}
+    DirWatcher(const DirWatcher &) = delete;
+    ~DirWatcher() { Clear(); }
+
+    const vector<HANDLE> &Handles() const { return mHandles; }
+    bool IsWatching() const { return !mHandles.empty(); }
+    bool IsWatchingAll() const { return IsWatching() && !mMissed; }
+
+    bool Add(const wchar_t *dir) {
+        if (Find(mDirs, dir) >= 0) {
+            return true;
+        }
+
+        HANDLE handle = FindFirstChangeNotificationW(dir, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
+        if (handle == INVALID_HANDLE_VALUE) {
+            mMissed = true;
+            return false;
+        }
+
+        mHandles.push_back(handle);
+        mDirs.push_back(dir);
+        return true;
+    }
+
+    void Clear() {
+        for (HANDLE handle : mHandles) {
+            FindCloseChangeNotification(handle);
+        }
+        mHandles.clear();
+        mDirs.clear();
+        mMissed = false;
+    }
+
+    // Returns whether anything changed since the last call (without blocking)
+    bool Check() {
+        bool changed = false;
+        for (HANDLE handle : mHandles) {
+            if (WaitForSingleObject(handle, 0) == WAIT_OBJECT_0) {
+                FindNextChangeNotification(handle);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+};
+
 class ReusableThread {
     struct Action {
         LPTHREAD_START_ROUTINE Routine;
@@ -248,3 +465,14 @@ uint64_t GetFileLastWriteTime(const wchar_t *path) {
     return ((uint64_t)attrs.ftLastWriteTime.dwHighDateTime << 32) |
            attrs.ftLastWriteTime.dwLowDateTime;
 }
+
+bool GetFileStat(const wchar_t *path, uint64_t *writeTime, uint64_t *size) {
+    WIN32_FILE_ATTRIBUTE_DATA attrs;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &attrs)) {
+        return false;
+    }
+
+    *writeTime = ((uint64_t)attrs.ftLastWriteTime.dwHighDateTime << 32) | attrs.ftLastWriteTime.dwLowDateTime;
+    *size = ((uint64_t)attrs.nFileSizeHigh << 32) | attrs.nFileSizeLow;
+    return true;
+}
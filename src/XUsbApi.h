@@ -2,6 +2,8 @@
 #include <Xinput.h>
 #include "UtilsBase.h"
 #include "Device.h"
+#include "EventTrace.h"
+#include "ImplLatency.h"
 
 #define XINPUT_GAMEPAD_GUIDE 0x400 // private value
 
@@ -43,9 +45,7 @@ static HANDLE XUsbCreateFile(DeviceIntf *device, DWORD flags) {
             if (gUniqLogXUsbOpen) {
                 LOG << "Opening xusb device" << END;
             }
-            if (G.ApiDebug) {
-                LOG << "Created xusb pipe " << pipe << END;
-            }
+            LOG_API_DEBUG << "Created xusb pipe " << pipe << END;
         }
 
         return pipe;
@@ -190,8 +190,16 @@ BOOL OnXUsbVersionError(XUsbVersion version, const char *funcDesc) {
     return FALSE;
 }
 
-void ReadXUsbState(XUsbGamepadState *xusb, const ImplState &state, XUsbVersion version) {
-    lock_guard<mutex> lock(state.Mutex);
+// (if 'stamp' is given, the ioctl read the state identified by it)
+static void TraceXUsbIoctl(int userIdx, DWORD ioctl, const ImplStateStamp *stamp = nullptr) {
+    if (GEventTrace.IsEnabled()) {
+        GEventTrace.Add(EventTraceKind::XUsbIoctl, stamp ? EventTraceFlag_Read : 0, userIdx, (ioctl >> 2) & 0xfff, stamp ? stamp->Version : 0);
+    }
+}
+
+// (returns the stamp of the state that was read)
+ImplStateStamp ReadXUsbState(XUsbGamepadState *xusb, const ImplState &implState, XUsbVersion version) {
+    auto state = implState.Snapshot.Read();
     ZeroMemory(xusb, sizeof(XUsbGamepadState));
     xusb->Version = version;
     xusb->Active = true;
@@ -219,6 +227,7 @@ void ReadXUsbState(XUsbGamepadState *xusb, const ImplState &state, XUsbVersion v
     xusb->Gamepad.sThumbLY = state.LA.Y.Value16();
     xusb->Gamepad.sThumbRX = state.RA.X.Value16();
     xusb->Gamepad.sThumbRY = state.RA.Y.Value16();
+    return state.Stamp();
 }
 
 // Note: assuming version will not change in future async reads...
@@ -275,7 +284,9 @@ static bool XUsbSetupAsyncRead(const wchar_t *finalPath, DeviceIntf *device, XUs
             }
         }
 
-        ReadXUsbState(&xusbState, user->State, version);
+        ImplStateStamp stamp = ReadXUsbState(&xusbState, user->State, version);
+        TraceXUsbIoctl((int)(user - G.Users), IOCTL_XUSB_GET_GAMEPAD_STATE_ASYNC, &stamp);
+        GImplLatency[user - G.Users].OnDelivered(MyInputHook_Stats_XUsbRead, stamp); // (the app's read is pending on the pipe)
         return onWriteEnd(WriteFile(client, &xusbState, sizeof(XUsbGamepadState), &written, &overlapped));
     });
     return true;
@@ -284,6 +295,10 @@ static bool XUsbSetupAsyncRead(const wchar_t *finalPath, DeviceIntf *device, XUs
 static BOOL XUsbDeviceIoControl(const wchar_t *finalPath, DeviceIntf *device, DWORD dwIoControlCode, LPVOID lpInBuffer, DWORD nInBufferSize,
                                 LPVOID lpOutBuffer, DWORD nOutBufferSize, LPDWORD lpBytesReturned,
                                 HANDLE hDevice, LPOVERLAPPED lpAsyncOverlapped, bool *refAsync) {
+    if (dwIoControlCode != IOCTL_XUSB_GET_GAMEPAD_STATE) { // (traced once read, below)
+        TraceXUsbIoctl(device->UserIdx, dwIoControlCode);
+    }
+
     switch (dwIoControlCode) {
     case IOCTL_XUSB_GET_INFORMATION:
         return ProcessDeviceIoControlOutput<XUsbInformation>(
@@ -384,7 +399,9 @@ static BOOL XUsbDeviceIoControl(const wchar_t *finalPath, DeviceIntf *device, DW
                 return ProcessDeviceIoControlOutput<XUsbGamepadState>(
                     lpOutBuffer, nOutBufferSize, lpBytesReturned, [&](XUsbGamepadState *xusb) {
                         auto &state = G.Users[device->UserIdx].State;
-                        ReadXUsbState(xusb, state, version);
+                        ImplStateStamp stamp = ReadXUsbState(xusb, state, version);
+                        TraceXUsbIoctl(device->UserIdx, dwIoControlCode, &stamp);
+                        GImplLatency[device->UserIdx].OnDelivered(MyInputHook_Stats_XUsbRead, stamp);
                         return TRUE;
                     });
             }